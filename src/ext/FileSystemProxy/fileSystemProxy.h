@@ -31,6 +31,7 @@
 #ifndef _FileSystemProxy_h
 #define _FileSystemProxy_h
 
+#include <stdint.h>
 #include <string>
 
 
@@ -70,9 +71,29 @@ class FileSysProxy {
     virtual size_t maxPathLength() const = 0;
 
     // Return a directory iterator object. NOTE: User must delete this object! It is recommended
-    // that you hold the return value in a unique_ptr<>.
+    // that you hold the return value in a unique_ptr<>. May be called concurrently from several
+    // threads; each returned iterator is used by one thread at a time.
     virtual DirectoryIterator* newDirectoryIterator (const std::wstring path) const = 0;
 
+    // Reopen a directory iterator on a new path, and return it. Callers that walk many directories
+    // can keep one iterator per tree level this way, instead of allocating one per directory. The
+    // iterator must be null, or have come from this proxy. The default just replaces it.
+    virtual DirectoryIterator* reuseDirectoryIterator (
+        DirectoryIterator* iterator, const wchar_t* path) const
+    {
+        delete iterator;
+        return newDirectoryIterator (path);
+    }
+
+    // Get the times a directory was last modified (its entries changed) and last changed (its
+    // status changed), in nanoseconds since 1970-01-01 UTC. Returns false if the path isn't a
+    // directory, or the file system can't tell. The default can't tell.
+    virtual bool directoryTimes (
+        const wchar_t* /*path*/, uint64_t& /*modified*/, uint64_t& /*changed*/) const
+    {
+        return false;
+    }
+
     // Set the current working directory. Returns false if the directory does not exist.
     virtual bool setCurrentDirectory (const std::wstring path) = 0;
 };
@@ -0,0 +1,513 @@
+//==================================================================================================
+// FileSystemProxyCache.cpp
+//
+//     This file contains the definitions for the file system proxy that caches directory listings
+//     across runs.
+//
+// _________________________________________________________________________________________________
+// Copyright 2015 Steve Hollasch
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under
+// the License.
+//==================================================================================================
+
+#include "fileSystemProxyCache.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+using namespace std;
+using namespace FSProxy;
+
+
+
+// Cache File Format
+//
+// The cache file holds a header, followed by each cached directory. All values are in the host's
+// byte order, and strings are in host wchar_t units, since the file is never shared between hosts.
+// A cache file that fails any check is ignored, to be rewritten on the next save.
+//
+//     Header:    char[4] "JDLC", uint32 version, uint32 sizeof(wchar_t), uint32 directory count
+//     Directory: uint64 modified, uint64 changed,
+//                uint32 path length, path characters (without terminator),
+//                uint32 names length, null-terminated entry names,
+//                uint32 entry count, uint8 is-directory flag for each entry
+
+static const char     c_cacheMagic[4] = { 'J', 'D', 'L', 'C' };
+static const uint32_t c_cacheVersion  = 1;
+
+
+
+// Local Helpers
+
+static bool isSlash (wchar_t c)
+{
+    return (c == L'/') || (c == L'\\');
+}
+
+
+static bool isCacheable (const wchar_t* path, size_t length)
+{
+    // Returns true if the path asks for a whole listing ("<dir>/*") of an absolute directory path:
+    // a UNC path, a drive-rooted path, or elsewhere than Windows, a rooted path.
+
+    if ((length < 3) || (path[length-1] != L'*') || !isSlash(path[length-2]))
+        return false;
+
+    if (isSlash(path[0]))
+    {
+#ifdef _WIN32
+        return isSlash(path[1]);
+#else
+        return true;
+#endif
+    }
+
+    return (path[0] < 0x80) && isalpha(path[0]) && (path[1] == L':') && isSlash(path[2]);
+}
+
+
+static uint64_t now ()
+{
+    // Returns the current time, in nanoseconds since 1970-01-01 UTC.
+
+    auto sinceEpoch = chrono::system_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(sinceEpoch).count());
+}
+
+
+static string tempFileName (const string& file)
+{
+    // Returns a temporary file name beside the given file, unique to this process and call, so
+    // that processes saving the cache at the same time don't write into each other's files.
+
+    static atomic<unsigned> count { 0 };
+
+#ifdef _WIN32
+    auto processId = static_cast<unsigned long>(GetCurrentProcessId());
+#else
+    auto processId = static_cast<unsigned long>(getpid());
+#endif
+
+    return file + "." + to_string(processId) + "." + to_string(++count) + ".tmp";
+}
+
+
+static bool replaceFile (const string& source, const string& target)
+{
+    // Moves the source file over the target file in a single step, so that readers see either the
+    // old target or the new one, never neither.
+
+#ifdef _WIN32
+    return MoveFileExA (source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename (source.c_str(), target.c_str()) == 0;
+#endif
+}
+
+
+class CacheReader
+{
+    // Reads values from a cache file image, failing (and staying failed) on any overrun.
+
+  public:
+    CacheReader (const vector<char>& image) : m_image(image) {}
+
+    bool ok () const { return m_ok; }
+    bool atEnd () const { return m_offset == m_image.size(); }
+
+    template <typename T> T read ()
+    {
+        T value {};
+        readBytes (&value, sizeof(T));
+        return value;
+    }
+
+    void readBytes (void* dest, size_t size)
+    {
+        if (!m_ok || (m_image.size() - m_offset < size))
+        {   m_ok = false;
+            return;
+        }
+
+        memcpy (dest, m_image.data() + m_offset, size);
+        m_offset += size;
+    }
+
+    void readString (wstring& dest, size_t length)
+    {
+        if (!m_ok || ((m_image.size() - m_offset) / sizeof(wchar_t) < length))
+        {   m_ok = false;
+            return;
+        }
+
+        dest.resize (length);
+        readBytes (&dest[0], length * sizeof(wchar_t));
+    }
+
+  private:
+    const vector<char>& m_image;
+    size_t              m_offset { 0 };
+    bool                m_ok { true };
+};
+
+
+template <typename T> static void write (FILE* file, T value)
+{
+    fwrite (&value, sizeof(T), 1, file);
+}
+
+
+
+// Directory Iterator Methods
+
+bool DirectoryIteratorCache::next()
+{
+    // Advances the iterator to the first/next entry.
+
+    if (!m_listing)
+        return m_live && m_live->next();
+
+    if (m_index >= m_listing->entries.size())
+        return false;
+
+    ++m_index;
+    return true;
+}
+
+
+
+bool DirectoryIteratorCache::isDirectory() const
+{
+    // Returns true if the current entry is a directory.
+
+    if (!m_listing)
+        return m_live->isDirectory();
+
+    return m_listing->entries[m_index - 1].isDirectory;
+}
+
+
+
+const wchar_t* DirectoryIteratorCache::name() const
+{
+    // Returns the name of the current entry.
+
+    if (!m_listing)
+        return m_live->name();
+
+    return m_listing->names.c_str() + m_listing->entries[m_index - 1].nameOffset;
+}
+
+
+
+// File System Proxy Methods
+
+FileSysProxyCache::~FileSysProxyCache()
+{
+    save();
+}
+
+
+
+void FileSysProxyCache::open (const string& cacheFile)
+{
+    // Sets the cache file, which will be read on the first cached lookup.
+
+    lock_guard<mutex> lock { m_lock };
+
+    m_cacheFile = cacheFile;
+    m_loaded = false;
+    m_dirty = false;
+    m_slots.clear();
+}
+
+
+
+void FileSysProxyCache::load () const
+{
+    //----------------------------------------------------------------------------------------------
+    // Reads the cache file (see Cache File Format) into the cache slots. Must be called with the
+    // cache lock held. Any error leaves the cache empty.
+    //----------------------------------------------------------------------------------------------
+
+    m_loaded = true;
+
+    if (m_cacheFile.empty()) return;
+
+    auto file = fopen (m_cacheFile.c_str(), "rb");
+
+    if (!file) return;
+
+    vector<char> image;
+
+    if ((fseek (file, 0, SEEK_END) == 0) && (ftell (file) > 0))
+    {
+        image.resize (static_cast<size_t>(ftell (file)));
+        rewind (file);
+
+        if (fread (image.data(), 1, image.size(), file) != image.size())
+            image.clear();
+    }
+
+    fclose (file);
+
+    CacheReader reader { image };
+
+    char magic[4];
+    reader.readBytes (magic, sizeof(magic));
+
+    auto version  = reader.read<uint32_t>();
+    auto charSize = reader.read<uint32_t>();
+    auto numDirs  = reader.read<uint32_t>();
+
+    if (  !reader.ok() || (memcmp (magic, c_cacheMagic, sizeof(magic)) != 0)
+       || (version != c_cacheVersion) || (charSize != sizeof(wchar_t)))
+    {
+        return;
+    }
+
+    wstring path;
+
+    for (uint32_t i = 0;  reader.ok() && (i < numDirs);  ++i)
+    {
+        auto listing = make_shared<CachedListing>();
+
+        listing->modified = reader.read<uint64_t>();
+        listing->changed  = reader.read<uint64_t>();
+
+        reader.readString (path, reader.read<uint32_t>());
+        reader.readString (listing->names, reader.read<uint32_t>());
+
+        auto numEntries = reader.read<uint32_t>();
+
+        // Recover the name offsets from the terminators, which must agree with the entry count.
+
+        size_t nameOffset = 0;
+
+        for (uint32_t entry = 0;  reader.ok() && (entry < numEntries);  ++entry)
+        {
+            auto nameEnd = listing->names.find (L'\0', nameOffset);
+
+            if (nameEnd == wstring::npos) break;
+
+            listing->entries.push_back ({ nameOffset, reader.read<uint8_t>() != 0 });
+            nameOffset = nameEnd + 1;
+        }
+
+        if (!reader.ok() || (listing->entries.size() != numEntries)
+            || (nameOffset != listing->names.size()))
+        {
+            break;
+        }
+
+        m_slots[path] = { move(listing), false };
+    }
+
+    if (!reader.ok() || (m_slots.size() != numDirs) || !reader.atEnd())
+        m_slots.clear();
+}
+
+
+
+bool FileSysProxyCache::save ()
+{
+    //----------------------------------------------------------------------------------------------
+    // Writes the cache file (see Cache File Format), if the cache has changed since it was read.
+    // Listings looked up in this run are kept first; the rest fill out the file up to the limit.
+    // The file is written to a temporary name of its own, then moved over the old file.
+    //
+    // Returns true if the file was written or didn't need to be, otherwise false.
+    //----------------------------------------------------------------------------------------------
+
+    lock_guard<mutex> lock { m_lock };
+
+    if (!m_dirty || m_cacheFile.empty())
+        return true;
+
+    vector<const pair<const wstring, Slot>*> kept;
+
+    for (auto pass = 0;  pass < 2;  ++pass)
+    {
+        for (auto& slot : m_slots)
+        {
+            if ((slot.second.used == (pass == 0)) && (kept.size() < c_maxDirectories))
+                kept.push_back (&slot);
+        }
+    }
+
+    auto tempFile = tempFileName (m_cacheFile);
+    auto file     = fopen (tempFile.c_str(), "wb");
+
+    if (!file) return false;
+
+    fwrite (c_cacheMagic, 1, sizeof(c_cacheMagic), file);
+    write<uint32_t> (file, c_cacheVersion);
+    write<uint32_t> (file, sizeof(wchar_t));
+    write<uint32_t> (file, static_cast<uint32_t>(kept.size()));
+
+    for (auto slot : kept)
+    {
+        auto& path    = slot->first;
+        auto& listing = *slot->second.listing;
+
+        write<uint64_t> (file, listing.modified);
+        write<uint64_t> (file, listing.changed);
+        write<uint32_t> (file, static_cast<uint32_t>(path.size()));
+        fwrite (path.data(), sizeof(wchar_t), path.size(), file);
+        write<uint32_t> (file, static_cast<uint32_t>(listing.names.size()));
+        fwrite (listing.names.data(), sizeof(wchar_t), listing.names.size(), file);
+        write<uint32_t> (file, static_cast<uint32_t>(listing.entries.size()));
+
+        for (auto& entry : listing.entries)
+            write<uint8_t> (file, entry.isDirectory ? 1 : 0);
+    }
+
+    auto written = !ferror (file);
+
+    if ((fclose (file) != 0) || !written)
+    {   remove (tempFile.c_str());
+        return false;
+    }
+
+    if (!replaceFile (tempFile, m_cacheFile))
+    {   remove (tempFile.c_str());
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+
+
+DirectoryIterator* FileSysProxyCache::newDirectoryIterator (const wstring path) const
+{
+    return reuseDirectoryIterator (nullptr, path.c_str());
+}
+
+
+
+DirectoryIterator* FileSysProxyCache::reuseDirectoryIterator (
+    DirectoryIterator* iterator,
+    const wchar_t*     path) const
+{
+    //----------------------------------------------------------------------------------------------
+    // Reopens the iterator on a cached listing if the path can be cached, otherwise on the
+    // underlying proxy's iterator for the path.
+    //----------------------------------------------------------------------------------------------
+
+    auto cacheIterator = iterator ? static_cast<DirectoryIteratorCache*>(iterator)
+                                  : new DirectoryIteratorCache;
+
+    auto length = wcslen (path);
+
+    if (isCacheable (path, length) && openCached (*cacheIterator, path, length))
+        return cacheIterator;
+
+    cacheIterator->m_listing.reset();
+
+    auto& live = cacheIterator->m_live;
+    live.reset (m_live.reuseDirectoryIterator (live.release(), path));
+
+    return cacheIterator;
+}
+
+
+
+bool FileSysProxyCache::openCached (
+    DirectoryIteratorCache& iterator,
+    const wchar_t*          path,
+    size_t                  length) const
+{
+    //----------------------------------------------------------------------------------------------
+    // Opens the iterator on the cached listing of the directory path (which ends in "/*"). If the
+    // directory has changed since it was cached, or hasn't been cached, then it is listed afresh
+    // through the underlying proxy, and the new listing is cached.
+    //
+    // Returns false if the underlying proxy can't report the directory's times.
+    //----------------------------------------------------------------------------------------------
+
+    // The directory's times are taken before any listing, so that a change made during the listing
+    // is seen by the next lookup.
+
+    thread_local wstring directory;
+    directory.assign (path, length - 1);
+
+    uint64_t modified, changed;
+
+    if (!m_live.directoryTimes (directory.c_str(), modified, changed))
+        return false;
+
+    {
+        lock_guard<mutex> lock { m_lock };
+
+        if (!m_loaded) load();
+
+        auto found = m_slots.find (directory);
+
+        if (  (found != m_slots.end())
+           && (found->second.listing->modified == modified)
+           && (found->second.listing->changed == changed))
+        {
+            found->second.used = true;
+            iterator.m_listing = found->second.listing;
+            iterator.m_index = 0;
+            return true;
+        }
+    }
+
+    // List the directory through the underlying proxy.
+
+    auto listing = make_shared<CachedListing>();
+
+    listing->modified = modified;
+    listing->changed  = changed;
+
+    auto& live = iterator.m_live;
+    live.reset (m_live.reuseDirectoryIterator (live.release(), path));
+
+    while (live->next())
+    {
+        listing->entries.push_back ({ listing->names.size(), live->isDirectory() });
+        listing->names.append (live->name());
+        listing->names += L'\0';
+    }
+
+    iterator.m_listing = listing;
+    iterator.m_index = 0;
+
+    // A directory changed within the racy window could change again without its times moving, so
+    // its listing is used but not cached. A change time in the future (clock skew, or a restored
+    // file system) is just as untrustworthy.
+
+    auto currentTime = now();
+    auto lastChange  = std::max (modified, changed);
+
+    if ((lastChange >= currentTime) || (currentTime - lastChange < c_racyTime))
+        return true;
+
+    lock_guard<mutex> lock { m_lock };
+
+    m_slots[directory] = { move(listing), true };
+    m_dirty = true;
+
+    return true;
+}
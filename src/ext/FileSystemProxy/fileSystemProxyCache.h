@@ -0,0 +1,166 @@
+//==================================================================================================
+// FileSystemProxyCache
+//
+//     Caching file system proxy, which keeps directory listings across runs.
+//
+// _________________________________________________________________________________________________
+// MIT License
+//
+// Copyright © 2017 Steve Hollasch
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//==================================================================================================
+
+#ifndef _FileSystemProxyCache_h
+#define _FileSystemProxyCache_h
+
+    // Includes
+
+#include "fileSystemProxy.h"
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace FSProxy {
+
+
+struct CachedListing {
+
+    // One directory's listing, as cached. A listing is never changed once cached, so iterators
+    // share it with the cache, and with each other, across threads.
+
+    struct Entry {
+        size_t nameOffset;    // Offset of the entry name in names
+        bool   isDirectory;   // True => entry is a directory
+    };
+
+    uint64_t           modified;   // Directory modification time when listed
+    uint64_t           changed;    // Directory status change time when listed
+    std::wstring       names;      // Entry names, each null-terminated
+    std::vector<Entry> entries;    // Directory entries, in listing order
+};
+
+
+
+class DirectoryIteratorCache : public DirectoryIterator {
+
+    // This class iterates through either a cached listing, or (for paths the cache doesn't hold)
+    // an iterator from the underlying proxy.
+
+  public:
+    DirectoryIteratorCache() {}
+
+    // Advance to first/next entry.
+    bool next() override;
+
+    // True => current entry is a directory.
+    bool isDirectory() const override;
+
+    // Return name of the current entry.
+    const wchar_t* name() const override;
+
+  private:
+    friend class FileSysProxyCache;
+
+    std::shared_ptr<const CachedListing> m_listing;      // Cached listing (null => use m_live)
+    size_t                               m_index { 0 };  // Current listing entry, plus one
+    std::unique_ptr<DirectoryIterator>   m_live;         // Underlying iterator slot
+};
+
+
+
+class FileSysProxyCache : public FileSysProxy {
+
+    // This class caches the directory listings of another file system proxy, and keeps them on
+    // disk from one run to the next. A cached listing is used as long as the directory's
+    // modification and status change times are as they were when it was listed, so listing an
+    // unchanged directory costs one stat instead of a full directory read.
+    //
+    // Only whole listings ("<dir>/*") of absolute paths are cached; other paths go straight to the
+    // underlying proxy, as do all paths if it can't report directory times. A directory changed
+    // in the last few seconds isn't cached, since a further change within the file system's
+    // timestamp resolution could go unseen.
+    //
+    // The cache only helps code that lists directories through the proxy, such as PathMatcher.
+    // It doesn't speed up single-path probes made directly against the file system.
+
+  public:
+    FileSysProxyCache (FileSysProxy& live) : m_live(live) {}
+
+    // Saves the cache, if it has changed.
+    virtual ~FileSysProxyCache();
+
+    // Use the given cache file. The file is only read on the first cached lookup.
+    void open (const std::string& cacheFile);
+
+    // Write the cache file, if the cache has changed. Returns false on error.
+    bool save ();
+
+    size_t maxPathLength() const override { return m_live.maxPathLength(); }
+
+    // Return a directory iterator object.
+    // NOTE: User must delete this object!
+    DirectoryIterator* newDirectoryIterator (const std::wstring path) const override;
+
+    // Reopen the given iterator (which must be null or from this proxy) on a new path.
+    DirectoryIterator* reuseDirectoryIterator (DirectoryIterator* iterator, const wchar_t* path)
+        const override;
+
+    // Get a directory's modification and status change times from the underlying proxy.
+    bool directoryTimes (const wchar_t* path, uint64_t& modified, uint64_t& changed) const override
+    {
+        return m_live.directoryTimes (path, modified, changed);
+    }
+
+    // Set the current working directory. Returns false if the directory does not exist.
+    bool setCurrentDirectory (const std::wstring path) override
+    {
+        return m_live.setCurrentDirectory (path);
+    }
+
+  private:
+    static const size_t   c_maxDirectories { 100000 };     // Most listings kept in the file
+    static const uint64_t c_racyTime { 4000000000 };       // Too-recent change window (ns)
+
+    struct Slot {
+        std::shared_ptr<const CachedListing> listing;   // Directory listing
+        bool                                 used;      // True => looked up in this run
+    };
+
+    void load () const;
+    bool openCached (DirectoryIteratorCache& iterator, const wchar_t* path, size_t length) const;
+
+    FileSysProxy& m_live;        // Underlying File System Proxy
+    std::string   m_cacheFile;   // Cache file name (empty if none)
+
+    mutable std::mutex  m_lock;                // Guards the fields below
+    mutable bool        m_loaded { false };    // True => cache file has been read
+    mutable bool        m_dirty { false };     // True => cache differs from the file
+    mutable std::unordered_map<std::wstring, Slot> m_slots;   // Listings by directory path
+};
+
+
+};  // namespace FileSystemProxy
+
+
+#endif   // _FileSystemProxyCache_h
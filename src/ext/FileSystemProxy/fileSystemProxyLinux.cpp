@@ -0,0 +1,329 @@
+//==================================================================================================
+// FileSystemProxyLinux.cpp
+//
+//     This file contains the definitions for the file system proxy classes for the Linux file
+//     system.
+//
+// _________________________________________________________________________________________________
+// Copyright 2015 Steve Hollasch
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under
+// the License.
+//==================================================================================================
+
+#include "fileSystemProxyLinux.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string>
+
+using namespace std;
+using namespace FSProxy;
+
+
+
+// Local Helpers
+
+struct LinuxDirent64
+{
+    // The record layout written by getdents64 (see getdents(2)).
+
+    uint64_t       d_ino;       // Inode number (zero for a deleted entry)
+    int64_t        d_off;       // Offset to the next record
+    unsigned short d_reclen;    // Size of this record
+    unsigned char  d_type;      // Entry type, or DT_UNKNOWN
+    char           d_name[1];   // Null-terminated entry name
+};
+
+
+static void appendUtf8 (string& dest, const wchar_t* str)
+{
+    // Appends the wide string to 'dest' in UTF-8, with backslashes converted to forward slashes.
+
+    for (;  *str;  ++str)
+    {
+        auto c = static_cast<uint32_t>(*str);
+
+        if (c == L'\\')
+            dest += '/';
+        else if (c < 0x80)
+            dest += static_cast<char>(c);
+        else if (c < 0x800)
+        {   dest += static_cast<char>(0xc0 | (c >> 6));
+            dest += static_cast<char>(0x80 | (c & 0x3f));
+        }
+        else if (c < 0x10000)
+        {   dest += static_cast<char>(0xe0 | (c >> 12));
+            dest += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            dest += static_cast<char>(0x80 | (c & 0x3f));
+        }
+        else
+        {   dest += static_cast<char>(0xf0 | (c >> 18));
+            dest += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+            dest += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            dest += static_cast<char>(0x80 | (c & 0x3f));
+        }
+    }
+}
+
+
+static void assignUtf8 (wstring& dest, const char* str)
+{
+    // Sets 'dest' to the UTF-8 string, decoded. Bytes that don't form valid UTF-8 decode to
+    // U+FFFD, the replacement character.
+
+    dest.clear();
+
+    auto s = reinterpret_cast<const unsigned char*>(str);
+
+    while (*s)
+    {
+        uint32_t c = *s++;
+
+        if (c < 0x80)
+        {   dest += static_cast<wchar_t>(c);
+            continue;
+        }
+
+        int extra = (c >= 0xf0) ? 3 : (c >= 0xe0) ? 2 : (c >= 0xc0) ? 1 : 0;
+
+        if ((extra == 0) || (c >= 0xf8))
+        {   dest += L'\xfffd';
+            continue;
+        }
+
+        c &= 0x3f >> extra;
+
+        int i = 0;
+
+        for (;  (i < extra) && ((s[i] & 0xc0) == 0x80);  ++i)
+            c = (c << 6) | (s[i] & 0x3f);
+
+        s += i;
+        dest += (i == extra) ? static_cast<wchar_t>(c) : L'\xfffd';
+    }
+}
+
+
+
+// Directory Iterator Methods
+
+DirectoryIteratorLinux::DirectoryIteratorLinux (const wchar_t* path)
+{
+    reopen (path);
+}
+
+DirectoryIteratorLinux::~DirectoryIteratorLinux()
+{
+    close();
+}
+
+
+
+void DirectoryIteratorLinux::close ()
+{
+    // Closes the current directory, if any.
+
+    if (m_dirFd >= 0)
+        ::close (m_dirFd);
+
+    m_dirFd = -1;
+    m_batchSize = m_batchOffset = 0;
+}
+
+
+
+void DirectoryIteratorLinux::reopen (const wchar_t* path)
+{
+    //----------------------------------------------------------------------------------------------
+    // Restarts iteration on a new path, closing the current one. A path ending in "*" lists the
+    // directory before the asterisk (or the current directory, if none); any other path names a
+    // single entry, which is returned if it exists.
+    //----------------------------------------------------------------------------------------------
+
+    close();
+    m_single = false;
+
+    m_path.clear();
+    appendUtf8 (m_path, path);
+
+    auto slash = m_path.rfind ('/');
+    auto leaf  = (slash == string::npos) ? 0 : slash + 1;
+
+    if (m_path.compare (leaf, string::npos, "*") == 0)
+    {
+        // Trim the asterisk, keeping the slash only if it's the root directory.
+
+        m_path.resize ((leaf > 1) ? leaf - 1 : leaf);
+
+        m_dirFd = open (m_path.empty() ? "." : m_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        return;
+    }
+
+    // A single entry named explicitly is looked up through any symbolic link.
+
+    struct stat status;
+
+    if (stat (m_path.c_str(), &status) != 0)
+        return;
+
+    m_single      = true;
+    m_isDirectory = S_ISDIR(status.st_mode);
+    assignUtf8 (m_name, m_path.c_str() + leaf);
+}
+
+
+
+bool DirectoryIteratorLinux::readBatch ()
+{
+    // Reads the next batch of entries into the buffer. Returns false at the end of the directory,
+    // or on error.
+
+    auto size = syscall (SYS_getdents64, m_dirFd, m_buffer, c_bufferSize);
+
+    if (size <= 0)
+        return false;
+
+    m_batchSize   = static_cast<size_t>(size);
+    m_batchOffset = 0;
+    return true;
+}
+
+
+
+bool DirectoryIteratorLinux::next()
+{
+    // Advances the iterator to the first/next entry.
+
+    if (m_single)
+    {   m_single = false;
+        return true;
+    }
+
+    while (m_dirFd >= 0)
+    {
+        if ((m_batchOffset >= m_batchSize) && !readBatch())
+            break;
+
+        auto entry = reinterpret_cast<const LinuxDirent64*>(m_buffer + m_batchOffset);
+
+        m_batchOffset += entry->d_reclen;
+
+        if (entry->d_ino == 0) continue;
+
+        if (!m_ignoreTypes && (entry->d_type != DT_UNKNOWN))
+            m_isDirectory = (entry->d_type == DT_DIR);
+        else
+        {   struct stat status;
+            m_isDirectory = (fstatat (m_dirFd, entry->d_name, &status, AT_SYMLINK_NOFOLLOW) == 0)
+                         && S_ISDIR(status.st_mode);
+        }
+
+        assignUtf8 (m_name, entry->d_name);
+        return true;
+    }
+
+    // Release the directory as soon as it's exhausted, since a reused iterator may sit idle for
+    // some time before it's reopened.
+
+    close();
+    return false;
+}
+
+
+
+bool DirectoryIteratorLinux::isDirectory() const
+{
+    // Returns true if the current entry is a directory.
+    return m_isDirectory;
+}
+
+
+
+const wchar_t* DirectoryIteratorLinux::name() const
+{
+    // Returns the name of the current entry.
+    return m_name.c_str();
+}
+
+
+
+// File System Proxy Methods
+
+size_t FileSysProxyLinux::maxPathLength() const
+{
+    // Returns the longest path length, not counting the terminator.
+    return PATH_MAX - 1;
+}
+
+
+
+DirectoryIterator* FileSysProxyLinux::newDirectoryIterator (const wstring path) const
+{
+    return new DirectoryIteratorLinux(path.c_str());
+}
+
+
+
+DirectoryIterator* FileSysProxyLinux::reuseDirectoryIterator (
+    DirectoryIterator* iterator,
+    const wchar_t*     path) const
+{
+    if (!iterator)
+        return new DirectoryIteratorLinux(path);
+
+    static_cast<DirectoryIteratorLinux*>(iterator)->reopen (path);
+    return iterator;
+}
+
+
+
+bool FileSysProxyLinux::directoryTimes (
+    const wchar_t* path,
+    uint64_t&      modified,
+    uint64_t&      changed) const
+{
+    // Gets the directory's modification time, which changes as entries are added, removed or
+    // renamed, and its status change time, which also catches times set back by hand.
+
+    string utf8Path;
+    appendUtf8 (utf8Path, path);
+
+    struct stat status;
+
+    if ((stat (utf8Path.c_str(), &status) != 0) || !S_ISDIR(status.st_mode))
+        return false;
+
+    modified = uint64_t(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+    changed  = uint64_t(status.st_ctim.tv_sec) * 1000000000 + status.st_ctim.tv_nsec;
+    return true;
+}
+
+
+
+bool FileSysProxyLinux::setCurrentDirectory (const wstring path)
+{
+    // Sets the current working directory. Returns false if the directory does not exist.
+
+    string utf8Path;
+    appendUtf8 (utf8Path, path.c_str());
+
+    struct stat status;
+
+    if ((stat (utf8Path.c_str(), &status) != 0) || !S_ISDIR(status.st_mode))
+        return false;
+
+    m_currentDir = path;
+    return true;
+}
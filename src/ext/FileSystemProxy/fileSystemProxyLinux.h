@@ -0,0 +1,126 @@
+//==================================================================================================
+// FileSystemProxyLinux
+//
+//     Linux file system proxy, using the FileSystemProxy base.
+//
+// _________________________________________________________________________________________________
+// MIT License
+//
+// Copyright © 2017 Steve Hollasch
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//==================================================================================================
+
+#ifndef _FileSystemProxyLinux_h
+#define _FileSystemProxyLinux_h
+
+    // Includes
+
+#include "fileSystemProxy.h"
+#include <stddef.h>
+#include <string>
+
+
+namespace FSProxy {
+
+
+class DirectoryIteratorLinux : public DirectoryIterator {
+
+    // This class provides a way to iterate through file & directory entries in a Linux file
+    // system. As with FindFirstFileW, the path either ends in "*", to list the directory before
+    // it, or names a single entry. Paths are wide strings, and may use either slash; names are
+    // converted to and from UTF-8.
+    //
+    // Entries are read in batches with getdents64 into a buffer that is kept across reopens.
+    // Entry types come from d_type, so most entries cost no stat call. Only file systems that
+    // report DT_UNKNOWN fall back to fstatat. Symbolic links listed in a directory are not
+    // followed, so they never count as directories, and tree walks can't loop through them.
+
+  public:
+    DirectoryIteratorLinux (const wchar_t* path);
+    ~DirectoryIteratorLinux();
+
+    // Restart iteration on a new directory path, closing the current one.
+    void reopen (const wchar_t* path);
+
+    // Advance to first/next entry.
+    bool next() override;
+
+    // True => current entry is a directory.
+    bool isDirectory() const override;
+
+    // Return name of the current entry.
+    const wchar_t* name() const override;
+
+    // Ignore the entry types getdents64 reports, and stat every entry, as for file systems that
+    // report DT_UNKNOWN. Lets tests reach that path on any file system.
+    void ignoreEntryTypes (bool ignore) { m_ignoreTypes = ignore; }
+
+  private:
+    static const size_t c_bufferSize { 32 * 1024 };   // getdents64 batch size
+
+    void close ();
+    bool readBatch ();
+
+    int          m_dirFd { -1 };            // Open directory, or -1 if none
+    bool         m_single { false };        // True => a single named entry is yet to be returned
+    bool         m_isDirectory { false };   // True => current entry is a directory
+    bool         m_ignoreTypes { false };   // True => treat every entry type as DT_UNKNOWN
+    std::string  m_path;                    // UTF-8 path, reused across reopens
+    std::wstring m_name;                    // Name of the current entry
+    size_t       m_batchSize { 0 };         // Bytes read into m_buffer
+    size_t       m_batchOffset { 0 };       // Offset of the next entry in m_buffer
+
+    alignas(8) char m_buffer [c_bufferSize];   // Directory Entry Batch
+};
+
+
+
+class FileSysProxyLinux : public FileSysProxy {
+
+    // This class provides a general file system interface for Linux.
+
+  public:
+    virtual ~FileSysProxyLinux() {}
+
+    size_t maxPathLength() const override;
+
+    // Return a directory iterator object.
+    // NOTE: User must delete this object!
+    DirectoryIterator* newDirectoryIterator (const std::wstring path) const override;
+
+    // Reopen the given iterator (which must be null or from this proxy) on a new path.
+    DirectoryIterator* reuseDirectoryIterator (DirectoryIterator* iterator, const wchar_t* path)
+        const override;
+
+    // Get a directory's modification and status change times.
+    bool directoryTimes (const wchar_t* path, uint64_t& modified, uint64_t& changed) const override;
+
+    // Set the current working directory. Returns false if the directory does not exist.
+    bool setCurrentDirectory (const std::wstring path) override;
+
+  private:
+    std::wstring m_currentDir;     // Current working directory
+};
+
+
+};  // namespace FileSystemProxy
+
+
+#endif   // _FileSystemProxyLinux_h
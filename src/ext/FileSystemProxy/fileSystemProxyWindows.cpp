@@ -1,87 +1,160 @@
-//==================================================================================================
-// FileSystemProxyWindows.cpp
-//
-//     This file contains the definitions for the file system proxy classes for the Windows file
-//     system.
-//
-// _________________________________________________________________________________________________
-// Copyright 2015 Steve Hollasch
-//
-// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except
-// in compliance with the License. You may obtain a copy of the License at
-//
-//     http://www.apache.org/licenses/LICENSE-2.0
-//
-// Unless required by applicable law or agreed to in writing, software distributed under the License
-// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
-// or implied. See the License for the specific language governing permissions and limitations under
-// the License.
-//==================================================================================================
-
-#include "FileSystemProxyWindows.h"
-#include <stdlib.h>
-#include <string>
-
-using namespace std;
-using namespace FSProxy;
-
-
-
-// Directory Iterator Methods
-
-DirectoryIteratorWindows::DirectoryIteratorWindows (const wstring path)
-  : m_started(false)
-{
-    m_findHandle = FindFirstFileW(path.c_str(), &m_findData);
-}
-
-DirectoryIteratorWindows::~DirectoryIteratorWindows()
-{
-    FindClose (m_findHandle);
-}
-
-
-
-bool DirectoryIteratorWindows::next()
-{
-    // Advances the iterator to the first/next entry.
-
-    if (m_started)
-        return 0 != FindNextFileW(m_findHandle, &m_findData);
-
-    m_started = true;
-    return m_findHandle != INVALID_HANDLE_VALUE;
-}
-
-
-
-bool DirectoryIteratorWindows::isDirectory() const
-{
-    // Returns true if the current entry is a directory.
-    return 0 != (m_findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
-}
-
-
-
-const wchar_t* DirectoryIteratorWindows::name() const
-{
-    // Returns the name of the current entry.
-    return m_findData.cFileName;
-}
-
-
-
-DirectoryIterator* FileSysProxyWindows::newDirectoryIterator (const wstring path) const
-{
-    return new DirectoryIteratorWindows(path);
-}
-
-
-bool FileSysProxyWindows::setCurrentDirectory (const wstring path)
-{
-    // Sets the current working directory. Returns true if the directory is valid.
-    m_currentDir = path;
-
-    // NOT YET IMPLEMENTED: For now, just always accept the directory.
-    return true;
-}
+//==================================================================================================
+// FileSystemProxyWindows.cpp
+//
+//     This file contains the definitions for the file system proxy classes for the Windows file
+//     system.
+//
+// _________________________________________________________________________________________________
+// Copyright 2015 Steve Hollasch
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+// or implied. See the License for the specific language governing permissions and limitations under
+// the License.
+//==================================================================================================
+
+#include "fileSystemProxyWindows.h"
+#include <stdlib.h>
+#include <string>
+
+using namespace std;
+using namespace FSProxy;
+
+
+
+// Directory Iterator Methods
+
+DirectoryIteratorWindows::DirectoryIteratorWindows (const wchar_t* path)
+  : m_started(false)
+{
+    m_findHandle = FindFirstFileW(path, &m_findData);
+}
+
+DirectoryIteratorWindows::~DirectoryIteratorWindows()
+{
+    if (m_findHandle != INVALID_HANDLE_VALUE)
+        FindClose (m_findHandle);
+}
+
+
+
+void DirectoryIteratorWindows::reopen (const wchar_t* path)
+{
+    // Restarts iteration on a new directory path, closing the current one.
+
+    if (m_findHandle != INVALID_HANDLE_VALUE)
+        FindClose (m_findHandle);
+
+    m_started = false;
+    m_findHandle = FindFirstFileW(path, &m_findData);
+}
+
+
+
+bool DirectoryIteratorWindows::next()
+{
+    // Advances the iterator to the first/next entry.
+
+    if (m_findHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    if (!m_started)
+    {   m_started = true;
+        return true;
+    }
+
+    if (FindNextFileW(m_findHandle, &m_findData))
+        return true;
+
+    // Release the find handle as soon as the directory is exhausted, since a reused iterator may
+    // sit idle for some time before it's reopened.
+
+    FindClose (m_findHandle);
+    m_findHandle = INVALID_HANDLE_VALUE;
+    return false;
+}
+
+
+
+bool DirectoryIteratorWindows::isDirectory() const
+{
+    // Returns true if the current entry is a directory.
+    return 0 != (m_findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+
+
+const wchar_t* DirectoryIteratorWindows::name() const
+{
+    // Returns the name of the current entry.
+    return m_findData.cFileName;
+}
+
+
+
+DirectoryIterator* FileSysProxyWindows::newDirectoryIterator (const wstring path) const
+{
+    return new DirectoryIteratorWindows(path.c_str());
+}
+
+
+
+DirectoryIterator* FileSysProxyWindows::reuseDirectoryIterator (
+    DirectoryIterator* iterator,
+    const wchar_t*     path) const
+{
+    if (!iterator)
+        return new DirectoryIteratorWindows(path);
+
+    static_cast<DirectoryIteratorWindows*>(iterator)->reopen (path);
+    return iterator;
+}
+
+
+static uint64_t unixNanoseconds (const FILETIME& fileTime)
+{
+    // Converts a FILETIME (100ns ticks since 1601-01-01) to nanoseconds since 1970-01-01.
+
+    const uint64_t c_unixEpoch = 116444736000000000;   // 1970-01-01 in FILETIME ticks
+
+    auto ticks = (uint64_t(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+
+    return (ticks < c_unixEpoch) ? 0 : (ticks - c_unixEpoch) * 100;
+}
+
+
+bool FileSysProxyWindows::directoryTimes (
+    const wchar_t* path,
+    uint64_t&      modified,
+    uint64_t&      changed) const
+{
+    // Gets the directory's last write time, which changes as entries are added, removed or
+    // renamed, and its creation time, which changes if the directory is replaced.
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    if (!GetFileAttributesExW (path, GetFileExInfoStandard, &data))
+        return false;
+
+    if (0 == (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return false;
+
+    modified = unixNanoseconds (data.ftLastWriteTime);
+    changed  = unixNanoseconds (data.ftCreationTime);
+    return true;
+}
+
+
+bool FileSysProxyWindows::setCurrentDirectory (const wstring path)
+{
+    // Sets the current working directory. Returns true if the directory is valid.
+    m_currentDir = path;
+
+    // NOT YET IMPLEMENTED: For now, just always accept the directory.
+    return true;
+}
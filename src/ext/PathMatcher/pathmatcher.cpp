@@ -19,14 +19,38 @@
 
 #include "pathmatcher.h"
 
-#include <io.h>
 #include <string.h>
-#include <windows.h>
+#include <wchar.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include <stdio.h>
 #include <assert.h>
 
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+// The SSE2 and AVX2 literal run kernels build for x86 and x64 with MSVC, GCC or Clang. GCC and
+// Clang compile each vector kernel for its own instruction set, so the rest of the library needs
+// no special code generation flags, and the AVX2 kernels only run where the CPU supports them.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    #define PMATCHER_X86
+    #include <immintrin.h>
+#endif
+
+#if defined(PMATCHER_X86) && !defined(_MSC_VER)
+    #define PMATCHER_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define PMATCHER_TARGET(isa)
+#endif
+
 
 
 // =================================================================================================
@@ -68,6 +92,17 @@ static bool isMultiWildStr (const wchar_t* str)
 }
 
 
+static bool copyChars (wchar_t* dest, size_t destSize, const wchar_t* source, size_t count)
+{
+    // Copy 'count' characters of the source into the destination buffer, which holds 'destSize'
+    // characters, and terminate it. Return false if the characters and terminator don't fit.
+    if (count >= destSize) return false;
+    wmemcpy (dest, source, count);
+    dest[count] = 0;
+    return true;
+}
+
+
 
 bool wildComp (const wchar_t *pattern, const wchar_t *string)
 {
@@ -88,53 +123,10 @@ bool wildComp (const wchar_t *pattern, const wchar_t *string)
     //     the pattern or the string are null pointers.
     //==============================================================================================
 
-    if (!pattern || !string) return false;
-
-    // Scan through the single character matches.
-
-    while (*pattern && *string)
-    {
-        if (*pattern == L'*')  // If we've hit an asterisk, then drop down to the section below.
-            break;
-
-        // Stop testing on mismatch.
-
-        if ((*pattern != L'?') && (tolower(*pattern) != tolower(*string)))
-            break;
-
-        ++ pattern;    // On a successful match, increment the pattern and the string and continue.
-        ++ string;
-    }
-
-    // Unless we stopped on an asterisk, we're done matching. The only valid way to match at this
-    // point is if both the pattern and the string are exhausted.
-
-    if (*pattern != L'*')
-        return (*pattern == 0) && (*string == 0);
-
-    // Advance past the asterisk. Handle pathological cases where there is more than one asterisk
-    // in a row.
-
-    while (*pattern == L'*')
-        ++pattern;
-
-    // If the asterisk is the last character of the pattern, then we match any remainder,
-    // so return true.
-
-    if (*pattern == 0)
-        return true;
-
-    // We're at an asterisk with other patterns following, so recursively eat away at the string
-    // until we match or exhaust the string.
-
-    while (true)
-    {
-        if (wildComp (pattern, string))
-            return true;
+    // The pattern is compiled to an NFA (see CompiledPattern), so the match takes time linear in
+    // the string length, however many asterisks the pattern holds.
 
-        if (!*string++)
-            return false;
-    }
+    return CompiledPattern (pattern, CompiledPattern::Syntax::Wild).Match (string);
 }
 
 
@@ -157,53 +149,7 @@ bool wildCompCaseSensitive (const wchar_t *pattern, const wchar_t *string)
     //     the pattern or the string are null pointers.
     //==============================================================================================
 
-    if (!pattern || !string) return false;
-
-    // Scan through the single character matches.
-
-    while (*pattern && *string)
-    {
-        if (*pattern == L'*')  // If we've hit an asterisk, then drop down to the section below.
-            break;
-
-        // Stop testing on mismatch.
-
-        if ((*pattern != L'?') && (*pattern != *string))
-            break;
-
-        ++ pattern;    // On a successful match, increment the pattern and the string and continue.
-        ++ string;
-    }
-
-    // Unless we stopped on an asterisk, we're done matching. The only valid way to match at this
-    // point is if both the pattern and the string are exhausted.
-
-    if (*pattern != L'*')
-        return (*pattern == 0) && (*string == 0);
-
-    // Advance past the asterisk. Handle pathological cases where there is more than one asterisk
-    // in a row.
-
-    while (*pattern == L'*')
-        ++pattern;
-
-    // If the asterisk is the last character of the pattern, then we match any remainder,
-    // so return true.
-
-    if (*pattern == 0)
-        return true;
-
-    // We're at an asterisk with other patterns following, so recursively eat away at the string
-    // until we match or exhaust the string.
-
-    while (true)
-    {
-        if (wildCompCaseSensitive (pattern, string))
-            return true;
-
-        if (!*string++)
-            return false;
-    }
+    return CompiledPattern (pattern, CompiledPattern::Syntax::WildCaseSensitive).Match (string);
 }
 
 
@@ -239,149 +185,2055 @@ bool pathMatch (const wchar_t *pattern, const wchar_t *path)
     //     the pattern is null or empty, or if the path is null.
     //==============================================================================================
 
-    if (!pattern || !path) return false;
+    // The pattern is compiled to an NFA (see CompiledPattern), so the match takes time linear in
+    // the path length, however many asterisks and ellipses the pattern holds.
+
+    return CompiledPattern (pattern, CompiledPattern::Syntax::Path).Match (path);
+}
+
+
+
+//==================================================================================================
+// Literal Run Kernels
+//==================================================================================================
+
+// Most of a typical pattern is literal text. A CompiledPattern tests the literal runs of its
+// pattern (see below) with these kernels before running its NFA, so most non-matching strings are
+// rejected without stepping the NFA at all. Literal runs are stored already folded, and hold only
+// characters whose folding is plain ASCII, so the kernels need only fold 'A'..'Z' in the string.
+//
+// Each kernel comes in SSE2 and AVX2 forms (x86 and x64, built with MSVC, GCC or Clang), plus a
+// scalar fallback. Each vector lane holds one wchar_t, so a lane is 16 bits wide on Windows and 32
+// bits wide where wchar_t is 32 bits (as on Linux). The form is chosen once, at first use,
+// according to what the CPU and OS support. Tests and benchmarks can run any supported form
+// through EqualLiteral and FindLiteral.
+
+static wchar_t foldAscii (wchar_t c)
+{
+    // Returns the lower-case form of an ASCII letter, or the character unchanged.
+    return ((L'A' <= c) && (c <= L'Z')) ? static_cast<wchar_t>(c + (L'a' - L'A')) : c;
+}
+
+
+static bool equalLiteralScalar (const wchar_t *str, const wchar_t *lit, size_t count, bool fold)
+{
+    // Return true if the first 'count' characters of 'str' match the folded literal 'lit'.
+
+    for (size_t i = 0;  i < count;  ++i)
+    {
+        if ((fold ? foldAscii(str[i]) : str[i]) != lit[i])
+            return false;
+    }
+
+    return true;
+}
+
+
+static bool findLiteralScalar (
+    const wchar_t *str, size_t length, const wchar_t *lit, size_t count, bool fold)
+{
+    // Return true if 'str' (of 'length' characters) contains the folded literal 'lit' of 'count'
+    // characters.
+
+    for (size_t i = 0;  i + count <= length;  ++i)
+    {
+        if (equalLiteralScalar (str + i, lit, count, fold))
+            return true;
+    }
+
+    return false;
+}
+
+
+#ifdef PMATCHER_X86
+
+// A byte mask (from movemask) has one bit per byte, so sizeof(wchar_t) bits per lane. This keeps
+// the lowest bit of each lane.
+
+static const unsigned c_laneBits { (sizeof(wchar_t) == 2) ? 0x55555555u : 0x11111111u };
+
+static const size_t c_sse2Lanes { 16 / sizeof(wchar_t) };   // Characters per SSE2 vector
+static const size_t c_avx2Lanes { 32 / sizeof(wchar_t) };   // Characters per AVX2 vector
+
+
+static size_t firstLane (unsigned mask)
+{
+    // Returns the lane of the lowest set bit of a non-zero byte mask.
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward (&bit, mask);
+    return bit / sizeof(wchar_t);
+#else
+    return static_cast<size_t>(__builtin_ctz (mask)) / sizeof(wchar_t);
+#endif
+}
+
+
+PMATCHER_TARGET("sse2")
+static __m128i splatSSE2 (wchar_t c)
+{
+    return (sizeof(wchar_t) == 2) ? _mm_set1_epi16 (static_cast<short>(c))
+                                  : _mm_set1_epi32 (static_cast<int>(c));
+}
+
+
+PMATCHER_TARGET("sse2")
+static __m128i equalLanesSSE2 (__m128i a, __m128i b)
+{
+    return (sizeof(wchar_t) == 2) ? _mm_cmpeq_epi16 (a, b) : _mm_cmpeq_epi32 (a, b);
+}
+
+
+PMATCHER_TARGET("sse2")
+static __m128i foldSSE2 (__m128i chars)
+{
+    // Folds each lane, adding 0x20 to characters in 'A'..'Z'. (In 16-bit lanes, characters at or
+    // above 0x8000 compare as negative, so they are never folded.)
+
+    __m128i upper;
+
+    if (sizeof(wchar_t) == 2)
+        upper = _mm_and_si128 (_mm_cmpgt_epi16 (chars, splatSSE2 (L'A' - 1)),
+                               _mm_cmplt_epi16 (chars, splatSSE2 (L'Z' + 1)));
+    else
+        upper = _mm_and_si128 (_mm_cmpgt_epi32 (chars, splatSSE2 (L'A' - 1)),
+                               _mm_cmplt_epi32 (chars, splatSSE2 (L'Z' + 1)));
+
+    auto offset = _mm_and_si128 (upper, splatSSE2 (L'a' - L'A'));
+
+    return (sizeof(wchar_t) == 2) ? _mm_add_epi16 (chars, offset) : _mm_add_epi32 (chars, offset);
+}
+
+
+PMATCHER_TARGET("sse2")
+static bool equalLiteralSSE2 (const wchar_t *str, const wchar_t *lit, size_t count, bool fold)
+{
+    size_t i = 0;
+
+    for (;  i + c_sse2Lanes <= count;  i += c_sse2Lanes)
+    {
+        auto chars = _mm_loadu_si128 (reinterpret_cast<const __m128i*>(str + i));
+        if (fold) chars = foldSSE2 (chars);
+
+        auto litChars = _mm_loadu_si128 (reinterpret_cast<const __m128i*>(lit + i));
+        auto same     = equalLanesSSE2 (chars, litChars);
+
+        if (_mm_movemask_epi8 (same) != 0xffff)
+            return false;
+    }
+
+    return equalLiteralScalar (str + i, lit + i, count - i, fold);
+}
+
+
+PMATCHER_TARGET("sse2")
+static bool findLiteralSSE2 (
+    const wchar_t *str, size_t length, const wchar_t *lit, size_t count, bool fold)
+{
+    // Compares a vector of candidate positions at a time against the first and last characters of
+    // the literal, and only compares the full literal at positions where both match.
+
+    if (count == 0) return true;
+
+    auto first = splatSSE2 (lit[0]);
+    auto last  = splatSSE2 (lit[count - 1]);
+
+    size_t i = 0;
+
+    for (;  i + count - 1 + c_sse2Lanes <= length;  i += c_sse2Lanes)
+    {
+        auto head = _mm_loadu_si128 (reinterpret_cast<const __m128i*>(str + i));
+        auto tail = _mm_loadu_si128 (reinterpret_cast<const __m128i*>(str + i + count - 1));
+
+        if (fold)
+        {   head = foldSSE2 (head);
+            tail = foldSSE2 (tail);
+        }
+
+        auto hits = _mm_and_si128 (equalLanesSSE2 (head, first), equalLanesSSE2 (tail, last));
+        auto candidates = static_cast<unsigned>(_mm_movemask_epi8 (hits)) & c_laneBits;
+
+        for (; candidates;  candidates &= candidates - 1)
+        {
+            if (equalLiteralSSE2 (str + i + firstLane (candidates), lit, count, fold))
+                return true;
+        }
+    }
+
+    return findLiteralScalar (str + i, length - i, lit, count, fold);
+}
+
+
+PMATCHER_TARGET("avx2")
+static __m256i splatAVX2 (wchar_t c)
+{
+    return (sizeof(wchar_t) == 2) ? _mm256_set1_epi16 (static_cast<short>(c))
+                                  : _mm256_set1_epi32 (static_cast<int>(c));
+}
+
+
+PMATCHER_TARGET("avx2")
+static __m256i equalLanesAVX2 (__m256i a, __m256i b)
+{
+    return (sizeof(wchar_t) == 2) ? _mm256_cmpeq_epi16 (a, b) : _mm256_cmpeq_epi32 (a, b);
+}
+
+
+PMATCHER_TARGET("avx2")
+static __m256i foldAVX2 (__m256i chars)
+{
+    // Folds each lane; see foldSSE2.
+
+    __m256i upper;
+
+    if (sizeof(wchar_t) == 2)
+        upper = _mm256_and_si256 (_mm256_cmpgt_epi16 (chars, splatAVX2 (L'A' - 1)),
+                                  _mm256_cmpgt_epi16 (splatAVX2 (L'Z' + 1), chars));
+    else
+        upper = _mm256_and_si256 (_mm256_cmpgt_epi32 (chars, splatAVX2 (L'A' - 1)),
+                                  _mm256_cmpgt_epi32 (splatAVX2 (L'Z' + 1), chars));
+
+    auto offset = _mm256_and_si256 (upper, splatAVX2 (L'a' - L'A'));
+
+    return (sizeof(wchar_t) == 2) ? _mm256_add_epi16 (chars, offset)
+                                  : _mm256_add_epi32 (chars, offset);
+}
+
+
+PMATCHER_TARGET("avx2")
+static bool equalLiteralAVX2 (const wchar_t *str, const wchar_t *lit, size_t count, bool fold)
+{
+    size_t i = 0;
+
+    for (;  i + c_avx2Lanes <= count;  i += c_avx2Lanes)
+    {
+        auto chars = _mm256_loadu_si256 (reinterpret_cast<const __m256i*>(str + i));
+        if (fold) chars = foldAVX2 (chars);
+
+        auto litChars = _mm256_loadu_si256 (reinterpret_cast<const __m256i*>(lit + i));
+        auto same     = equalLanesAVX2 (chars, litChars);
+
+        if (static_cast<unsigned>(_mm256_movemask_epi8 (same)) != 0xffffffffu)
+            return false;
+    }
+
+    // Clear the upper halves of the YMM registers before running SSE2 code, which GCC and Clang
+    // build without VEX encoding; mixing the two encodings stalls every SSE2 instruction.
+
+    _mm256_zeroupper ();
+    return equalLiteralSSE2 (str + i, lit + i, count - i, fold);
+}
+
+
+PMATCHER_TARGET("avx2")
+static bool findLiteralAVX2 (
+    const wchar_t *str, size_t length, const wchar_t *lit, size_t count, bool fold)
+{
+    // Twice the candidate positions at a time; see findLiteralSSE2.
+
+    if (count == 0) return true;
+
+    auto first = splatAVX2 (lit[0]);
+    auto last  = splatAVX2 (lit[count - 1]);
+
+    size_t i = 0;
+
+    for (;  i + count - 1 + c_avx2Lanes <= length;  i += c_avx2Lanes)
+    {
+        auto head = _mm256_loadu_si256 (reinterpret_cast<const __m256i*>(str + i));
+        auto tail = _mm256_loadu_si256 (reinterpret_cast<const __m256i*>(str + i + count - 1));
+
+        if (fold)
+        {   head = foldAVX2 (head);
+            tail = foldAVX2 (tail);
+        }
+
+        auto hits = _mm256_and_si256 (equalLanesAVX2 (head, first), equalLanesAVX2 (tail, last));
+        auto candidates = static_cast<unsigned>(_mm256_movemask_epi8 (hits)) & c_laneBits;
+
+        for (; candidates;  candidates &= candidates - 1)
+        {
+            if (equalLiteralAVX2 (str + i + firstLane (candidates), lit, count, fold))
+                return true;
+        }
+    }
+
+    _mm256_zeroupper ();   // See equalLiteralAVX2
+    return findLiteralSSE2 (str + i, length - i, lit, count, fold);
+}
+
+
+static bool cpuHasAVX2 ()
+{
+    // Return true if both the CPU and the OS (which must save the YMM registers) support AVX2.
+
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid (info, 0);
+    if (info[0] < 7) return false;
+
+    __cpuid (info, 1);
+    auto osxsave = (info[2] & (1 << 27)) != 0;
+    auto avx     = (info[2] & (1 << 28)) != 0;
+
+    if (!osxsave || !avx || ((_xgetbv(0) & 6) != 6))
+        return false;
+
+    __cpuidex (info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    // The compiler's CPU check only reports AVX2 when the OS has enabled the YMM state.
+
+    __builtin_cpu_init ();
+    return __builtin_cpu_supports ("avx2");
+#endif
+}
+
+#endif
+
+
+struct LiteralKernels
+{
+    bool (*equal) (const wchar_t *str, const wchar_t *lit, size_t count, bool fold);
+    bool (*find)  (const wchar_t *str, size_t length, const wchar_t *lit, size_t count, bool fold);
+};
+
+static const LiteralKernels c_scalarKernels { equalLiteralScalar, findLiteralScalar };
+
+#ifdef PMATCHER_X86
+static const LiteralKernels c_sse2Kernels { equalLiteralSSE2, findLiteralSSE2 };
+static const LiteralKernels c_avx2Kernels { equalLiteralAVX2, findLiteralAVX2 };
+#endif
+
+
+static const LiteralKernels* literalKernels (KernelForm form)
+{
+    // Returns the literal kernels of the given form, or null if this machine can't run them. The
+    // best form is chosen on first call.
+
+#ifdef PMATCHER_X86
+    static const bool hasAVX2 = cpuHasAVX2();
+#endif
+
+    switch (form)
+    {
+        case KernelForm::Scalar: return &c_scalarKernels;
+
+#ifdef PMATCHER_X86
+        case KernelForm::Best:   return hasAVX2 ? &c_avx2Kernels : &c_sse2Kernels;
+        case KernelForm::SSE2:   return &c_sse2Kernels;
+        case KernelForm::AVX2:   return hasAVX2 ? &c_avx2Kernels : nullptr;
+#else
+        case KernelForm::Best:   return &c_scalarKernels;
+#endif
+
+        default:                 return nullptr;
+    }
+}
+
+
+bool KernelFormSupported (KernelForm form)
+{
+    return literalKernels (form) != nullptr;
+}
+
+
+bool EqualLiteral (
+    KernelForm form, const wchar_t *str, const wchar_t *lit, size_t count, bool fold)
+{
+    auto kernels = literalKernels (form);
+    return kernels && kernels->equal (str, lit, count, fold);
+}
+
+
+bool FindLiteral (
+    KernelForm form, const wchar_t *str, size_t length, const wchar_t *lit, size_t count,
+    bool fold)
+{
+    auto kernels = literalKernels (form);
+    return kernels && kernels->find (str, length, lit, count, fold);
+}
+
+
+
+//==================================================================================================
+// Batch Matching
+//==================================================================================================
+
+// Batches are split across threads in slices of at least this many strings.
+
+static const size_t c_minBatchSlice { 1024 };
+
+
+class BatchPool
+{
+    //--------------------------------------------------------------------------
+    // A BatchPool runs the slices of a batch (see batchSliced) on a set of
+    // threads that persist from one batch to the next, sleeping in between.
+    // There is one pool per process, started by the first batch. It runs one
+    // batch at a time; a batch begun while another is running runs all of its
+    // slices on its calling thread instead.
+    //--------------------------------------------------------------------------
+
+  public:
+
+    static BatchPool& Instance ();
+
+    // The number of threads that run a batch's slices, the calling thread included.
+
+    size_t NumThreads () const { return m_workers.size() + 1; }
+
+    // Runs runSlice(slice) for each slice in [0,numSlices), on the pool threads and the calling
+    // thread, and returns once all of them are done.
+
+    void Run (size_t numSlices, const std::function<void (size_t)>& runSlice);
+
+  private:
+
+    BatchPool ();
+    ~BatchPool ();
+
+    void Work ();
+    void RunSlices ();
+
+    vector<std::thread>     m_workers;               // Worker threads
+    std::mutex              m_batchLock;             // Held by the thread whose batch is running
+
+    std::mutex              m_lock;                  // Guards the batch state below
+    std::condition_variable m_workSignal;            // Signalled as each batch starts
+    std::condition_variable m_doneSignal;            // Signalled as workers finish a batch
+    uint64_t                m_batch { 0 };           // Batch sequence number
+    bool                    m_shutdown { false };    // True => workers exit
+    size_t                  m_active { 0 };          // Workers running the current batch
+
+    const std::function<void (size_t)>* m_runSlice { nullptr };   // Current batch's slice function
+    size_t                              m_numSlices { 0 };        // Current batch's slice count
+    std::atomic<size_t>                 m_nextSlice { 0 };        // Next slice to take
+};
+
+
+BatchPool& BatchPool::Instance ()
+{
+    static BatchPool pool;
+    return pool;
+}
+
+
+BatchPool::BatchPool ()
+{
+    // The calling thread of each batch runs slices too, so it needs one fewer worker than cores.
+
+    auto numThreads = std::max (1u, std::thread::hardware_concurrency());
+
+    for (size_t worker = 1;  worker < numThreads;  ++worker)
+        m_workers.emplace_back (&BatchPool::Work, this);
+}
+
+
+BatchPool::~BatchPool ()
+{
+    {
+        std::lock_guard<std::mutex> lock { m_lock };
+        m_shutdown = true;
+    }
+
+    m_workSignal.notify_all();
+
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+
+void BatchPool::Run (size_t numSlices, const std::function<void (size_t)>& runSlice)
+{
+    std::unique_lock<std::mutex> batchLock { m_batchLock, std::try_to_lock };
+
+    if (!batchLock.owns_lock() || (numSlices < 2))
+    {
+        for (size_t slice = 0;  slice < numSlices;  ++slice)
+            runSlice (slice);
+        return;
+    }
+
+    {
+        // A worker that woke late for the last batch may still be finding it done.
+
+        std::unique_lock<std::mutex> lock { m_lock };
+        m_doneSignal.wait (lock, [this] { return m_active == 0; });
+
+        m_runSlice  = &runSlice;
+        m_numSlices = numSlices;
+        m_nextSlice = 0;
+        ++m_batch;
+    }
+
+    m_workSignal.notify_all();
+
+    RunSlices();
+
+    // Every slice has been taken. Wait for the workers that took one (or are about to find none
+    // left) to finish, so that none is still looking at this batch when the next one starts.
+
+    std::unique_lock<std::mutex> lock { m_lock };
+    m_doneSignal.wait (lock, [this] { return m_active == 0; });
+    m_runSlice = nullptr;
+}
+
+
+void BatchPool::Work ()
+{
+    // The body of each worker thread. Sleeps until a batch starts, then takes slices until none
+    // are left.
+
+    uint64_t lastBatch = 0;
+
+    std::unique_lock<std::mutex> lock { m_lock };
+
+    while (true)
+    {
+        m_workSignal.wait (lock, [&] { return m_shutdown || (m_batch != lastBatch); });
+
+        if (m_shutdown)
+            return;
+
+        lastBatch = m_batch;
+        ++m_active;
+
+        lock.unlock();
+        RunSlices();
+        lock.lock();
+
+        if (--m_active == 0)
+            m_doneSignal.notify_all();
+    }
+}
+
+
+void BatchPool::RunSlices ()
+{
+    for (auto slice = m_nextSlice++;  slice < m_numSlices;  slice = m_nextSlice++)
+        (*m_runSlice) (slice);
+}
+
+
+template <typename Result, typename Test>
+static void batchSliced (size_t count, vector<Result>& results, Test test)
+{
+    //==============================================================================================
+    // batchSliced
+    //     Runs test(i, sliceResults) for each index i in [0,count). A batch large enough to be
+    //     worth it is cut into one contiguous slice per pool thread (of at least c_minBatchSlice
+    //     indices), and run on the BatchPool. Each slice collects its own results, and the slices
+    //     are then joined in order, so the result does not depend on thread scheduling.
+    //==============================================================================================
+
+    auto& pool = BatchPool::Instance();
+
+    auto numSlices = std::min<size_t> (pool.NumThreads(),
+                                       std::max<size_t> (1, count / c_minBatchSlice));
+
+    vector<vector<Result>> sliceResults (numSlices);
+
+    pool.Run (numSlices, [&](size_t slice)
+    {
+        auto begin = count * slice / numSlices;
+        auto end   = count * (slice + 1) / numSlices;
+
+        for (auto i = begin;  i < end;  ++i)
+            test (i, sliceResults[slice]);
+    });
+
+    for (auto& slice : sliceResults)
+        results.insert (results.end(), slice.begin(), slice.end());
+}
+
+
+
+//==================================================================================================
+// CompiledPattern Class Implementation
+//==================================================================================================
+
+// A compiled pattern is a sequence of tokens, and its NFA has one state per token (the state of
+// having matched every prior token), plus a final accepting state. A set of live states is a bit
+// mask, so each string character advances every live state at once with a few word operations.
+//
+// Path characters fall into two classes: slashes (path syntax only, where a run of slashes counts
+// as a single slash), and ordinary characters (everything else). Each token has a bit in the
+// following masks:
+
+static const size_t c_maskAny       { 0 };   // '?': consumes one ordinary character
+static const size_t c_maskSlash     { 1 };   // Slash: consumes one slash
+static const size_t c_maskLoop      { 2 };   // '*' or '...': loops on an ordinary character
+static const size_t c_maskSlashLoop { 3 };   // '...': loops on a slash
+static const size_t c_numFixedMasks { 4 };   // Literal characters each get a mask after these.
+
+static const size_t c_noMask { SIZE_MAX };   // m_asciiMasks entry for a non-literal character
+
+// Words of state mask kept on the stack while matching; longer patterns use the heap.
+
+static const size_t c_stackWords { 8 };
+
+CompiledPattern::CompiledPattern (const wchar_t *pattern, Syntax syntax)
+{
+    Compile (pattern, syntax);
+}
+
+
+
+wchar_t CompiledPattern::Fold (wchar_t c) const
+{
+    // Returns the character as compared by the pattern syntax.
+    return (m_syntax == Syntax::WildCaseSensitive) ? c : static_cast<wchar_t>(tolower(c));
+}
+
+
+
+bool CompiledPattern::Compile (const wchar_t *pattern, Syntax syntax)
+{
+    // Compiles a null-terminated pattern.
+    return Compile (pattern, pattern ? wcslen(pattern) : 0, syntax);
+}
+
+
+
+bool CompiledPattern::Compile (const wchar_t *pattern, size_t length, Syntax syntax)
+{
+    //==============================================================================================
+    // Compile
+    //     Parses the pattern into the NFA state masks. In path syntax, runs of slashes become a
+    //     single slash token, and a run of asterisks and ellipses becomes one ellipsis if it holds
+    //     any ellipsis, otherwise one asterisk (just as pathMatch collapses them). In wildcard
+    //     syntax, a run of asterisks becomes a single match-anything token.
+    //
+    // Parameters
+    //     pattern - The pattern to compile, which need not be null-terminated
+    //     length  - The number of pattern characters to compile
+    //     syntax  - The matching function whose semantics the pattern follows
+    //
+    // Returns
+    //     True if the pattern compiled, or false if the pattern is null.
+    //==============================================================================================
+
+    m_syntax = syntax;
+    m_valid = false;
+    m_acceptsRest = false;
+    m_literalsDecide = false;
+    m_numStates = m_numWords = 0;
+    m_masks.clear();
+    m_literalMasks.clear();
+    m_epsilons.clear();
+    m_prefix.clear();
+    m_required.clear();
+    m_suffix.clear();
+
+    if (!pattern) return false;
+
+    auto end        = pattern + length;
+    auto pathSyntax = (syntax == Syntax::Path);
+
+    // A multi-wild is an asterisk, or in path syntax, an ellipsis that lies wholly in the pattern.
+
+    auto isMultiWild = [=] (const wchar_t* p)
+    {
+        return (p < end) && ((*p == L'*') || (pathSyntax && (end - p >= 3) && isEllipsis(p)));
+    };
+
+    // Tokenize the pattern. Each token is one of the fixed mask slots, a literal character, or a
+    // gate. A gate consumes nothing; it precedes a multi-wild that is followed by a slash, and
+    // leads either into the multi-wild, or (since ".../foo" matches "foo") past the slash.
+
+    struct Token
+    {
+        size_t  kind;       // c_maskAny, c_maskSlash, c_maskLoop, c_literal or c_gate
+        bool    ellipsis;   // For c_maskLoop, also loop on slashes
+        wchar_t literal;    // Folded literal character
+    };
+
+    static const size_t c_literal { c_numFixedMasks };
+    static const size_t c_gate    { c_numFixedMasks + 1 };
+
+    vector<Token> tokens;
+
+    while (pattern < end)
+    {
+        if (isMultiWild(pattern))
+        {
+            auto fEllipsis = !pathSyntax;
+
+            while (isMultiWild(pattern))
+            {
+                if (pattern[0] == L'*')
+                    pattern += 1;
+                else
+                {   pattern += 3;
+                    fEllipsis = true;
+                }
+            }
+
+            if (pathSyntax && (pattern < end) && isSlash(*pattern))
+                tokens.push_back ({ c_gate, false, 0 });
+
+            tokens.push_back ({ c_maskLoop, fEllipsis, 0 });
+        }
+        else if (pathSyntax && isSlash(*pattern))
+        {
+            while ((pattern < end) && isSlash(*pattern))
+                ++ pattern;
+
+            tokens.push_back ({ c_maskSlash, false, 0 });
+        }
+        else if (*pattern == L'?')
+        {
+            tokens.push_back ({ c_maskAny, false, 0 });
+            ++ pattern;
+        }
+        else
+        {
+            tokens.push_back ({ c_literal, false, Fold(*pattern) });
+            ++ pattern;
+        }
+    }
+
+    // Build the state masks. Token i is represented by bit i; the final state is bit tokens.size().
+
+    m_numStates = tokens.size() + 1;
+    m_numWords  = (m_numStates + 63) / 64;
+    m_masks.assign (c_numFixedMasks * m_numWords, 0);
+
+    for (size_t i = 0;  i < tokens.size();  ++i)
+    {
+        auto& token = tokens[i];
+        auto  bit   = uint64_t(1) << (i % 64);
+        auto  word  = i / 64;
+        auto  state = static_cast<uint32_t>(i);
+
+        if (token.kind == c_gate)
+        {
+            m_epsilons.push_back ({ state, state + 1 });
+            m_epsilons.push_back ({ state, state + 3 });
+            continue;
+        }
+
+        if (token.kind == c_literal)
+        {
+            auto found = m_literalMasks.find (token.literal);
+
+            if (found == m_literalMasks.end())
+            {
+                found = m_literalMasks.emplace (token.literal, m_masks.size()).first;
+                m_masks.resize (m_masks.size() + m_numWords, 0);
+            }
+
+            m_masks[found->second + word] |= bit;
+            continue;
+        }
+
+        m_masks[token.kind * m_numWords + word] |= bit;
+
+        if (token.kind != c_maskLoop)
+            continue;
+
+        if (token.ellipsis)
+            m_masks[c_maskSlashLoop * m_numWords + word] |= bit;
+
+        m_epsilons.push_back ({ state, state + 1 });    // A multi-wild may match the empty string.
+    }
+
+    // Map each ASCII string character straight to its literal mask, to skip the folding and hash
+    // lookup for the common case.
+
+    for (wchar_t c = 0;  c < 128;  ++c)
+    {
+        auto found = m_literalMasks.find (Fold(c));
+        m_asciiMasks[c] = (found == m_literalMasks.end()) ? c_noMask : found->second;
+    }
+
+    // Find the literal runs: maximal sequences of literal tokens that fold as plain ASCII. Every
+    // match holds each run as consecutive characters, and a leading (trailing) run must begin
+    // (end) the string. Keep the leading and trailing runs, and the longest of the others.
+
+    m_foldLiterals = (syntax != Syntax::WildCaseSensitive);
+
+    size_t runStart  = 0;
+    size_t innerRuns = 0;
+
+    for (size_t i = 0;  i <= tokens.size();  ++i)
+    {
+        if ((i < tokens.size()) && (tokens[i].kind == c_literal)
+            && (!m_foldLiterals || (tokens[i].literal < 0x80)))
+        {
+            continue;
+        }
+
+        if (i > runStart)
+        {
+            wstring run;
+
+            for (auto j = runStart;  j < i;  ++j)
+                run += tokens[j].literal;
+
+            if (runStart == 0)
+                m_prefix = run;
+            else if (i == tokens.size())
+                m_suffix = run;
+            else
+            {
+                ++innerRuns;
+
+                if (run.size() > m_required.size())
+                    m_required = run;
+            }
+        }
+
+        runStart = i + 1;
+    }
+
+    // If the pattern ends in a match-anything token, then any string that reaches it matches.
+
+    m_acceptsRest = !tokens.empty() && (tokens.back().kind == c_maskLoop) && tokens.back().ellipsis;
+
+    // If the pattern is nothing but literal runs separated by match-anything tokens, with no more
+    // than one inner run, then a string that holds the runs (without overlap, which the length
+    // check rules out) matches. Such patterns, like "*foo*" or "foo*bar", are decided by the
+    // literal run kernels alone, without stepping the NFA.
+
+    auto loops = std::count_if (tokens.begin(), tokens.end(),
+                                [] (const Token& token) { return token.kind == c_maskLoop; });
+
+    auto onlyRunsAndLoops = std::all_of (tokens.begin(), tokens.end(), [this] (const Token& token)
+    {
+        if (token.kind == c_maskLoop)
+            return token.ellipsis;
+
+        return (token.kind == c_literal) && (!m_foldLiterals || (token.literal < 0x80));
+    });
+
+    m_literalsDecide = (loops > 0) && onlyRunsAndLoops && (innerRuns <= 1);
+
+    return m_valid = true;
+}
+
+
+
+void CompiledPattern::Close (uint64_t *states) const
+{
+    // Adds to the given state set every state reachable from it without consuming a character. The
+    // empty transitions only ever lead forward, so one ascending pass reaches them all.
+
+    for (auto& epsilon : m_epsilons)
+    {
+        if (states[epsilon.from / 64] & (uint64_t(1) << (epsilon.from % 64)))
+            states[epsilon.to / 64] |= uint64_t(1) << (epsilon.to % 64);
+    }
+}
+
+
+
+bool CompiledPattern::Match (const wchar_t *string) const
+{
+    //==============================================================================================
+    // Match
+    //     Checks the string against the pattern's literal runs, and then runs it through the
+    //     pattern NFA. This takes time proportional to the string length times the number of state
+    //     mask words, and never backtracks.
+    //
+    // Parameters
+    //     string - The string to test for matching
+    //
+    // Returns
+    //     True if and only if the pattern matches the string. This function returns false if the
+    //     pattern is not valid or the string is null.
+    //==============================================================================================
+
+    if (!m_valid || !string) return false;
+
+    // Reject strings that lack the literal runs before stepping the NFA. The NFA then starts just
+    // past the leading run.
+
+    auto& kernels = *literalKernels (KernelForm::Best);
+    auto  length  = wcslen (string);
+
+    if (length < m_prefix.size() + m_required.size() + m_suffix.size())
+        return false;
+
+    if (!kernels.equal (string, m_prefix.data(), m_prefix.size(), m_foldLiterals))
+        return false;
+
+    if (!kernels.equal (string + length - m_suffix.size(), m_suffix.data(), m_suffix.size(),
+                        m_foldLiterals))
+        return false;
+
+    if (!m_required.empty() &&
+        !kernels.find (string + m_prefix.size(), length - m_prefix.size() - m_suffix.size(),
+                       m_required.data(), m_required.size(), m_foldLiterals))
+        return false;
+
+    if (m_literalsDecide)
+        return true;
+
+    uint64_t stackStates [2 * c_stackWords];
+    vector<uint64_t> heapStates;
+
+    auto states = stackStates;
+
+    if (m_numWords > c_stackWords)
+    {   heapStates.resize (2 * m_numWords);
+        states = heapStates.data();
+    }
+
+    auto live = states;
+    auto next = states + m_numWords;
+
+    auto finalWord = (m_numStates - 1) / 64;
+    auto finalBit  = uint64_t(1) << ((m_numStates - 1) % 64);
+
+    auto start = m_prefix.size();
+
+    std::fill (live, live + m_numWords, 0);
+    live[start / 64] = uint64_t(1) << (start % 64);
+    Close (live);
+
+    string += start;
+
+    auto pathSyntax = (m_syntax == Syntax::Path);
+
+    for (; *string;  ++string)
+    {
+        if (m_acceptsRest && (live[finalWord] & finalBit))
+            return true;
+
+        const uint64_t* advance;       // Tokens that consume this character
+        const uint64_t* loop;          // Tokens that loop on this character
+        const uint64_t* literal { nullptr };
+
+        if (pathSyntax && isSlash(*string))
+        {
+            while (isSlash(string[1]))  // Consume repeated slashes.
+                ++ string;
+
+            advance = &m_masks[c_maskSlash * m_numWords];
+            loop    = &m_masks[c_maskSlashLoop * m_numWords];
+        }
+        else
+        {
+            advance = &m_masks[c_maskAny * m_numWords];
+            loop    = &m_masks[c_maskLoop * m_numWords];
+
+            if (static_cast<size_t>(*string) < 128)
+            {
+                if (m_asciiMasks[*string] != c_noMask)
+                    literal = &m_masks[m_asciiMasks[*string]];
+            }
+            else
+            {
+                auto found = m_literalMasks.find (Fold(*string));
+
+                if (found != m_literalMasks.end())
+                    literal = &m_masks[found->second];
+            }
+        }
+
+        // Each live state either loops on the character, or advances to the next state.
+
+        uint64_t carry { 0 };
+        uint64_t any { 0 };
+
+        for (size_t w = 0;  w < m_numWords;  ++w)
+        {
+            auto step = live[w] & (advance[w] | (literal ? literal[w] : 0));
+            next[w] = (step << 1) | carry | (live[w] & loop[w]);
+            carry = step >> 63;
+            any |= next[w];
+        }
+
+        if (!any) return false;
+
+        Close (next);
+        std::swap (live, next);
+    }
+
+    return 0 != (live[finalWord] & finalBit);
+}
+
+
+
+void CompiledPattern::MatchAll (
+    const wchar_t* const strings[],
+    size_t               count,
+    vector<size_t>&      matches) const
+{
+    //==============================================================================================
+    // MatchAll
+    //     Tests the pattern against each string of a batch, split across threads by batchSliced.
+    //
+    // Parameters
+    //     strings - The strings to test
+    //     count   - The number of strings
+    //     matches - Receives the indices of the matching strings, in ascending order
+    //==============================================================================================
+
+    batchSliced (count, matches, [&](size_t i, vector<size_t>& sliceMatches)
+    {
+        if (Match (strings[i]))
+            sliceMatches.push_back (i);
+    });
+}
+
+
+
+//==================================================================================================
+// SparsePattern Class Implementation
+//==================================================================================================
+
+// A sparse match is found with bit sets over the string positions. A single pass over the string
+// builds one set per distinct pattern character (the positions holding that character), plus the
+// sets of positions that begin a path component or a word. Placing each pattern character is then
+// a handful of word operations on these sets, rather than a scan of the string.
+
+static const size_t c_sparseWords { SparsePattern::c_maxStringLength / 64 };   // Words per bit set
+
+static const uint8_t c_noSlot { 0xff };   // m_asciiSlots entry for a character not in the pattern
+
+// Score terms
+
+static const int c_sparseCharScore      { 16 };   // Each matched character
+static const int c_sparseAdjacentBonus  { 16 };   // Character immediately follows the previous one
+static const int c_sparseComponentBonus { 24 };   // Character begins a path component
+static const int c_sparseWordBonus      { 12 };   // Character begins a word within a component
+static const int c_sparseTailBonus      {  8 };   // Character lies in the final path component
+static const int c_sparseMaxGapPenalty  {  8 };   // Most that the gap before a character costs
+
+
+static bool isWordBreak (const wchar_t c)
+{
+    // Return true if and only if the character separates words within a path component.
+    return (c == L' ') || (c == L'-') || (c == L'_') || (c == L'.');
+}
+
+
+static int lowestBit (uint64_t word)
+{
+    // Returns the index of the lowest set bit of a non-zero word.
+#ifdef _MSC_VER
+    unsigned long bit;
+    if (_BitScanForward (&bit, static_cast<unsigned long>(word)))
+        return static_cast<int>(bit);
+    _BitScanForward (&bit, static_cast<unsigned long>(word >> 32));
+    return static_cast<int>(bit) + 32;
+#else
+    return __builtin_ctzll (word);
+#endif
+}
+
+
+static int highestBit (uint64_t word)
+{
+    // Returns the index of the highest set bit of a non-zero word.
+#ifdef _MSC_VER
+    unsigned long bit;
+    if (_BitScanReverse (&bit, static_cast<unsigned long>(word >> 32)))
+        return static_cast<int>(bit) + 32;
+    _BitScanReverse (&bit, static_cast<unsigned long>(word));
+    return static_cast<int>(bit);
+#else
+    return 63 - __builtin_clzll (word);
+#endif
+}
+
+
+static bool testBit (const uint64_t *set, int position)
+{
+    // Returns true if the given position is in the bit set.
+    return (set[position / 64] >> (position % 64)) & 1;
+}
+
+
+static int highestBelow (const uint64_t *set, int limit)
+{
+    // Returns the highest position in the bit set that is less than the limit, or -1 if none.
+
+    if (limit <= 0) return -1;
+
+    auto word = (limit - 1) / 64;
+    auto bits = set[word] & (~uint64_t(0) >> (63 - (limit - 1) % 64));
+
+    while (!bits)
+    {
+        if (--word < 0) return -1;
+        bits = set[word];
+    }
+
+    return word * 64 + highestBit (bits);
+}
+
+
+static int lowestWithin (const uint64_t *set, const uint64_t *filter, int first, int last)
+{
+    // Returns the lowest position in the range [first,last] that is in the bit set (and also in the
+    // filter set, if one is given), or -1 if none.
+
+    if (first > last) return -1;
+
+    auto lastWord = last / 64;
+
+    for (auto word = first / 64;  word <= lastWord;  ++word)
+    {
+        auto bits = set[word];
+        if (filter) bits &= filter[word];
+
+        if (word == first / 64) bits &= ~uint64_t(0) << (first % 64);
+        if (word == lastWord)   bits &= ~uint64_t(0) >> (63 - last % 64);
+
+        if (bits)
+            return word * 64 + lowestBit (bits);
+    }
+
+    return -1;
+}
+
+
+
+SparsePattern::SparsePattern (const wchar_t *pattern)
+{
+    Compile (pattern);
+}
+
+
+
+wchar_t SparsePattern::Fold (wchar_t c)
+{
+    // Returns the character as compared by a sparse match.
+    return isSlash(c) ? L'/' : static_cast<wchar_t>(tolower(c));
+}
+
+
+
+size_t SparsePattern::Slot (wchar_t c) const
+{
+    // Returns the slot of the given (unfolded) string character, or c_noSlot if the pattern does
+    // not hold it.
+
+    if (c < 128)
+        return m_asciiSlots[c];
+
+    auto slot = m_slotChars.find (Fold(c));
+    return (slot == wstring::npos) ? c_noSlot : slot;
+}
+
+
+
+bool SparsePattern::Compile (const wchar_t *pattern)
+{
+    //==============================================================================================
+    // Compile
+    //     Compiles a sparse pattern. Each distinct (folded) pattern character gets a slot, and
+    //     every ASCII character that folds to a slotted character is entered in m_asciiSlots.
+    //
+    // Parameters
+    //     pattern - The sparse pattern (without any escape character that denoted it as sparse)
+    //
+    // Return
+    //     True if the pattern is valid.
+    //==============================================================================================
+
+    m_valid = false;
+    m_slotChars.clear();
+    m_charSlots.clear();
+    std::fill (std::begin(m_asciiSlots), std::end(m_asciiSlots), c_noSlot);
+
+    if (!pattern || !*pattern || (wcslen(pattern) > c_maxPatternLength))
+        return false;
+
+    for (auto p = pattern;  *p;  ++p)
+    {
+        auto c    = Fold (*p);
+        auto slot = m_slotChars.find (c);
+
+        if (slot == wstring::npos)
+        {
+            slot = m_slotChars.size();
+            m_slotChars.push_back (c);
+        }
+
+        m_charSlots.push_back (static_cast<uint8_t>(slot));
+    }
+
+    for (wchar_t c = 0;  c < 128;  ++c)
+    {
+        auto slot = m_slotChars.find (Fold(c));
+        if (slot != wstring::npos)
+            m_asciiSlots[c] = static_cast<uint8_t>(slot);
+    }
+
+    return m_valid = true;
+}
+
+
+
+bool SparsePattern::Score (const wchar_t *string, int& score) const
+{
+    //==============================================================================================
+    // Score
+    //     Tests the pattern against a string and scores the match. Each pattern character is placed
+    //     at the first position after the previous character that is, in order of preference,
+    //     immediately after it, the start of a path component, the start of a word, or anything.
+    //     Candidate positions are limited to those that still leave room for the rest of the
+    //     pattern, found in a first, backward pass.
+    //
+    // Parameters
+    //     string - The string to test
+    //     score  - Receives the match score if the string matches
+    //
+    // Return
+    //     True if the string holds the pattern characters in order.
+    //==============================================================================================
+
+    auto numChars = m_charSlots.size();
+
+    if (!m_valid)
+        return false;
+
+    // Build the position sets in one pass over the string, noting the positions of slashes and
+    // word breaks as we go.
+    //----------------------------------------------------------------------------------------------
+
+    uint64_t slotSets [c_maxPatternLength][c_sparseWords];
+    uint64_t slashes    [c_sparseWords] {};
+    uint64_t wordBreaks [c_sparseWords] {};
+
+    for (size_t slot = 0;  slot < m_slotChars.size();  ++slot)
+        std::fill_n (slotSets[slot], c_sparseWords, 0);
+
+    size_t length = 0;
+
+    for (wchar_t c;  (c = string[length]) != 0;  ++length)
+    {
+        if (length == c_maxStringLength)
+            return false;
+
+        auto word = length / 64;
+        auto bit  = uint64_t(1) << (length % 64);
+        auto slot = (c < 128) ? m_asciiSlots[c] : Slot(c);
+
+        if (slot != c_noSlot)
+            slotSets[slot][word] |= bit;
+
+        if (isSlash(c))
+            slashes[word] |= bit;
+        else if (isWordBreak(c))
+            wordBreaks[word] |= bit;
+    }
+
+    if (length < numChars)
+        return false;
+
+    // A component starts at each non-slash position after a slash, and a word at each other
+    // non-slash position after a word break. Position zero counts as a component start, since
+    // the string begins its first component.
+    //----------------------------------------------------------------------------------------------
+
+    uint64_t componentStarts [c_sparseWords];
+    uint64_t wordStarts      [c_sparseWords];
+
+    for (size_t word = 0;  word < c_sparseWords;  ++word)
+    {
+        auto afterSlash = (slashes[word] << 1)    | (word ? (slashes[word-1] >> 63) : 1);
+        auto afterBreak = (wordBreaks[word] << 1) | (word ? (wordBreaks[word-1] >> 63) : 0);
+
+        componentStarts[word] = afterSlash & ~slashes[word];
+        wordStarts[word]      = afterBreak & ~slashes[word] & ~componentStarts[word];
+    }
+
+    auto tailStart = highestBelow (slashes, static_cast<int>(length)) + 1;   // Final component
+
+    // Backward pass: find the last position at which each pattern character can go while leaving
+    // room for the characters that follow it. If the first character has no such position, the
+    // string does not match.
+    //----------------------------------------------------------------------------------------------
+
+    int latest [c_maxPatternLength];
+    int limit = static_cast<int>(length);
+
+    for (auto i = numChars;  i-- > 0;  )
+    {
+        limit = highestBelow (slotSets[m_charSlots[i]], limit);
+        if (limit < 0) return false;
+        latest[i] = limit;
+    }
+
+    // Forward pass: place each character at its preferred position within [prior+1, latest], and
+    // score it. The latest position is itself a candidate, so a position is always found.
+    //----------------------------------------------------------------------------------------------
+
+    score = 0;
+    int previous = -1;
+
+    for (size_t i = 0;  i < numChars;  ++i)
+    {
+        auto set   = slotSets[m_charSlots[i]];
+        auto first = previous + 1;
+
+        int position;
+
+        if ((previous >= 0) && testBit(set, first))
+            position = first;
+        else if ((position = lowestWithin (set, componentStarts, first, latest[i])) < 0
+              && (position = lowestWithin (set, wordStarts, first, latest[i])) < 0)
+            position = lowestWithin (set, nullptr, first, latest[i]);
+
+        score += c_sparseCharScore;
+
+        if (previous >= 0)
+        {
+            if (position == first)
+                score += c_sparseAdjacentBonus;
+            else
+                score -= std::min (position - first, c_sparseMaxGapPenalty);
+        }
+
+        if (testBit (componentStarts, position))
+            score += c_sparseComponentBonus;
+        else if (testBit (wordStarts, position))
+            score += c_sparseWordBonus;
+
+        if (position >= tailStart)
+            score += c_sparseTailBonus;
+
+        previous = position;
+    }
+
+    return true;
+}
+
+
+
+void SparsePattern::ScoreAll (
+    const wchar_t* const  strings[],
+    size_t                count,
+    vector<ScoredMatch>&  matches) const
+{
+    //==============================================================================================
+    // ScoreAll
+    //     Scores the pattern against each string of a batch, split across threads by batchSliced.
+    //
+    // Parameters
+    //     strings - The strings to score
+    //     count   - The number of strings
+    //     matches - Receives the index and score of each matching string, in ascending index order
+    //==============================================================================================
+
+    batchSliced (count, matches, [&](size_t i, vector<ScoredMatch>& sliceMatches)
+    {
+        int score;
+        if (Score (strings[i], score))
+            sliceMatches.push_back ({ i, score });
+    });
+}
+
+
+
+//==================================================================================================
+// SearchBudget Class Implementation
+//==================================================================================================
+
+void SearchBudget::Start (uint32_t milliseconds, size_t maxDirectories, size_t maxMatches)
+{
+    // Sets the limits, clears the counts, and starts the clock. Not to be called while the budget
+    // is being charged.
+
+    m_hasDeadline    = (milliseconds != 0);
+    m_deadline       = Clock::now() + std::chrono::milliseconds(milliseconds);
+    m_maxDirectories = maxDirectories;
+    m_maxMatches     = maxMatches;
+
+    m_directories = 0;
+    m_matches     = 0;
+    m_cut         = Limit::None;
+}
+
+
+
+void SearchBudget::CutBy (Limit limit)
+{
+    // Records the limit that spent the budget, unless another limit got there first.
+
+    auto none = Limit::None;
+    m_cut.compare_exchange_strong (none, limit);
+}
+
+
+
+bool SearchBudget::Spent ()
+{
+    // Returns true if any limit has been reached. Only the deadline can pass between charges, so
+    // that's the one checked here.
+
+    if (m_cut != Limit::None)
+        return true;
+
+    if (m_hasDeadline && (Clock::now() >= m_deadline))
+    {   CutBy (Limit::Time);
+        return true;
+    }
+
+    return false;
+}
+
+
+
+bool SearchBudget::VisitDirectory ()
+{
+    // Charges one directory visit, unless the budget is spent or the visit would exceed the limit.
+
+    if (Spent())
+        return false;
+
+    auto visits = ++m_directories;
+
+    if (m_maxDirectories && (visits > m_maxDirectories))
+    {   --m_directories;
+        CutBy (Limit::Directories);
+        return false;
+    }
+
+    return true;
+}
+
+
+
+size_t SearchBudget::DirectoriesLeft () const
+{
+    if (!m_maxDirectories)
+        return SIZE_MAX;
+
+    size_t visits = m_directories;
+    return (visits < m_maxDirectories) ? (m_maxDirectories - visits) : 0;
+}
+
+
+
+void SearchBudget::ChargeDirectories (size_t count)
+{
+    m_directories += count;
+}
+
+
+
+bool SearchBudget::AddMatch ()
+{
+    // Charges one match. Returns false once the match limit is reached.
+
+    auto matches = ++m_matches;
+
+    if (m_maxMatches && (matches >= m_maxMatches))
+    {   CutBy (Limit::Matches);
+        return false;
+    }
+
+    return true;
+}
+
+
+
+const char* SearchBudget::LimitName (Limit limit)
+{
+    switch (limit)
+    {
+        case Limit::Time:        return "time";
+        case Limit::Directories: return "directory";
+        case Limit::Matches:     return "match";
+        default:                 return "no";
+    }
+}
+
+
+
+//==================================================================================================
+// PathMatcher Class Implementation
+//==================================================================================================
+
+
+    // ==================
+    // Helper Functions
+    // ==================
+
+static const wchar_t c_slash { L'\\' };
+static const wchar_t c_slashString[] { c_slash, 0 };
+
+static bool isDotsDir (const wchar_t *str)
+{
+    // Return true if the string is either "." or ".."
+    return (str[0] == L'.') && (!str[1] || ((str[1] == L'.') && !str[2]));
+}
+
+static bool isUpDir (const wchar_t *str)
+{
+    // Return true if string begins with parent ("..") subpath.
+    return (str[0]==L'.') && (str[1]==L'.') && (!str[2] || isSlash(str[2]));
+}
+
+
+
+    // ======================
+    // Parallel Tree Fetch
+    // ======================
+
+// FetchAll lists the tree below an ellipsis in parallel. Each directory is a task. Each worker
+// thread keeps its own deque of tasks: it pushes the subdirectories it finds onto the back, last
+// one first, and takes its next task from the back too, so it works depth first in the order the
+// results are reported. A worker out of tasks steals from the front of another worker's deque,
+// where the oldest (and typically largest) subtrees wait, and a worker with nothing to steal
+// sleeps until more tasks are queued.
+//
+// Workers only list and filter. Callbacks are all made on the calling thread, in the same order
+// as a serial depth-first walk: each directory's entries in the order the file system lists them,
+// with each subdirectory's tree right after the subdirectory itself. The calling thread walks the
+// tree of results in that order, waiting for each directory to be listed as it reaches it. If no
+// worker has taken that directory yet, the calling thread lists it itself (and queues its
+// subdirectories first one first, so that thieves take them in report order).
+//
+// A search budget's directory limit is charged by the calling thread, in report order, so a
+// limited fetch reports exactly what a limited serial walk would. To keep the workers from
+// listing much more than the limit allows, they stay at most as many directories ahead of the
+// calling thread as the budget has left.
+//
+// The worker threads belong to the PathMatcher's TreeFetch, which is started on the first fetch
+// and serves every fetch after that. Once a directory's tree has been reported, and its task has
+// been retired, its FetchDir goes back to the TreeFetch's spares, with its buffers intact. Workers
+// take new FetchDirs from the spares, and each worker reopens one directory iterator, so a warm
+// fetch lists directories without allocating.
+
+// New FetchDirs start with room for a directory and path of typical size. Spares go to whichever
+// directory comes next, so without this, a spare that last held a small directory would regrow its
+// buffers as soon as it took a larger one.
+
+static const size_t c_fetchDirEntries { 32 };    // Entries a new FetchDir has room for
+static const size_t c_fetchDirNames   { 512 };   // Name characters a new FetchDir has room for
+static const size_t c_fetchDirPath    { 260 };   // Path characters a new FetchDir has room for
+
+struct FetchDir;
+
+struct FetchEntry
+{
+    size_t                    nameOffset;    // Offset of the entry name in FetchDir::names
+    bool                      isDirectory;   // True => entry is a directory
+    bool                      matches;       // True => entry matches the ellipsis pattern
+    std::unique_ptr<FetchDir> subdir;        // Subdirectory to descend into, if any
+};
+
+struct FetchDir
+{
+    wstring            path;                 // Directory path, ending in a slash unless empty
+    bool               usePrefix { false };  // True => filter entries with the ellipsis prefix
+    wstring            names;                // Entry names, each null-terminated
+    vector<FetchEntry> entries;              // Entries to report or descend into, in order
+    std::atomic<bool>  listed { false };     // True => entries are complete
+    std::atomic<bool>  claimed { false };    // True => a worker or the reporter has taken it
+    std::atomic<int>   holds { 0 };          // Task and reporter holds (see TreeFetch::Release)
+};
+
+
+class FetchedEntry : public DirectoryIterator
+{
+    // A directory entry recorded by a fetch worker, as reported to a MatchTreeCallback.
+
+  public:
+    FetchedEntry (const FetchDir& dir, const FetchEntry& entry) : m_dir(dir), m_entry(entry) {}
+
+    bool next () override { return false; }
+    bool isDirectory () const override { return m_entry.isDirectory; }
+    const wchar_t* name () const override { return m_dir.names.c_str() + m_entry.nameOffset; }
+
+  private:
+    const FetchDir&   m_dir;
+    const FetchEntry& m_entry;
+};
+
+
+class TreeFetch
+{
+    //--------------------------------------------------------------------------
+    // A TreeFetch lists directory trees on a pool of work-stealing threads
+    // (see Parallel Tree Fetch). The threads run for the life of the
+    // TreeFetch, sleeping between fetches, and take one fetch at a time:
+    // Start begins listing a tree, and Finish ends the fetch, waiting until
+    // the threads are done with it.
+    //--------------------------------------------------------------------------
+
+  public:
+
+    explicit TreeFetch (const FileSysProxy& fsProxy);
+    ~TreeFetch ();
+
+    void Start (
+        bool                   dirsOnly,
+        const CompiledPattern& ellipsisPattern,
+        size_t                 ellipsisOffset,
+        const CompiledPattern* ellipsisPrefix,
+        SearchBudget*          budget,
+        FetchDir&              root);
+
+    void Finish ();
+
+    // Called as the reporter reaches each directory, in report order. Charges the directory to the
+    // search budget, and returns false (cancelling the fetch) if the budget is spent. Otherwise
+    // returns once the directory is listed.
+
+    bool Reach (FetchDir& dir);
+
+    void Cancel ();
+
+    // Returns an empty directory, reusing a spare if there is one.
+    std::unique_ptr<FetchDir> SpareDir ();
+
+    // Drops a hold on a directory: its task's, once retired, or the reporter's, once reported. The
+    // last hold dropped returns the directory to the spares.
+    void Release (FetchDir* dir);
+
+  private:
+
+    struct Worker
+    {
+        std::mutex        lock;         // Guards tasks and head
+        vector<FetchDir*> tasks;        // Task deque, from tasks[head] to the back
+        size_t            head { 0 };   // Front of the task deque
+
+        std::unique_ptr<DirectoryIterator> dirEntry;   // Iterator slot, used by this worker only
+        wstring                            scratch;    // Path buffer, used by this worker only
+    };
+
+    void Work (size_t worker);
+    void List (FetchDir& dir, Worker& worker, bool lastFirst);
+    void Retire (FetchDir* dir, bool listed);
+    void Wake ();
+    bool MayList () const;
+
+    const FileSysProxy&    m_fsProxy;                    // File System Proxy
+
+    // The current fetch, set by Start
+
+    bool                   m_dirsOnly { false };         // If true, report directories only
+    const CompiledPattern* m_ellipsisPattern { nullptr };// Ellipsis Pattern (invalid if none)
+    size_t                 m_ellipsisOffset { 0 };       // Start of the ellipsis-matched path
+    const CompiledPattern* m_ellipsisPrefix { nullptr }; // Ellipsis Prefix Pattern (null if none)
+    SearchBudget*          m_budget { nullptr };         // Search Budget (null if unlimited)
+
+    vector<std::unique_ptr<FetchDir>> m_spareDirs;   // Directories for reuse
+    std::mutex                        m_spareLock;   // Guards m_spareDirs
+
+    vector<Worker>          m_pool;               // Per-worker state, then the reporter's
+    vector<std::thread>     m_workers;            // Worker threads
+    std::atomic<size_t>     m_pending { 0 };      // Tasks queued or in progress
+    std::atomic<size_t>     m_queued { 0 };       // Tasks queued
+    std::atomic<bool>       m_cancelled { false };
+
+    std::atomic<size_t>     m_lookAhead { SIZE_MAX }; // Most directories listed ahead of reporter
+    std::atomic<size_t>     m_listed { 0 };       // Directories listed in this fetch
+    std::atomic<size_t>     m_reached { 0 };      // Directories reached by the reporter
+    std::mutex              m_listedLock;         // Guards waits on FetchDir::listed and m_pending
+    std::condition_variable m_listedSignal;       // Signalled as each directory is listed
+
+    std::atomic<size_t>     m_idle { 0 };         // Workers asleep, or about to sleep
+    bool                    m_shutdown { false }; // True => workers exit (guarded by m_idleLock)
+    std::mutex              m_idleLock;           // Guards sleeps on m_workSignal
+    std::condition_variable m_workSignal;         // Signalled as tasks are queued
+};
+
+
+TreeFetch::TreeFetch (const FileSysProxy& fsProxy)
+  : m_fsProxy(fsProxy),
+    m_pool(std::max (1u, std::thread::hardware_concurrency()) + 1)
+{
+    // The last slot of the pool belongs to the reporting thread.
+
+    for (size_t worker = 0;  worker + 1 < m_pool.size();  ++worker)
+        m_workers.emplace_back (&TreeFetch::Work, this, worker);
+}
+
+
+
+TreeFetch::~TreeFetch ()
+{
+    {
+        std::lock_guard<std::mutex> lock { m_idleLock };
+        m_shutdown = true;
+    }
+
+    m_workSignal.notify_all();
+
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+
+
+void TreeFetch::Start (
+    bool                   dirsOnly,
+    const CompiledPattern& ellipsisPattern,
+    size_t                 ellipsisOffset,
+    const CompiledPattern* ellipsisPrefix,
+    SearchBudget*          budget,
+    FetchDir&              root)
+{
+    // Begins listing the tree at the given root. The fetch settings are only read by workers that
+    // have taken one of the fetch's tasks, so they're safe to set while the workers are idle.
+
+    m_dirsOnly        = dirsOnly;
+    m_ellipsisPattern = &ellipsisPattern;
+    m_ellipsisOffset  = ellipsisOffset;
+    m_ellipsisPrefix  = ellipsisPrefix;
+    m_budget          = budget;
+    m_cancelled       = false;
+
+    m_lookAhead = budget ? budget->DirectoriesLeft() : SIZE_MAX;
+    m_listed    = 0;
+    m_reached   = 0;
+    m_pending   = 1;
+
+    root.holds = 2;
+
+    {
+        std::lock_guard<std::mutex> lock { m_pool[0].lock };
+        m_pool[0].tasks.push_back (&root);
+        ++m_queued;
+    }
+
+    Wake();
+}
+
+
+
+void TreeFetch::Finish ()
+{
+    // Cancels whatever remains of the fetch, and waits until the workers have retired all of its
+    // tasks.
+
+    Cancel();
+
+    std::unique_lock<std::mutex> lock { m_listedLock };
+    m_listedSignal.wait (lock, [this] { return m_pending == 0; });
+}
+
+
+
+void TreeFetch::Cancel ()
+{
+    // Stops listing. Sleeping workers are woken to retire the remaining tasks.
+
+    m_cancelled = true;
+    Wake();
+}
+
+
+
+bool TreeFetch::MayList () const
+{
+    // Returns true if a worker may take another task: the fetch is cancelled (so the task will
+    // just be retired), or the workers aren't too far ahead of the reporter.
+
+    if (m_cancelled || (m_lookAhead == SIZE_MAX))
+        return true;
+
+    return m_listed < m_reached + m_lookAhead;
+}
+
+
+
+void TreeFetch::Retire (FetchDir* dir, bool listed)
+{
+    // Retires a directory's task, marking the directory listed if this worker listed it. The task's
+    // hold is dropped before the task leaves the pending count, so once Finish returns, only the
+    // reporter holds any directory of the fetch.
+
+    if (listed)
+    {
+        {
+            std::lock_guard<std::mutex> lock { m_listedLock };
+            dir->listed = true;
+        }
+
+        m_listedSignal.notify_all();
+    }
+
+    Release (dir);
+
+    {
+        std::lock_guard<std::mutex> lock { m_listedLock };
+        --m_pending;
+    }
+
+    m_listedSignal.notify_all();
+}
+
+
+
+void TreeFetch::Wake ()
+{
+    // Wakes any sleeping workers to take newly queued tasks. A worker counts itself idle before it
+    // checks for tasks, so either it sees the new tasks, or this sees it and signals it.
+
+    if (m_idle == 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock { m_idleLock };
+    }
+
+    m_workSignal.notify_all();
+}
+
+
+
+bool TreeFetch::Reach (FetchDir& dir)
+{
+    if (m_budget && !m_budget->VisitDirectory())
+    {   Cancel();
+        return false;
+    }
+
+    ++m_reached;
+    Wake();
+
+    if (dir.listed)
+        return true;
+
+    // List the directory here if no worker has taken it, rather than wait for one to.
+
+    if (!dir.claimed.exchange (true))
+    {
+        List (dir, m_pool.back(), false);
+        dir.listed = true;
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock { m_listedLock };
+    m_listedSignal.wait (lock, [&dir] { return dir.listed.load(); });
+    return true;
+}
+
+
+
+std::unique_ptr<FetchDir> TreeFetch::SpareDir ()
+{
+    // Returns an empty directory, reusing a spare if there is one.
+
+    std::lock_guard<std::mutex> lock { m_spareLock };
+
+    if (m_spareDirs.empty())
+    {
+        std::unique_ptr<FetchDir> dir { new FetchDir };
+        dir->path.reserve (c_fetchDirPath);
+        dir->names.reserve (c_fetchDirNames);
+        dir->entries.reserve (c_fetchDirEntries);
+        return dir;
+    }
+
+    auto dir = std::move (m_spareDirs.back());
+    m_spareDirs.pop_back();
+    return dir;
+}
+
+
+
+void TreeFetch::Release (FetchDir* dir)
+{
+    // A directory's task may outlive its report: if the reporter lists a directory itself, the
+    // task stays queued until a worker takes and drops it. So each directory starts with two holds,
+    // and whichever is dropped last clears the directory, keeping its buffers, and adds it to the
+    // spares. Subdirectories it still owns (left unreported by a cancelled fetch) have their
+    // reporter holds dropped in turn, since their tasks may not have been retired yet.
+
+    if (--dir->holds > 0) return;
+
+    for (auto& entry : dir->entries)
+        if (entry.subdir) Release (entry.subdir.release());
 
-    // Scan through the pattern and path until we hit an asterisk or an ellipsis. Handle the special
-    // cases of "/.../" and "/*/", tested against null subdirectories (where both are also
-    // equivalent to "/").
+    dir->usePrefix = false;
+    dir->names.clear();
+    dir->entries.clear();
+    dir->listed = false;
+    dir->claimed = false;
 
-    while (*pattern && *path)
+    std::lock_guard<std::mutex> lock { m_spareLock };
+    m_spareDirs.emplace_back (dir);
+}
+
+
+
+void TreeFetch::Work (size_t worker)
+{
+    //----------------------------------------------------------------------------------------------
+    // The body of each worker thread. Takes tasks from the back of its own deque, or failing that,
+    // steals from the front of the others' (and the reporter's). With no task anywhere, or no room
+    // to list further ahead of the reporter, the worker sleeps until that changes. Subdirectories
+    // are queued before their parent's task is retired, so the pending count only reaches zero
+    // once the whole tree is listed.
+    //----------------------------------------------------------------------------------------------
+
+    auto numSlots = m_pool.size();
+
+    while (true)
     {
-        if (isSlash(path[0]))             // Consume repeated slashes on path.
-        {   while (isSlash(path[1]))
-                ++ path;
-        }
+        FetchDir* dir { nullptr };
 
-        if (isSlash(pattern[0]))
+        for (size_t i = 0;  !dir && MayList() && (i < numSlots);  ++i)
         {
-            if (!isSlash(path[0]))
-                return false;
+            auto& queue = m_pool[(worker + i) % numSlots];
+            std::lock_guard<std::mutex> lock { queue.lock };
 
-            while (isSlash(pattern[1]))  // Consume repeated slashes on pattern.
-                ++ pattern;
-        }
-        else if (isMultiWildStr (pattern))
-        {   // If we've hit a multi-character wildcard character, then drop to section below.
-            break;
+            if (queue.head == queue.tasks.size())
+                continue;
+
+            if (i == 0)
+            {   dir = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            else
+            {   dir = queue.tasks[queue.head++];
+            }
+
+            --m_queued;
+
+            // Rewind an emptied deque, keeping its capacity.
+
+            if (queue.head == queue.tasks.size())
+            {   queue.tasks.clear();
+                queue.head = 0;
+            }
         }
 
-        // Test for a single character match. In order to support case-sensitive path matching,
-        // you'd only need to change the tolower comparison below.
+        if (!dir)
+        {
+            std::unique_lock<std::mutex> lock { m_idleLock };
 
-        if (*pattern != L'?')
-        {   if (tolower(*pattern) != tolower(*path))
-                return false;
+            ++m_idle;
+            m_workSignal.wait (lock, [this] {
+                return m_shutdown || ((m_queued > 0) && MayList());
+            });
+            --m_idle;
+
+            if (m_shutdown) return;
+            continue;
         }
-        else if (isSlash(*path))         // '?' matches all but slash.
-        {   return false;
+
+        // Leave a directory the reporter has already taken.
+
+        if (dir->claimed.exchange (true))
+        {   Retire (dir, false);
+            continue;
         }
 
-        ++ pattern;    // On a successful match, increment the pattern and the path and continue.
-        ++ path;
+        if (m_budget && m_budget->Spent())
+            Cancel();
+
+        if (!m_cancelled)
+            List (*dir, m_pool[worker], true);
+
+        Retire (dir, true);
     }
+}
 
-    // Unless we stopped on a multi-character wildcard, we're done matching. The only valid way to
-    // match at this point is if both the pattern and the path are exhausted.
 
-    if (!isMultiWildStr(pattern))
-        return (*pattern == 0) && (*path == 0);
 
-    // Advance past the multi-character wildcard(s). A sequence of asterisks is equivalent to a
-    // single asterisk, and a sequence of ellipses and asterisks is equivalent to a single
-    // ellipsis. We handle this here because many asterisks and ellipses in a row would yield
-    // exponential (and pathological) runtimes.
+void TreeFetch::List (FetchDir& dir, Worker& worker, bool lastFirst)
+{
+    //----------------------------------------------------------------------------------------------
+    // Lists one directory: records each entry to report or descend into, and queues each
+    // subdirectory on the given worker's deque. A worker queues them last one first, so that it
+    // takes them from the back in the order they're reported; the reporter queues them first one
+    // first, so that thieves take them from the front in that order. Path length limits are
+    // applied as the serial walk applied them, so the same entries are reported.
+    //----------------------------------------------------------------------------------------------
 
-    bool fEllipsis { false };
+    ++m_listed;
 
-    while (isMultiWildStr (pattern))
-    {
-        if (pattern[0] == L'*')
-            pattern += 1;
-        else
-        {   pattern += 3;
-            fEllipsis = true;
-        }
-    }
+    auto maxPathLength = m_fsProxy.maxPathLength();
+    auto pathLength    = dir.path.size();
+    auto& scratch      = worker.scratch;
+
+    // Bail out if we've run out of path length.
 
-    // If the pattern ends in an ellipsis, then we trivially match any remainder of the path, so
-    // return true, otherwise perform match testing.
+    if (maxPathLength < pathLength + 1) return;
 
-    if (fEllipsis && (*pattern == 0))
-        return true;
+    scratch.assign (dir.path);
+    scratch += L'*';
 
-    // A multi-wild pattern (* or ...) followed by any number of slashes can match the empty string,
-    // so we test for that here. Thus, ".../foo" will match against "foo".
+    auto& dirEntry = worker.dirEntry;
+    dirEntry.reset (m_fsProxy.reuseDirectoryIterator (dirEntry.release(), scratch.c_str()));
 
-    if (isSlash(*pattern))
+    while (dirEntry->next())
     {
-        // Search forward past any number of trailing slashes.
+        auto fileName = dirEntry->name();
+
+        if (isDotsDir(fileName)) continue;
 
-        auto ptr = pattern + 1;
+        if (m_dirsOnly && !dirEntry->isDirectory())
+            continue;
 
-        while (isSlash(*ptr)) ++ptr;
+        if (dir.usePrefix && !m_ellipsisPrefix->Match (fileName))
+            continue;
 
-        // Match the remainder of the pattern against the remainder of the path.
+        auto nameLength = wcslen (fileName);
 
-        if (pathMatch(ptr,path))
-            return true;
-    }
+        if (maxPathLength - pathLength < nameLength + 1) break;
 
-    if (fEllipsis)
-    {
-        // If we have an ellipsis, then recursively nibble away at the path to see if we can yield
-        // a match, until we either match or exhaust the path.
+        dir.entries.push_back ({ dir.names.size(), dirEntry->isDirectory(), true, nullptr });
+        dir.names.append (fileName, nameLength + 1);
 
-        for (;; ++path)
-        {
-            if (pathMatch(pattern, path)) return true;
-            if (*path == 0) return false;
-        }
-    }
-    else
-    {
-        // If we have an asterisk, then recursively nibble away at the path until we encounter a
-        // slash or exhaust the path.
+        auto& entry = dir.entries.back();
 
-        for (; *path && !isSlash(*path);  ++path)
-        {
-            if (pathMatch(pattern, path)) return true;
-        }
+        scratch.resize (pathLength);
+        scratch.append (fileName, nameLength);
 
-        // Test the remainder of the pattern and path.
+        if (m_ellipsisPattern->IsValid())
+            entry.matches = m_ellipsisPattern->Match (scratch.c_str() + m_ellipsisOffset);
 
-        return pathMatch(pattern, path);
-    }
-}
+        // Descend into the subdirectory, unless there's no room left to append a slash and
+        // wildcard.
 
+        if (entry.isDirectory && (maxPathLength >= scratch.size() + 2))
+        {
+            entry.subdir = SpareDir();
+            entry.subdir->path.assign (scratch);
+            entry.subdir->path += c_slash;
+            entry.subdir->holds = 2;
+        }
+    }
 
+    // Queue the subdirectories. They're counted as pending before any can be stolen, so the count
+    // can't reach zero while this directory is still being listed.
 
-//==================================================================================================
-// PathMatcher Class Implementation
-//==================================================================================================
+    auto numSubdirs = std::count_if (dir.entries.begin(), dir.entries.end(),
+        [](const FetchEntry& entry) { return entry.subdir != nullptr; });
 
+    if (numSubdirs == 0) return;
 
-    // ==================
-    // Helper Functions
-    // ==================
+    m_pending += numSubdirs;
 
-static const wchar_t c_slash { L'\\' };
+    {
+        std::lock_guard<std::mutex> lock { worker.lock };
 
-static bool entryIsADir (const WIN32_FIND_DATA &finddata)
-{
-    // Returns true if the current directory entry is a directory.
-    return 0 != (finddata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
-}
+        if (lastFirst)
+        {
+            for (auto entry = dir.entries.rbegin();  entry != dir.entries.rend();  ++entry)
+            {
+                if (entry->subdir)
+                    worker.tasks.push_back (entry->subdir.get());
+            }
+        }
+        else
+        {
+            for (auto& entry : dir.entries)
+            {
+                if (entry.subdir)
+                    worker.tasks.push_back (entry.subdir.get());
+            }
+        }
 
-static bool isDotsDir (const wchar_t *str)
-{
-    // Return true if the string is either "." or ".."
-    return (str[0] == L'.') && (!str[1] || ((str[1] == L'.') && !str[2]));
-}
+        m_queued += numSubdirs;
+    }
 
-static bool isUpDir (const wchar_t *str)
-{
-    // Return true if string begins with parent ("..") subpath.
-    return (str[0]==L'.') && (str[1]==L'.') && (!str[2] || isSlash(str[2]));
+    Wake();
 }
 
 
@@ -624,7 +2476,8 @@ bool PathMatcher::CopyGroomedPattern (const wchar_t *pattern)
 bool PathMatcher::Match (
     const wchar_t*     path_pattern,
     MatchTreeCallback* callback_func,
-    void*              userdata)
+    void*              userdata,
+    SearchBudget*      budget)
 {
     //----------------------------------------------------------------------------------------------
     // This function walks a directory tree according to the given wildcard pattern, and calls the
@@ -633,9 +2486,12 @@ bool PathMatcher::Match (
     // 'path_pattern' is the pattern to match against tree entries.
     // 'callback_func' is the callback function for each matching entry.
     // 'userdata' is the user data to be passed along to callback function.
+    // 'budget' is the search budget, charged with each directory listed and each match reported,
+    // or null for an unlimited search.
     //
     // This function returns true if the function successfully completes the search, otherwise
-    // false.
+    // false. A search cut short by its budget returns false, though the matches reported until
+    // then stand.
     //----------------------------------------------------------------------------------------------
 
     if (!callback_func)      // Bail out if the user didn't provide a
@@ -643,6 +2499,7 @@ bool PathMatcher::Match (
 
     m_callback = callback_func;
     m_callbackData = userdata;
+    m_budget = budget;
 
     // Copy the groomed pattern (see comments for CopyGroomedPattern) into the appropriate member
     // fields.
@@ -690,257 +2547,369 @@ bool PathMatcher::Match (
 
         rootlen = rootend - m_pattern;
 
-        if (FAILED(wcsncpy_s (m_path, (m_fsProxy.maxPathLength() + 1), m_pattern, rootlen)))
+        if (!copyChars (m_path, (m_fsProxy.maxPathLength() + 1), m_pattern, rootlen))
             return false;
     }
 
     MatchDir (m_path + rootlen, wildstart);
 
-    return true;
+    return !m_budget || (m_budget->Cut() == SearchBudget::Limit::None);
 }
 
 
 
-void PathMatcher::MatchDir (
-    wchar_t*       pathend,
-    const wchar_t* pattern)
+size_t PathMatcher::PlanSteps (const wchar_t *pattern)
 {
     //----------------------------------------------------------------------------------------------
-    // This procedure matches a substring pattern against a given root directory. Each matching
-    // entry in the tree will yield a call back to the specified function, along with given user
-    // data. Note that the path string buffer will be used to pass back matching entries to the
-    // callback function.
+    // This function splits the pattern into tree walk steps, one per pattern component, and
+    // compiles each step's matcher. A component runs up to the first of the end of the pattern, a
+    // slash, or an ellipsis. A component that holds an ellipsis is the last step, since it fetches
+    // the remainder of the tree.
     //
-    // 'pathend' is the end of the current path (one past the last character)
-    // 'pattern is the pattern against which to match directory entries.
+    // 'pattern' is the pattern to plan, a suffix of m_pattern.
+    //
+    // This function returns the number of steps.
     //----------------------------------------------------------------------------------------------
 
-    // If the pattern is null, then just return.
+    size_t numSteps { 0 };
 
-    if (!pattern || !*pattern) return;
+    for (auto more = true;  more;  ++numSteps)
+    {
+        if (m_steps.size() <= numSteps)
+            m_steps.emplace_back();
 
-    // Characterize the type of pattern matching we'll be doing in the current directory. Scan
-    // forward to find the first of the end of the pattern, a slash, or an ellipsis.
+        auto& step = m_steps[numSteps];
 
-    int  ipatt { 0 };
-    auto fliteral = true;
+        size_t ipatt { 0 };
+        auto   fliteral = true;
 
-    while (pattern[ipatt] && !isSlash(pattern[ipatt]) && !isEllipsis(pattern + ipatt))
-    {
-        if ((pattern[ipatt] == L'?') || (pattern[ipatt] == L'*'))
-            fliteral = false;
+        while (pattern[ipatt] && !isSlash(pattern[ipatt]) && !isEllipsis(pattern + ipatt))
+        {
+            if ((pattern[ipatt] == L'?') || (pattern[ipatt] == L'*'))
+                fliteral = false;
 
-        ++ ipatt;
-    }
+            ++ ipatt;
+        }
 
-    // If the current pattern subdirectory contains an ellipsis, then handle the remainder of the
-    // pattern and return.
+        step.pattern  = pattern;
+        step.length   = ipatt;
+        step.literal  = fliteral;
+        step.ellipsis = isEllipsis(pattern + ipatt);
+        step.dirMatch = isSlash(pattern[ipatt]);
+        step.descend  = step.dirMatch && (pattern[ipatt+1] != 0);
 
-    if (isEllipsis(pattern + ipatt))
-    {
-        HandleEllipsisSubpath (pathend, pattern, ipatt);
-        return;
-    }
+        step.matcher.Compile (nullptr, CompiledPattern::Syntax::Wild);
+
+        if (step.ellipsis)
+        {
+            if ((ipatt == 0) && !pattern[ipatt+3])
+            {
+                // ...<end> - Just do a simple recursive fetch of the tree.
 
-    assert (!pattern[ipatt] || isSlash(pattern[ipatt]));
+                m_ellipsisPattern.Compile (nullptr, CompiledPattern::Syntax::Path);
+            }
+            else
+            {
+                // Compile the ellipsis pattern once, since it will be tested against every entry
+                // in the tree below each directory that reaches this step.
 
-    auto fdirmatch = isSlash(pattern[ipatt]);
-    auto fdescend  = fdirmatch && (pattern[ipatt+1] != 0);
+                m_ellipsisPattern.Compile (pattern, CompiledPattern::Syntax::Path);
 
-    // (simple) (end)
+                // If the ellipsis is prefixed with a pattern, then we want to save the pattern for
+                // filtering of candidate directory entries by the FetchAll routine.
 
-    auto subPattern = new wchar_t [ipatt+1];
+                if (ipatt > 0)
+                {
+                    wstring prefix { pattern, pattern + ipatt };
+                    prefix += L'*';
 
-    if (!subPattern) return;   // Bail out if out of memory.
+                    step.matcher.Compile (prefix.c_str(), CompiledPattern::Syntax::Wild);
+                }
+            }
+        }
+        else if (!fliteral)
+        {
+            step.matcher.Compile (pattern, ipatt, CompiledPattern::Syntax::Wild);
+        }
 
-    if (FAILED(wcsncpy_s (subPattern, ipatt+1, pattern, ipatt)))
-    {   delete[] subPattern;
-        return;
+        more = step.descend && !step.ellipsis;
+        pattern += ipatt + 1;
     }
 
+    return numSteps;
+}
+
+
+
+void PathMatcher::OpenStep (MatchStep& step)
+{
+    //----------------------------------------------------------------------------------------------
+    // This procedure points the step's iterator at the directory ending at step.pathend, reopening
+    // the iterator left from the last directory listed by this step, if any.
+    //----------------------------------------------------------------------------------------------
+
     // If we have a literal subdirectory name (or filename), then just provide that name to the
     // find-file functions.
 
-    errno_t retval { S_OK };    // General Return Value
-
-    if (fliteral)
-        retval = wcsncpy_s (pathend, PathSpaceLeft(pathend), pattern, ipatt);
+    auto copied = step.literal
+               && copyChars (step.pathend, PathSpaceLeft(step.pathend), step.pattern, step.length);
 
     // If there's a wildcard subdirectory or file name, then enumerate all directory entries and
     // filter the results.
 
-    if (!fliteral || FAILED(retval))
-    {   pathend[0] = L'*';
-        pathend[1] = 0;
+    if (!copied)
+    {   step.pathend[0] = L'*';
+        step.pathend[1] = 0;
     }
 
-    std::unique_ptr<DirectoryIterator> dirEntry { m_fsProxy.newDirectoryIterator(m_path) };
+    step.dirEntry.reset (m_fsProxy.reuseDirectoryIterator (step.dirEntry.release(), m_path));
+}
 
-    while (dirEntry->next())
+
+
+void PathMatcher::MatchDir (
+    wchar_t*       pathend,
+    const wchar_t* pattern)
+{
+    //----------------------------------------------------------------------------------------------
+    // This procedure matches a substring pattern against a given root directory. Each matching
+    // entry in the tree will yield a call back to the specified function, along with given user
+    // data. Note that the path string buffer will be used to pass back matching entries to the
+    // callback function. If the callback returns false, the whole walk stops.
+    //
+    // The tree is walked with an explicit stack of steps (see PlanSteps), where the step at each
+    // depth lists the directories matched by the steps above it. Component patterns are compiled
+    // in place from m_pattern once per match, and each step reuses one directory iterator, so
+    // listing a directory makes no heap allocations once the steps have been used.
+    //
+    // 'pathend' is the end of the current path (one past the last character)
+    // 'pattern is the pattern against which to match directory entries.
+    //----------------------------------------------------------------------------------------------
+
+    // If the pattern is null, then just return.
+
+    if (!pattern || !*pattern) return;
+
+    PlanSteps (pattern);
+
+    auto& root = m_steps[0];
+
+    root.pathend = pathend;
+
+    if (root.ellipsis)
+    {
+        FetchAll (pathend, root.matcher.IsValid() ? &root.matcher : nullptr);
+        return;
+    }
+
+    if (m_budget && !m_budget->VisitDirectory()) return;
+
+    OpenStep (root);
+
+    size_t depth { 0 };   // Index of the step listing the current directory
+
+    while (true)
     {
+        auto& step = m_steps[depth];
+
+        if (!step.dirEntry->next())
+        {
+            if (depth == 0) return;
+
+            --depth;
+            continue;
+        }
+
         // Ignore "." and ".." entries.
 
-        auto entryName = dirEntry->name();
+        auto entryName = step.dirEntry->name();
 
         if (isDotsDir(entryName)) continue;
 
-        if (!fliteral && !wildComp (subPattern, entryName))
+        if (!step.literal && !step.matcher.Match (entryName))
             continue;
 
         // Skip files if the pattern ended in a slash or if the original pattern specified
         // directories only.
 
-        if ((m_dirsOnly || fdirmatch) && !dirEntry->isDirectory())
-        {
-            // Do nothing.
-        }
-        else if (fdescend)
-        {
-            auto pathend_new = AppendPath (pathend, entryName);
-
-            if (!pathend_new) continue;
-
-            *pathend_new++ = c_slash;
-            *pathend_new   = 0;
+        if ((m_dirsOnly || step.dirMatch) && !step.dirEntry->isDirectory())
+            continue;
 
-            MatchDir (pathend_new, pattern + ipatt + 1);
-        }
-        else
+        if (!step.descend)
         {
             // Construct full relative entry path.
 
-            if (AppendPath(pathend, entryName))
+            if (AppendPath(step.pathend, entryName))
             {
-                if (!m_callback (m_path, *dirEntry, m_callbackData))
-                    break;
-            }
-        }
-    }
-
-    delete[] subPattern;
-    return;
-}
+                if (!m_callback (m_path, *step.dirEntry, m_callbackData))
+                    return;
 
+                if (m_budget && !m_budget->AddMatch())
+                    return;
+            }
 
+            continue;
+        }
 
-void PathMatcher::HandleEllipsisSubpath (
-    wchar_t       *pathend,
-    const wchar_t *pattern,
-    int            ipatt)
-{
-    //----------------------------------------------------------------------------------------------
-    // This function handles subdirectories that contain ellipses.
-    //
-    // The parameter 'pathend' points to one past the last character. The 'pattern' parameter is a
-    // pointer to the beginning of the current subdirectory of the full pattern. Finally, 'ipatt' is
-    // an integer offset from pattern to beginning of the ellipsis.
-    //----------------------------------------------------------------------------------------------
+        auto pathend_new = AppendPath (step.pathend, entryName);
 
-    wchar_t* ellipsis_prefix { nullptr };    // Pattern Filter for Prefixed Ellipses
+        if (!pathend_new) continue;
 
-    if ((ipatt == 0) && !pattern[ipatt+3])
-    {
-        // ...<end> - Just do a simple recursive fetch of the tree.
+        *pathend_new++ = c_slash;
+        *pathend_new   = 0;
 
-        m_ellipsisPattern = nullptr;
-    }
-    else
-    {
-        m_ellipsisPattern = pattern;
-        m_ellipsisPath    = pathend;
+        auto& next = m_steps[depth + 1];
 
-        // If the ellipsis is prefixed with a pattern, then we want to save the pattern for
-        // filtering of candidate directory entries by the FetchAll routine.
+        next.pathend = pathend_new;
 
-        if (ipatt > 0)
+        if (next.ellipsis)
         {
-            ellipsis_prefix = new wchar_t [ipatt+2];
-
-            if (!ellipsis_prefix ||
-                FAILED(wcsncpy_s (ellipsis_prefix, ipatt+2, pattern, ipatt)))
-            {
+            if (!FetchAll (pathend_new, next.matcher.IsValid() ? &next.matcher : nullptr))
                 return;
-            }
 
-            ellipsis_prefix[ipatt]   = L'*';
-            ellipsis_prefix[ipatt+1] = 0;
-        }
-        else
-        {
-            ellipsis_prefix = nullptr;
+            continue;
         }
-    }
 
-    FetchAll (pathend, ellipsis_prefix);
-    return;
+        if (m_budget && !m_budget->VisitDirectory()) return;
+
+        OpenStep (next);
+        ++depth;
+    }
 }
 
 
 
-void PathMatcher::FetchAll (wchar_t* pathend, const wchar_t* ellipsis_prefix)
+bool PathMatcher::FetchAll (wchar_t* pathend, const CompiledPattern* ellipsis_prefix)
 {
     //----------------------------------------------------------------------------------------------
-    // This procedure is called when an ellipsis is encountered, and recursively fetches all tree
-    // entries and optionally matches against a pattern.
+    // This procedure is called when an ellipsis is encountered, and fetches all tree entries below
+    // the current path, optionally matching them against the ellipsis pattern. The tree is listed
+    // in parallel (see Parallel Tree Fetch), and matching entries are reported in the order of a
+    // serial depth-first walk. If the callback returns false, the whole fetch stops.
     //
     // 'pathend' is the end of the current path (one past last character)
     //
-    // 'ellipsis_prefix' is the pattern that prefixes the ellipsis, followed by an asterisk. It will
-    // be used to filter directory entries for subsequent ellipsis pattern matching.
+    // 'ellipsis_prefix' is the compiled pattern that prefixes the ellipsis, followed by an
+    // asterisk, or null if none. It will be used to filter directory entries for subsequent
+    // ellipsis pattern matching.
     //
-    // This function silently returns on error.
+    // This function returns false if the callback asked to stop or the search budget is spent, and
+    // silently returns true on error.
     //----------------------------------------------------------------------------------------------
 
-    static const wchar_t c_slashstr[] { c_slash, 0 };
+    // The ellipsis pattern is matched against the path from the ellipsis component on.
+
+    auto ellipsisOffset = m_ellipsisPattern.IsValid() ? static_cast<size_t>(pathend - m_path) : 0;
 
     // Append slash if needed.
 
     if ((pathend > m_path) && !isSlash(pathend[-1]))
-    {   pathend = AppendPath (pathend, c_slashstr);
-        if (!pathend) return;          // Bail out if the append failed.
+    {   pathend = AppendPath (pathend, c_slashString);
+        if (!pathend) return true;     // Bail out if the append failed.
     }
 
-    // Bail out if we've run out of path length.
+    // The worker pool is started on the first fetch, and kept for the rest.
 
-    if (PathSpaceLeft(pathend) < 1) return;
+    if (!m_fetch)
+        m_fetch.reset (new TreeFetch { m_fsProxy });
 
-    pathend[0] = L'*';
-    pathend[1] = 0;
+    auto root = m_fetch->SpareDir();
+    root->path.assign (m_path, pathend);
+    root->usePrefix = (ellipsis_prefix != nullptr);
 
-    std::unique_ptr<DirectoryIterator> dirEntry (m_fsProxy.newDirectoryIterator(m_path));
+    m_fetch->Start (
+        m_dirsOnly, m_ellipsisPattern, ellipsisOffset, ellipsis_prefix, m_budget, *root);
 
-    while (dirEntry->next())
-    {
-        // Ignore "." and ".." entries.
+    auto result = ReportFetched (*m_fetch, *root, pathend);
 
-        auto fileName = dirEntry->name();
+    m_fetch->Finish();
+    m_fetch->Release (root.release());
 
-        if (isDotsDir(fileName)) continue;
+    return result;
+}
 
-        // Skip file entries if we're only looking for directories.
 
-        if (m_dirsOnly && !dirEntry->isDirectory())
-            continue;
 
-        // If there's an ellipsis prefix, then ensure first that we match against it before
-        // descending further.
+bool PathMatcher::ReportFetched (TreeFetch& fetch, FetchDir& root, wchar_t* pathend)
+{
+    //----------------------------------------------------------------------------------------------
+    // Reports the matching entries of a fetched directory and its subdirectories, in serial
+    // depth-first order, waiting on the fetch workers as needed. The walk keeps an explicit stack
+    // of directories, and each subdirectory is handed back to the fetch for reuse once reported.
+    //
+    // Each directory is charged to the search budget as it's reached (see TreeFetch::Reach), so a
+    // budget cuts the report short at the same point a serial walk would stop: what's reported is
+    // always a prefix of the full serial order.
+    //
+    // 'pathend' is the end of the root directory's path in m_path (one past the trailing slash)
+    //
+    // This function returns false if the callback asked to stop or the search budget is spent.
+    //----------------------------------------------------------------------------------------------
+
+    if (!fetch.Reach (root))
+        return false;
+
+    m_reportSteps.clear();
+    m_reportSteps.push_back ({ &root, 0, pathend });
+
+    while (!m_reportSteps.empty())
+    {
+        auto& step = m_reportSteps.back();
+        auto& dir  = *step.dir;
+
+        if (step.next == dir.entries.size())
+        {
+            m_reportSteps.pop_back();
+
+            if (!m_reportSteps.empty())
+            {
+                auto& parent = m_reportSteps.back();
+                fetch.Release (parent.dir->entries[parent.next - 1].subdir.release());
+            }
 
-        if (ellipsis_prefix && !wildComp (ellipsis_prefix, fileName))
             continue;
+        }
 
-        auto pathEndNew = AppendPath (pathend, fileName);
+        auto& entry = dir.entries[step.next++];
+
+        // The workers have already applied the path length limits, so these appends succeed.
+
+        auto pathEndNew = AppendPath (step.pathend, dir.names.c_str() + entry.nameOffset);
+
+        if (!pathEndNew)
+        {   step.next = dir.entries.size();
+            continue;
+        }
 
-        if (!pathEndNew) break;
+        if (m_budget && m_budget->Spent())
+        {
+            fetch.Cancel();
+            return false;
+        }
 
-        if (!m_ellipsisPattern || pathMatch(m_ellipsisPattern, m_ellipsisPath))
+        if (entry.matches)
         {
-            if (!m_callback (m_path, *dirEntry, m_callbackData))
-                return;
+            auto keepGoing = m_callback (m_path, FetchedEntry(dir, entry), m_callbackData);
+
+            if (!keepGoing || (m_budget && !m_budget->AddMatch()))
+            {
+                fetch.Cancel();
+                return false;
+            }
         }
 
-        if (dirEntry->isDirectory())
-            FetchAll (pathEndNew, nullptr);
+        if (entry.subdir)
+        {
+            auto subdirEnd = AppendPath (pathEndNew, c_slashString);
+
+            if (!fetch.Reach (*entry.subdir))
+                return false;
+
+            m_reportSteps.push_back ({ entry.subdir.get(), 0, subdirEnd });
+        }
     }
+
+    return true;
 }
 
 
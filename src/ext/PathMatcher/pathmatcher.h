@@ -22,11 +22,15 @@
 
     // Includes
 
-#include <io.h>
+#include <stdint.h>
 #include <stdlib.h>
-#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
-#include <FileSystemProxy.h>
+#include <unordered_map>
+#include <vector>
+#include <fileSystemProxy.h>
 
 using namespace std;
 using FSProxy::DirectoryIterator;
@@ -49,13 +53,261 @@ bool wildCompCaseSensitive (const wchar_t *pattern, const wchar_t *string);
 bool pathMatch (const wchar_t *pattern, const wchar_t *path);
 
 
+// Forms of the literal run kernels that CompiledPattern uses to screen strings before running its
+// NFA. These are exposed so that tests and benchmarks can run and time each form.
+
+enum class KernelForm
+{
+    Best,     // The fastest form this machine supports (the form CompiledPattern uses)
+    Scalar,   // Portable scalar code
+    SSE2,     // SSE2 (x86 and x64 only)
+    AVX2      // AVX2 (x86 and x64 only, where the CPU and OS support it)
+};
+
+// Returns true if the given literal run kernel form can run on this machine.
+bool KernelFormSupported (KernelForm form);
+
+// Returns true if the first 'count' characters of 'str' match the literal 'lit', using the given
+// kernel form. If 'fold' is true, 'A'..'Z' in 'str' compare as 'a'..'z', and 'lit' must be
+// lower case. Returns false if the form is not supported.
+bool EqualLiteral (
+    KernelForm form, const wchar_t *str, const wchar_t *lit, size_t count, bool fold);
+
+// Returns true if 'str' (of 'length' characters) contains the literal 'lit' (of 'count'
+// characters), using the given kernel form and folding as for EqualLiteral. Returns false if the
+// form is not supported.
+bool FindLiteral (
+    KernelForm form, const wchar_t *str, size_t length, const wchar_t *lit, size_t count,
+    bool fold);
+
+
+
+class CompiledPattern
+{
+    //--------------------------------------------------------------------------
+    // A CompiledPattern is a wildComp, wildCompCaseSensitive or pathMatch
+    // pattern that has been parsed once into a bit-parallel NFA, so that it
+    // can be tested against any number of strings without re-interpreting the
+    // pattern. Matching follows the semantics of the corresponding function.
+    //--------------------------------------------------------------------------
+
+  public:
+
+    enum class Syntax
+    {
+        Wild,                // wildComp
+        WildCaseSensitive,   // wildCompCaseSensitive
+        Path                 // pathMatch
+    };
+
+    CompiledPattern () = default;
+    CompiledPattern (const wchar_t *pattern, Syntax syntax);
+
+    // Compiles the given pattern, replacing any prior one. A null pattern
+    // yields an invalid CompiledPattern, which matches nothing.
+
+    bool Compile (const wchar_t *pattern, Syntax syntax);
+
+    // Compiles the first 'length' characters of the pattern, which need not
+    // be null-terminated, so that a slice of a longer pattern can be compiled
+    // in place.
+
+    bool Compile (const wchar_t *pattern, size_t length, Syntax syntax);
+
+    bool IsValid () const { return m_valid; }
+
+    // Returns true if and only if the compiled pattern matches the string.
+
+    bool Match (const wchar_t *string) const;
+
+    // Tests the compiled pattern against each of 'count' strings, and appends the index of each
+    // matching string to 'matches', in ascending order. Large batches are split across threads.
+
+    void MatchAll (const wchar_t* const strings[], size_t count, vector<size_t>& matches) const;
+
+
+  private:   // Private Member Variables
+
+    Syntax m_syntax { Syntax::Wild };   // Pattern Syntax
+    bool   m_valid { false };           // True if a pattern has been compiled
+    bool   m_acceptsRest { false };     // True if the pattern ends in a match-all wildcard
+    bool   m_foldLiterals { false };    // True if literal runs compare without regard to case
+    bool   m_literalsDecide { false };  // True if the literal runs alone decide a match
+
+    size_t m_numStates { 0 };           // NFA States (one per token, plus the final state)
+    size_t m_numWords { 0 };            // 64-bit words per state mask
+
+    struct Epsilon { uint32_t from, to; };             // Transition on the empty string
+
+    vector<uint64_t>                m_masks;            // State masks (see the c_mask* slots)
+    unordered_map<wchar_t, size_t>  m_literalMasks;     // Literal character to m_masks offset
+    size_t                          m_asciiMasks[128];  // Unfolded ASCII to m_masks offset
+    vector<Epsilon>                 m_epsilons;         // Empty transitions, ascending by from
+
+    wstring m_prefix;      // Folded literal run that must begin a matching string
+    wstring m_required;    // Longest other folded literal run a matching string must contain
+    wstring m_suffix;      // Folded literal run that must end a matching string
+
+
+  private:   // Private Methods
+
+    wchar_t Fold (wchar_t c) const;
+    void    Close (uint64_t *states) const;
+};
+
+
+
+class SparsePattern
+{
+    //--------------------------------------------------------------------------
+    // A SparsePattern matches any string that holds the pattern characters in
+    // order, with any number of other characters between them (as though ".*"
+    // separated each pair). Matching ignores case, and treats forward and back
+    // slashes alike. Each match is scored by how well its characters line up:
+    // adjacent characters and the starts of path components and words score
+    // higher, characters in the final path component a little higher, and
+    // gaps lower.
+    //--------------------------------------------------------------------------
+
+  public:
+
+    static const size_t c_maxPatternLength { 64 };    // Longest pattern that compiles
+    static const size_t c_maxStringLength  { 320 };   // Longest string that can match
+
+    struct ScoredMatch
+    {
+        size_t index;   // Index of the matching string
+        int    score;   // Match score; higher is better
+    };
+
+    SparsePattern () = default;
+    explicit SparsePattern (const wchar_t *pattern);
+
+    // Compiles the given pattern, replacing any prior one. A null, empty or over-long pattern
+    // yields an invalid SparsePattern, which matches nothing.
+
+    bool Compile (const wchar_t *pattern);
+
+    bool IsValid () const { return m_valid; }
+
+    // Returns true if the pattern matches the string, and sets 'score' to the match score.
+
+    bool Score (const wchar_t *string, int& score) const;
+
+    // Scores the pattern against each of 'count' strings, and appends each match to 'matches', in
+    // ascending index order. Large batches are split across threads.
+
+    void ScoreAll (const wchar_t* const strings[], size_t count, vector<ScoredMatch>& matches) const;
+
+
+  private:   // Private Member Variables
+
+    bool    m_valid { false };        // True if a pattern has been compiled
+    wstring m_slotChars;              // Distinct folded pattern characters, one per slot
+    vector<uint8_t> m_charSlots;      // Slot of each pattern character, in pattern order
+    uint8_t m_asciiSlots[128];        // Unfolded ASCII to slot (c_noSlot if not in the pattern)
+
+
+  private:   // Private Methods
+
+    static wchar_t Fold (wchar_t c);
+    size_t         Slot (wchar_t c) const;
+};
+
+
+
+class SearchBudget
+{
+    //--------------------------------------------------------------------------
+    // A SearchBudget caps a search three ways: by a wall-clock deadline, by
+    // the number of directories visited, and by the number of matches found.
+    // A zero limit means no limit. Once any limit is reached the budget stays
+    // spent, and Cut() reports which limit was reached first. Visits and
+    // matches may be charged from several threads at once.
+    //--------------------------------------------------------------------------
+
+  public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    enum class Limit
+    {
+        None,          // Budget not spent
+        Time,          // Deadline passed
+        Directories,   // Directory visit limit reached
+        Matches        // Match limit reached
+    };
+
+    SearchBudget () = default;
+
+    // Sets the limits and clears the counts. The clock starts now.
+
+    void Start (uint32_t milliseconds, size_t maxDirectories, size_t maxMatches);
+
+    // Charges one directory visit. Returns false (without charging) if the budget is already spent
+    // or the visit would exceed the directory limit, in which case the directory should be skipped.
+
+    bool VisitDirectory ();
+
+    // Returns the number of directory visits left under the limit, or SIZE_MAX if there's no limit.
+
+    size_t DirectoriesLeft () const;
+
+    // Charges 'count' directory visits made without VisitDirectory, such as by threads that can't
+    // hold on to the budget. The count should not exceed DirectoriesLeft().
+
+    void ChargeDirectories (size_t count);
+
+    // Charges one match. Returns false if this match reaches the match limit, in which case the
+    // match stands but the search should look no further.
+
+    bool AddMatch ();
+
+    // Returns true if the budget is spent, noting the deadline if it has now passed.
+
+    bool Spent ();
+
+    bool              HasDeadline () const { return m_hasDeadline; }
+    Clock::time_point Deadline () const    { return m_deadline; }
+
+    Limit  Cut () const         { return m_cut; }
+    size_t Directories () const { return m_directories; }
+    size_t Matches () const     { return m_matches; }
+
+    // Returns the name of the given limit ("time", "directory" or "match").
+
+    static const char* LimitName (Limit limit);
+
+
+  private:   // Private Member Variables
+
+    bool              m_hasDeadline { false };   // True if there's a time limit
+    Clock::time_point m_deadline;                // Time by which the search must end
+    size_t            m_maxDirectories { 0 };    // Directory visit limit (0 = none)
+    size_t            m_maxMatches { 0 };        // Match limit (0 = none)
+
+    std::atomic<size_t> m_directories { 0 };     // Directories visited
+    std::atomic<size_t> m_matches { 0 };         // Matches found
+    std::atomic<Limit>  m_cut { Limit::None };   // First limit reached
+
+
+  private:   // Private Methods
+
+    void CutBy (Limit limit);
+};
+
+
 
 // The callback function signature that PathMatcher uses to report back all matching entries.
+// Callbacks are always made on the thread that called PathMatcher::Match. Return false to stop.
 typedef bool (MatchTreeCallback) (
     const wchar_t* entry,
     const DirectoryIterator& fileData,
     void* userData);
 
+struct FetchDir;
+class  TreeFetch;
+
 class PathMatcher
 {
     //--------------------------------------------------------------------------
@@ -69,9 +321,12 @@ class PathMatcher
     PathMatcher (FileSysProxy &fsProxy);
     ~PathMatcher();
 
-    // The main match procedure.
+    // The main match procedure. If a budget is given, the search stops once the budget is spent,
+    // and Match returns false; the budget's Cut() tells which limit ended the search.
 
-    bool Match (const wchar_t *pattern, MatchTreeCallback* callback, void* userData);
+    bool Match (
+        const wchar_t *pattern, MatchTreeCallback* callback, void* userData,
+        SearchBudget* budget = nullptr);
 
 
   private:   // Private Member Variables
@@ -79,14 +334,42 @@ class PathMatcher
     FileSysProxy&      m_fsProxy;                  // File System Proxy
     MatchTreeCallback* m_callback { nullptr };     // Match Callback Function
     void*              m_callbackData { nullptr }; // Callback Function Data
+    SearchBudget*      m_budget { nullptr };       // Search Budget (null if unlimited)
 
     wchar_t* m_path;                               // Current path
     wchar_t* m_pattern { nullptr };                // Wildcarded portion of the given pattern
     size_t   m_patternBufferSize { 0 };            // Size of the pattern buffer.
     bool     m_dirsOnly { false };                 // If true, report directories only
 
-    const wchar_t* m_ellipsisPattern { nullptr };  // Ellipsis Pattern
-    wchar_t*       m_ellipsisPath { nullptr };     // Path part to match against ellipsis pattern
+    CompiledPattern m_ellipsisPattern;             // Ellipsis Pattern (invalid if none)
+
+    // The tree walk keeps one step per pattern component. Steps and their iterators are reused
+    // from one directory (and one match) to the next, so the walk doesn't allocate per directory.
+
+    struct MatchStep
+    {
+        const wchar_t*  pattern;       // Component pattern, a slice of m_pattern
+        size_t          length;        // Component length, up to a slash, ellipsis or end
+        bool            literal;       // True => component has no wildcards
+        bool            dirMatch;      // True => component ends in a slash
+        bool            descend;       // True => another component follows
+        bool            ellipsis;      // True => component holds an ellipsis
+        CompiledPattern matcher;       // Wildcard component, or ellipsis prefix (if any)
+        wchar_t*        pathend;       // End of the directory path listed by this step
+
+        std::unique_ptr<DirectoryIterator> dirEntry;   // Iterator slot, reopened per directory
+    };
+
+    struct ReportStep
+    {
+        FetchDir* dir;                 // Fetched directory being reported
+        size_t    next;                // Index of the next entry to report
+        wchar_t*  pathend;             // End of the directory path in m_path
+    };
+
+    vector<MatchStep>                  m_steps;         // Tree walk steps
+    vector<ReportStep>                 m_reportSteps;   // Fetched tree report stack
+    std::unique_ptr<TreeFetch>         m_fetch;         // Tree fetch worker pool, once started
 
 
   private:   // Private Methods
@@ -95,10 +378,12 @@ class PathMatcher
 
     bool CopyGroomedPattern (const wchar_t *pattern);
 
-    void HandleEllipsisSubpath (wchar_t *pathEnd, const wchar_t *pattern, int iPattern);
+    size_t PlanSteps (const wchar_t *pattern);
+    void   OpenStep (MatchStep& step);
 
     void MatchDir (wchar_t* pathend, const wchar_t* pattern);
-    void FetchAll (wchar_t* pathend, const wchar_t* ellipsisPrefix);
+    bool FetchAll (wchar_t* pathend, const CompiledPattern* ellipsisPrefix);
+    bool ReportFetched (TreeFetch& fetch, FetchDir& root, wchar_t* pathend);
 
     wchar_t* AppendPath (wchar_t *pathEnd, const wchar_t *str);
 
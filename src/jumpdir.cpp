@@ -1,754 +1,4986 @@
-//======================================================================================================================
-// jumpdir - A smart directory navigation command
-//
-// Copyright 2017 Steve Hollasch. All rights reserved.
-//======================================================================================================================
-
-#include "json.hpp"
-
-#include <ctype.h>
-#include <stdio.h>
-#include <string.h>
-#include <stdarg.h>
-#include <windows.h>
-#include <direct.h>
-#include <assert.h>
-#include <PathMatcher.h>
-#include <fileSystemProxyWindows.h>
-
-
-using namespace PMatcher;
-using namespace FSProxy;
-using json = nlohmann::json;
-
-
-// Program Parameters and Constants
-
-bool fDebug = false;
-
-
-// Version and Usage Information
-
-static const char* usage[] = {
-    "",
-    "jumpdir v0.0.10 / (c) 2017 Steve Hollasch",
-    "",
-    "jumpdir: Adaptive directory navigation for the command line",
-    "Usage:   jumpdir <directory>",
-    "",
-    "    This command changes the directory as specified.",
-    0
-};
-
-
-
-//======================================================================================================================
-// Utility Functions
-//======================================================================================================================
-
-void PrintUsage () {
-
-    // Prints out usage information for this tool.
-    //----------------------------------------------------------------------------------------------
-
-    int i;
-
-    for (i=0;  usage[i];  ++i) {
-        if (usage[i][0] == 0)
-            puts ("echo.");
-        else
-            printf ("echo %s\n", usage[i]);
-    }
-}
-
-
-//--------------------------------------------------------------------------------------------------
-void DPrint (const char* format, ...) {
-
-    // Prints one line of debug information. The formatted string does not need a carriage return.
-    //
-    // 'format' - a printf-style format string
-    // ...      - the remainder of the printf-style arguments
-    //----------------------------------------------------------------------------------------------
-
-    if (!fDebug) return;
-
-    va_list vl;
-    va_start (vl, format);
-
-    fputs ("# ", stderr);
-    vfprintf_s (stderr, format, vl);
-    fputc ('\n', stderr);
-
-    va_end (vl);
-}
-
-
-//--------------------------------------------------------------------------------------------------
-void ErrorPrint (const char* format, ...) {
-
-    // Prints a printf-style message plus arguments to the error output stream, followed by a
-    // carriage return.
-    //----------------------------------------------------------------------------------------------
-
-    va_list vl;
-    va_start (vl, format);
-
-    fputs ("jumpdir: ", stderr);
-    vfprintf_s (stderr, format, vl);
-    fputc ('\n', stderr);
-
-    va_end (vl);
-}
-
-
-//--------------------------------------------------------------------------------------------------
-inline bool streqic (const char *str1, const char *str2) {
-
-    // Returns true if the two strings are non-null and equal, ignoring case. Either string
-    // argument may be null.
-    //----------------------------------------------------------------------------------------------
-
-    return (str1 != 0) && (str2 != 0) && (0 == _stricmp(str1,str2));
-}
-
-
-//--------------------------------------------------------------------------------------------------
-void SlashForward (char* str) {
-
-    // Given a string pointer, converts all back slashes to forward slashes.
-    //----------------------------------------------------------------------------------------------
-
-    char* ptr;
-
-    for (ptr=str;  *ptr;  ++ptr) {
-       if (*ptr == '\\')
-            *ptr = '/';
-    }
-}
-
-
-//--------------------------------------------------------------------------------------------------
-void SlashBackward (char* str) {
-
-    // Given a string pointer, converts all forward slashes to back slashes.
-    //----------------------------------------------------------------------------------------------
-
-    char* ptr;
-
-    for (ptr=str;  *ptr;  ++ptr) {
-       if (*ptr == '/') *ptr = '\\';
-    }
-}
-
-
-
-//--------------------------------------------------------------------------------------------------
-static bool isWildStr (const char* str) {
-
-    // Returns true if the given string begins with a wildcard character sequence.
-    // This includes '?', '*', '**', or '...'.
-    //----------------------------------------------------------------------------------------------
-
-    return (*str == '?')
-        || (*str == '*')
-        || ((str[0] == '.') && (str[1] == '.') && (str[2] == '.'));
-}
-
-
-
-//======================================================================================================================
-// Struct DirEntry
-//======================================================================================================================
-
-struct DirEntry {
-    unsigned int m_dvol_name;          // Offset of Volume Name
-    unsigned int m_dvol_label;         // Offset of Volume Label
-    unsigned int m_dpath;              // Offset of Path
-    time_t       m_lastverified;       // Date Last Verified
-    DWORD        m_serialnum;          // Volume Serial Number
-    bool         m_valid;              // Entry Valid
-    DirEntry    *m_next;               // Next Directory Entry
-};
-
-
-
-//======================================================================================================================
-// Class JDMemPool
-//======================================================================================================================
-
-class JDMemPool {
-  public:
-    JDMemPool () : m_size{0}, m_heap{0} { }
-
-    void Attach (void* block, unsigned int size);
-
-  private:
-    unsigned int  m_size;
-    void         *m_heap;
-};
-
-
-//--------------------------------------------------------------------------------------------------
-void JDMemPool::Attach (void *block, unsigned int size) {
-
-    // This method sets the block and size for the memory pool, as read from the data file. This
-    // memory pool can be effectively detached by calling it with (0,0) as the arguments.
-    //
-    // Ensure that the block is non-null if the size is non-zero.
-    //----------------------------------------------------------------------------------------------
-
-    assert ((size == 0) == (block == NULL));
-
-    m_heap = block;
-    m_size = size;
-}
-
-
-
-//======================================================================================================================
-// Class JDFileHeader
-//======================================================================================================================
-
-class JDFileHeader {
-  public:
-
-    JDFileHeader ()
-      : maxHistSize    {-1},
-        dirEcho        {false},
-        verbose        {false},
-        netSearch      {true},
-        automap        {true},
-        numHistEntries {0}
-    {
-    }
-
-    // Data Fields
-
-    int          maxHistSize;     // Max Number of History Entries
-    bool         dirEcho;         // Echo new directories?
-    bool         verbose;         // Echo resultant shell commands?
-    bool         netSearch;       // Search network paths?
-    bool         automap;         // Automatically map network drives?
-    unsigned int numHistEntries;  // Current count of path history entries
-};
-
-
-
-//======================================================================================================================
-// Class JumpData
-//======================================================================================================================
-
-class JumpData {
-  public:
-
-    JumpData() : m_rawData{nullptr} {};
-    ~JumpData();
-
-    bool Load  (const string& filename);
-    bool Store (const string& filename) const;
-
-  private:
-    JDFileHeader *m_header;
-    DirEntry     *m_dirEntries; // Directory Entry List
-    char*         m_strpool;
-
-  private:
-    void *m_rawData;         // Raw Data File Contents
-};
-
-
-//--------------------------------------------------------------------------------------------------
-JumpData::~JumpData () {
-    if (m_rawData) {
-        delete [] m_rawData;
-    }
-}
-
-
-//--------------------------------------------------------------------------------------------------
-bool JumpData::Load (const string& filename) {
-    DPrint ("Reading jumpdata from \"%s\".", filename.c_str());
-
-    m_header = new JDFileHeader;
-
-    // If the data file does not exist, then silently assume that we're starting
-    // from scratch.
-
-    // ifstream dbStream {filename.c_str()};
-
-    if (0 != _access(filename.c_str(), 0))
-        return true;
-
-    // Read in the entire contents of the jump data file into the data buffer.
-    // Below open in "rb" mode to get an accurate (untranslated) size of the
-    // entire data file, so we can slurp the entire thing into memory at once.
-    // If the file is opened in text mode, the size won't be accurate since
-    // carriage-return/linefeeds may be logically collapsed into a single
-    // entity.
-
-    FILE* dataFile;
-
-    if (0 != fopen_s (&dataFile, filename.c_str(), "r,ccs=UTF-8")) {
-        ErrorPrint ("Couldn't open data file \"%s\".", filename);
-        return false;
-    }
-
-    // Seek to the end to determine the size of the entire data file.
-
-    if (0 != fseek (dataFile, 0, SEEK_END)) {
-        ErrorPrint ("Couldn't seek in data file \"%s\".", filename);
-        return false;
-    }
-
-    auto dataCount = ftell (dataFile);
-    rewind (dataFile);
-
-    // Allocate the buffer for the data file contents.
-
-    m_rawData = new char [dataCount + 100];                                            // !!! TEMPORARY !!! buffer for experimentation
-
-    if (m_rawData == nullptr) {
-        ErrorPrint ("Couldn't allocate %ld bytes for jumpdir data.\n", dataCount);
-        return false;
-    }
-
-    // Read the data file into the data block and close the file.
-
-    size_t nItemsRead = fread_s (m_rawData, dataCount, 1, dataCount, dataFile);
-
-    if (nItemsRead != dataCount) {
-        ErrorPrint ("Read failed on data file \"%s\".", filename);
-        return false;
-    }
-
-    fclose (dataFile);
-
-    return true;
-}
-
-
-//--------------------------------------------------------------------------------------------------
-bool JumpData::Store (const string& filename) const {
-                                                                                                        // !!! TEMPORARY !!!
-    DPrint ("Skipping DB store for development.");
-    return true;
-
-    #if 0
-        FILE *datafile;
-
-        if (0 != _wfopen_s (&datafile, filename, L"wb")) {
-            ErrorPrint (L"Couldn't create data file \"%s\".", filename);
-            return false;
-        }
-
-
-        if (1 != fwrite (m_header, sizeof(JDFileHeader), 1, datafile)) {
-            ErrorPrint (L"Error while writing data file.");
-            return false;
-        }
-    #endif
-
-    #if 0
-        for (int i=0;  i <= 0xff;  ++i) {
-            unsigned char c = static_cast<unsigned char> (i);
-            if (1 != fwrite (&c, sizeof(unsigned char), 1, datafile)) {
-                ErrorPrint (L"Error while writing data file.");
-                return false;
-            }
-        }
-
-        unsigned int x = 0x11223344;
-        if (1 != fwrite (&x, sizeof(unsigned int), 1, datafile)) {
-            ErrorPrint (L"Error while writing data file.");
-            return false;
-        }
-
-        if (0 > fputws (L"[# Hello world!\n]", datafile)) {
-            ErrorPrint (L"Error while writing data file.");
-            return false;
-        }
-    #endif
-
-    #if 0
-        fclose (datafile);
-    #endif
-
-    return true;
-}
-
-
-
-//======================================================================================================================
-// Class JDContext
-//======================================================================================================================
-
-class JDContext {
-    //--------------------------------------------------------------------------
-    // The main data context structure for the jumpdir program.
-    //--------------------------------------------------------------------------
-
-  public:
-
-    static const int c_numDrives = 26;
-
-    JDContext (FileSysProxy&);
-    ~JDContext() {};
-
-    bool ParseArgs (int argc, const char* const argv[]);
-    bool ScanEnvironment ();
-    bool ScanDrives ();
-
-    bool Load ();
-    bool Store ();
-
-    void EnumerateNetMaps ();
-
-    bool HandleTrivialChange();
-    bool Jump ();
-
-  private:
-
-    FileSysProxy& m_fsProxy;           // File System Proxy
-
-    bool AppendDest (const char*);     // Appends Path to Destination
-
-    string   m_dbFilename;             // Jumpdir Data File Name
-    JumpData m_jumpData;               // Jump Directory Data
-
-    PathMatcher m_pathMatcher;         // Wildcard Path Matcher
-
-    char     m_cwd[MAX_PATH+1];        // Current Working Directory
-    char*    m_driveMaps[c_numDrives]; // Drive Network Mappings
-
-    char     m_dest[MAX_PATH+1];       // Specified Destination
-    int      m_destlen;                // Dest String Length
-    bool     m_destwild;               // Destination Contains Wildcards
-};
-
-
-//--------------------------------------------------------------------------------------------------
-JDContext::JDContext (FileSysProxy& fsProxy)
-  : m_fsProxy{fsProxy}, m_pathMatcher{fsProxy} {
-
-    int drive;
-
-    for (drive=0;  drive < c_numDrives;  ++drive)
-        m_driveMaps[drive] = 0;
-
-    m_dest[0]  = 0;
-    m_destlen  = 0;
-    m_destwild = false;
-}
-
-
-//--------------------------------------------------------------------------------------------------
-bool JDContext::ParseArgs (int argc, const char* const argv[]) {
-
-    // Parses the command-line arguments before executing commands. This
-    // function is also responsible for reading in the data file.
-    //
-    // Parameter 'context' is the jumpdir context object. 'argc' and 'argv' are
-    // the standard command line arguments.
-    //
-    // Returns true if the parse succeeded, otherwise false.
-    //----------------------------------------------------------------------------------------------
-
-    int argi;     // Argument Index
-
-    for (argi=1;  argi < argc;  ++argi) {
-        if (  streqic (argv[argi], "-?")
-           || streqic (argv[argi], "/?")
-           || streqic (argv[argi], "-h")
-           || streqic (argv[argi], "/h")
-           || streqic (argv[argi], "--help")
-           )
-        {
-            PrintUsage();
-            continue;
-        }
-
-        if (argv[argi][0] == '-') {
-
-            switch (argv[argi][1]) {
-
-                case 'd': case 'D': {
-                    fDebug = 1;
-                    break;
-                }
-
-                default: {
-                    ErrorPrint ("Unrecognized command option (%s).", argv[argi]);
-                    exit (1);
-                    break;
-                }
-            }
-        } else {
-            if (!AppendDest (argv[argi]))
-                return false;
-        }
-    }
-
-    DPrint ("Debug flag on");
-    DPrint ("Destination \"%s\"", m_dest);
-    DPrint ("Destination is %swild.", m_destwild ? "" : "not ");
-
-    // Return true to indicate success.
-
-    return true;
-}
-
-
-//--------------------------------------------------------------------------------------------------
-bool JDContext::ScanEnvironment () {
-
-    // Scans the current environment and initializes the context object
-    // accordingly.  This includes the current working directory, the current
-    // drive mappings, the data file, and so forth.
-    //
-    // Returns true if the scan/initialization succeeded, otherwise false.
-    //--------------------------------------------------------------------------
-
-    // Load the current working directory.
-
-    if (!_getcwd (m_cwd, static_cast<int>(std::size(m_cwd))))
-        return false;
-
-    SlashForward (m_cwd);
-
-    if (!ScanDrives()) return false;
-
-    if (!Load()) return false;
-
-    return true;
-}
-
-
-//--------------------------------------------------------------------------------------------------
-bool JDContext::ScanDrives () {
-
-    // Scan the currently mapped drives for type and other info. Returns True if
-    // the scan was successful, otherwise false.
-    //----------------------------------------------------------------------------------------------
-
-    return true;
-}
-
-
-//--------------------------------------------------------------------------------------------------
-bool JDContext::Load () {
-
-    // Loads the jumpdir data file and initializes the related fields in the JDContext object.
-    //
-    // Returns True if the scan was successful, otherwise false.
-    //----------------------------------------------------------------------------------------------
-
-    DPrint ("Loading jump data.");
-
-    size_t jumpDataStrLength;
-
-    getenv_s (&jumpDataStrLength, NULL, 0, "JUMPDATA");
-
-    if (jumpDataStrLength) {
-
-        auto dbFilename = new char [jumpDataStrLength];
-
-        if (0 != getenv_s (&jumpDataStrLength, dbFilename, jumpDataStrLength, "JUMPDATA"))
-            return false;
-
-        m_dbFilename = dbFilename;
-
-        DPrint ("Using %%JUMPDATA%%=\"%s\"", m_dbFilename);
-    } else {
-        DPrint ("JUMPDATA is not defined.");
-
-        size_t userProfileStrLength;
-        getenv_s (&userProfileStrLength, NULL, 0, "USERPROFILE");
-
-        if (!userProfileStrLength) {
-            DPrint ("USERPROFILE is not defined. Hmmm, didn't expect THAT.");
-            ErrorPrint ("Couldn't find jumpdir.dat file. Neither JUMPDATA nor\nUSERPROFILE is defined.");
-            exit (1);
-        }
-
-        auto  userProfilePath = new char [userProfileStrLength];
-
-        if (0 != getenv_s (&userProfileStrLength, userProfilePath, userProfileStrLength, "USERPROFILE"))
-            return false;
-
-        m_dbFilename = userProfilePath;
-        m_dbFilename += "\\jumpdir.dat";
-
-        DPrint ("Using \"%s\"", m_dbFilename);
-    }
-
-    return m_jumpData.Load(m_dbFilename);
-}
-
-
-//--------------------------------------------------------------------------------------------------
-bool JDContext::Store () {
-    return m_jumpData.Store(m_dbFilename);
-}
-
-
-//--------------------------------------------------------------------------------------------------
-void JDContext::EnumerateNetMaps () {
-    DPrint ("Enumerating network drive mappings.");
-
-    // char driveStr[] = "X:";
-    // char netName [MAX_PATH + 1];
-    int  driveNum;
-
-    for (driveNum=0;  driveNum < c_numDrives;  ++driveNum) {
-    }
-}
-
-
-//--------------------------------------------------------------------------------------------------
-bool JDContext::HandleTrivialChange () {
-
-    // This routine handles trivial target directories. This includes null directories, and
-    // non-wildcard directories that begin with '.' or '..'. This routine assumes that the
-    // m_destwild member variable has already been set properly.
-    //----------------------------------------------------------------------------------------------
-
-    DPrint ("Trivial change?");
-
-    // Bail out if the destination path contains wildcard characters.
-
-    if (m_destwild) {
-        DPrint ("Not trivial; destination path contains wildcards.");
-        return false;
-    }
-
-    // If no directory was specified, and if no other commands were supplied,
-    // then echo the current directory.
-
-    if (m_dest[0] == 0) {
-        DPrint ("Null directory; echo current.");
-        printf ("echo %s\n", m_cwd);
-        return true;
-    }
-
-    // If this is not a dot directory; then handle elsewhere.
-
-    if (m_dest[0] != '.') {
-        DPrint ("Not trivial (not null and not dot directory).");
-        return false;
-    }
-
-    // If the directory is literally ".", we're already there, so return true.
-
-    if (0 == strcmp(m_dest, ".")) {
-        DPrint ("Literally '.'; no action.");
-        return true;
-    }
-
-    // If this is a path that begins with a single dot directory, then use that
-    // path directly.
-
-    if (m_dest[1] == '/') {
-        SlashBackward (m_dest);
-        printf ("cd \"%s\"\n", m_dest);
-        return true;
-    }
-
-    if (m_dest[1] != '.')   // Something else that begins with a dot.
-        return false;
-
-    // If the first subdirectory is "..", then use that path directly.
-
-    if ((m_dest[2] == 0) || (m_dest[2] == '/')) {
-        SlashBackward (m_dest);
-        printf ("cd \"%s\"\n", m_dest);
-        return true;
-    }
-
-    return false;           // For all other paths, handle elsewhere.
-}
-
-
-//--------------------------------------------------------------------------------------------------
-bool JDContext::Jump () {
-
-    // Jumps to the destination directory.
-    //
-    // Returns true if a match was found, and the function successfully changed to that matching
-    // directory.
-    //----------------------------------------------------------------------------------------------
-
-    if (HandleTrivialChange()) return true;
-
-    DPrint ("Seeing if new target matches current directory.");
-
-    if (0 == _stricmp(m_cwd, m_dest)) {
-        DPrint ("Tried to change to same directory as current.");
-        return false;
-    }
-
-    DPrint ("Attempting to change to \"%s\".", m_dest);
-
-    if (0 == _chdir(m_dest)) {
-        DPrint ("Successfully changed to \"%s\".", m_dest);
-        printf ("cd /d %s\n", m_dest);
-        return true;
-    }
-
-    DPrint ("Attempt failed.");
-
-    return false;
-}
-
-
-//--------------------------------------------------------------------------------------------------
-bool JDContext::AppendDest (const char* path) {
-    size_t roomleft = sizeof(m_dest) - m_destlen - 1;
-
-    if (m_destlen > 0) roomleft -= 1;
-
-    if (strlen(path) > roomleft) return false;
-
-    if (m_destlen > 0)
-        m_dest[m_destlen++] = ' ';
-
-    for (;  *path != 0;  ++path, ++m_destlen) {
-
-        if (!m_destwild && isWildStr(path))
-            m_destwild = true;
-
-        if (*path == '\\')
-            m_dest[m_destlen] = '/';
-        else
-            m_dest[m_destlen] = *path;
-    }
-
-    m_dest[m_destlen] = 0;
-
-    return true;
-}
-
-
-
-//======================================================================================================================
-// Main Program
-//======================================================================================================================
-
-// int wmain (int argc, const wchar_t* const argv[]) {
-int main (int argc, const char* const argv[]) {
-
-    // The main entry point for the jumpdir program. Returns the return code for the entire program.
-
-    assert ((sizeof(DirEntry) & 0x7) == 0);
-
-    FileSysProxyWindows fsProxy;
-
-    JDContext context {fsProxy};
-
-    if (!context.ParseArgs(argc, argv)) return 1;
-    if (!context.ScanEnvironment()) return 1;
-    if (!context.Jump()) return 1;
-    if (!context.Store()) return 1;
-
-    return 0;
-}
+//======================================================================================================================
+// jumpdir - A smart directory navigation command
+//
+// Copyright 2017 Steve Hollasch. All rights reserved.
+//======================================================================================================================
+
+#include "json.hpp"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#include <share.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <pathmatcher.h>
+#include <fileSystemProxyWindows.h>
+
+
+using namespace PMatcher;
+using namespace FSProxy;
+using json = nlohmann::json;
+
+
+// Program Parameters and Constants
+
+bool fDebug = false;
+
+
+// Version and Usage Information
+
+static const char* usage[] = {
+    "",
+    "jumpdir v0.0.10 / (c) 2017 Steve Hollasch",
+    "",
+    "jumpdir: Adaptive directory navigation for the command line",
+    "Usage:   jumpdir <directory>",
+    "         jumpdir ~<characters>",
+    "         jumpdir --nearest <directory>",
+    "         jumpdir --search <level> <directory>",
+    "         jumpdir --export-json <file>",
+    "         jumpdir --import-json <file>",
+    "         jumpdir --list <pattern>",
+    "         jumpdir --purge <pattern>",
+    "",
+    "    This command changes the directory as specified.",
+    "",
+    "    ~<characters>         Jump to the best visited directory that holds the characters in order.",
+    "    --nearest             Of several matches, prefer the one fewest hops from the current directory.",
+    "    --search <level>      How hard to look: quick (visited directories only), normal (the default), or",
+    "                          thorough (a longer deadline, no probe limit, and network paths even without netSearch).",
+    "    --export-json <file>  Write the directory history and settings to a JSON file.",
+    "    --import-json <file>  Replace the directory history and settings from a JSON file.",
+    "    --list <pattern>      List the history entries that match a wildcard path pattern.",
+    "    --purge <pattern>     Remove the history entries that match a wildcard path pattern.",
+    0
+};
+
+
+
+//======================================================================================================================
+// Utility Functions
+//======================================================================================================================
+
+void PrintUsage () {
+
+    // Prints out usage information for this tool.
+    //----------------------------------------------------------------------------------------------
+
+    int i;
+
+    for (i=0;  usage[i];  ++i) {
+        if (usage[i][0] == 0)
+            puts ("echo.");
+        else
+            printf ("echo %s\n", usage[i]);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void DPrint (const char* format, ...) {
+
+    // Prints one line of debug information. The formatted string does not need a carriage return.
+    //
+    // 'format' - a printf-style format string
+    // ...      - the remainder of the printf-style arguments
+    //----------------------------------------------------------------------------------------------
+
+    if (!fDebug) return;
+
+    va_list vl;
+    va_start (vl, format);
+
+    fputs ("# ", stderr);
+    vfprintf_s (stderr, format, vl);
+    fputc ('\n', stderr);
+
+    va_end (vl);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void ErrorPrint (const char* format, ...) {
+
+    // Prints a printf-style message plus arguments to the error output stream, followed by a
+    // carriage return.
+    //----------------------------------------------------------------------------------------------
+
+    va_list vl;
+    va_start (vl, format);
+
+    fputs ("jumpdir: ", stderr);
+    vfprintf_s (stderr, format, vl);
+    fputc ('\n', stderr);
+
+    va_end (vl);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+inline bool streqic (const char *str1, const char *str2) {
+
+    // Returns true if the two strings are non-null and equal, ignoring case. Either string
+    // argument may be null.
+    //----------------------------------------------------------------------------------------------
+
+    return (str1 != 0) && (str2 != 0) && (0 == _stricmp(str1,str2));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void SlashForward (char* str) {
+
+    // Given a string pointer, converts all back slashes to forward slashes.
+    //----------------------------------------------------------------------------------------------
+
+    char* ptr;
+
+    for (ptr=str;  *ptr;  ++ptr) {
+       if (*ptr == '\\')
+            *ptr = '/';
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void SlashBackward (char* str) {
+
+    // Given a string pointer, converts all forward slashes to back slashes.
+    //----------------------------------------------------------------------------------------------
+
+    char* ptr;
+
+    for (ptr=str;  *ptr;  ++ptr) {
+       if (*ptr == '/') *ptr = '\\';
+    }
+}
+
+
+
+//--------------------------------------------------------------------------------------------------
+static bool isWildStr (const char* str) {
+
+    // Returns true if the given string begins with a wildcard character sequence.
+    // This includes '?', '*', '**', or '...'.
+    //----------------------------------------------------------------------------------------------
+
+    return (*str == '?')
+        || (*str == '*')
+        || ((str[0] == '.') && (str[1] == '.') && (str[2] == '.'));
+}
+
+
+
+//--------------------------------------------------------------------------------------------------
+static std::wstring WidenPath (const char* path) {
+
+    // Returns the given path as a wide string, as used by the path matcher. Paths are recorded
+    // through the ANSI file APIs, so they are in the active code page.
+    //----------------------------------------------------------------------------------------------
+
+    auto length = MultiByteToWideChar (CP_ACP, 0, path, -1, nullptr, 0);
+
+    if (length <= 1)
+        return std::wstring();
+
+    std::wstring wide (length - 1, L'\0');
+    MultiByteToWideChar (CP_ACP, 0, path, -1, &wide[0], length);
+
+    return wide;
+}
+
+
+
+//--------------------------------------------------------------------------------------------------
+static bool ConvertCodePage (UINT fromPage, UINT toPage, const string& text, string& result) {
+
+    // Converts the given text from one code page to another, by way of UTF-16. Used to move paths
+    // between the active code page and UTF-8 at the JSON export/import boundary.
+    //
+    // Returns false if the text isn't valid in 'fromPage', or holds characters that 'toPage' can't
+    // represent.
+    //----------------------------------------------------------------------------------------------
+
+    result.clear();
+
+    if (text.empty())
+        return true;
+
+    auto wideLength = MultiByteToWideChar (fromPage, MB_ERR_INVALID_CHARS, text.c_str(), -1, nullptr, 0);
+
+    if (wideLength <= 1)
+        return false;
+
+    std::wstring wide (wideLength - 1, L'\0');
+    MultiByteToWideChar (fromPage, MB_ERR_INVALID_CHARS, text.c_str(), -1, &wide[0], wideLength);
+
+    // UTF-8 represents everything, and WideCharToMultiByte rejects the lossy-conversion checks for it.
+
+    DWORD flags     = (toPage == CP_UTF8) ? 0 : WC_NO_BEST_FIT_CHARS;
+    BOOL  lossy     = FALSE;
+    BOOL* lossyFlag = (toPage == CP_UTF8) ? nullptr : &lossy;
+
+    auto length = WideCharToMultiByte (toPage, flags, wide.c_str(), -1, nullptr, 0, nullptr, lossyFlag);
+
+    if (length <= 1 || lossy)
+        return false;
+
+    result.assign (length - 1, '\0');
+    WideCharToMultiByte (toPage, flags, wide.c_str(), -1, &result[0], length, nullptr, nullptr);
+
+    return true;
+}
+
+
+
+//--------------------------------------------------------------------------------------------------
+static DWORD VolumeSerialNumber (const char* path) {
+
+    // Returns the serial number of the volume holding the given drive-letter path, or zero if the
+    // path has no drive letter or the volume can't be queried.
+    //----------------------------------------------------------------------------------------------
+
+    if (!isalpha(static_cast<unsigned char>(path[0])) || (path[1] != ':'))
+        return 0;
+
+    char  root[] = { path[0], ':', '\\', 0 };
+    DWORD serialNumber = 0;
+
+    if (!GetVolumeInformationA (root, NULL, 0, &serialNumber, NULL, NULL, NULL, 0))
+        return 0;
+
+    return serialNumber;
+}
+
+
+
+static const size_t c_maxProbeThreads = 8;    // Most directory probes in flight at once
+
+//--------------------------------------------------------------------------------------------------
+static size_t FirstExistingDirectory (const vector<string>& paths, SearchBudget& budget) {
+
+    // Returns the index of the first of the given paths that names an existing directory, or
+    // paths.size() if none do.
+    //
+    // Probing a network path can take a full round trip, so up to c_maxProbeThreads threads probe
+    // the paths concurrently. Each thread takes the next unprobed path in order, and stops once it
+    // reaches a path that comes after a directory already found. Every path before the one returned
+    // is thus probed, so the result is the same as probing one at a time, but takes about as long
+    // as the slowest single probe.
+    //
+    // Only as many paths as the search budget has directory visits left are probed, and each probe
+    // made is charged as a visit. The probes all run on their own threads, so that a probe stuck on
+    // an unreachable server can't hold the prompt past the budget's deadline: at the deadline this
+    // function stops waiting, and leaves any stuck probes to finish on their own. The result is then
+    // the first directory found so far, which a stuck probe of an earlier path might have beaten.
+    // The probe threads never touch the budget itself, since abandoned ones outlive this call.
+    //----------------------------------------------------------------------------------------------
+
+    if (paths.empty() || budget.Spent())
+        return paths.size();
+
+    auto limit = std::min (paths.size(), budget.DirectoriesLeft());   // Paths the budget allows probing
+
+    if (limit == 0) {
+        budget.VisitDirectory();    // Records the directory limit as the cut
+        return paths.size();
+    }
+
+    // The probe state is shared with the probe threads, since abandoned probes outlive this call.
+
+    struct ProbeState {
+        vector<string>          paths;         // Paths to probe
+        std::atomic<size_t>     next {0};      // Next path to probe
+        std::atomic<size_t>     found;         // Lowest index found to exist so far
+        std::atomic<size_t>     probes {0};    // Probes made
+        size_t                  running;       // Probe threads not yet finished
+        std::mutex              lock;          // Guards running
+        std::condition_variable finished;      // Signalled as each probe thread finishes
+    };
+
+    auto state = std::make_shared<ProbeState>();
+
+    state->paths.assign (paths.begin(), paths.begin() + limit);
+    auto numWorkers = std::min (limit, c_maxProbeThreads);
+
+    state->found   = limit;
+    state->running = numWorkers;
+
+    auto probe = [state]() {
+        auto& found = state->found;
+
+        for (auto i = state->next++;  (i < state->paths.size()) && (i < found);  i = state->next++) {
+            ++state->probes;
+
+            auto attributes = GetFileAttributesA (state->paths[i].c_str());
+
+            if ((attributes == INVALID_FILE_ATTRIBUTES) || !(attributes & FILE_ATTRIBUTE_DIRECTORY))
+                continue;
+
+            auto lowest = found.load();
+
+            while ((i < lowest) && !found.compare_exchange_weak (lowest, i))
+                continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock { state->lock };
+            --state->running;
+        }
+
+        state->finished.notify_all();
+    };
+
+    vector<std::thread> workers;
+
+    for (size_t worker=0;  worker < numWorkers;  ++worker)
+        workers.emplace_back (probe);
+
+    auto allFinished = true;
+
+    {
+        std::unique_lock<std::mutex> lock { state->lock };
+        auto done = [&state]() { return state->running == 0; };
+
+        if (budget.HasDeadline())
+            allFinished = state->finished.wait_until (lock, budget.Deadline(), done);
+        else
+            state->finished.wait (lock, done);
+    }
+
+    if (!allFinished) {
+        state->next = state->paths.size();    // Starts no further probes
+        budget.Spent();                       // Records the deadline as the cut
+    }
+
+    budget.ChargeDirectories (state->probes);
+
+    // If every allowed path was probed in vain, but more paths remain, the directory limit cut the
+    // search short.
+
+    if (allFinished && (state->found == limit) && (limit < paths.size()))
+        budget.VisitDirectory();    // Records the directory limit as the cut
+
+    for (auto& worker : workers) {
+        if (allFinished)
+            worker.join();
+        else
+            worker.detach();
+    }
+
+    auto winner = state->found.load();
+
+    return (winner < limit) ? winner : paths.size();
+}
+
+
+
+//======================================================================================================================
+// Data File Layout
+//
+// The jump data file is a single binary image that is mapped read-only into memory and used in place; there is no
+// parse or copy step when loading. All cross references inside the image are byte offsets or table indices (never
+// pointers), so the image is valid wherever it happens to be mapped.
+//
+// The image is a sequence of c_jdPageSize-byte pages. The first pages hold the header and the page directory, and
+// each of the three tables that follow starts on a page boundary:
+//
+//     Offset 0                  JDFileHeader, then the page directory:
+//                                   uint32_t   [header.numPages - header.firstDataPage]  Page checksums
+//                                   uint32_t   [header.numEntryPages]                    First entry of each entry page
+//                                   JDVolume   [header.numVolumes]                       Volume table
+//     header.entryTableOffset   Entry pages [header.numEntryPages] (see Entry Encoding)
+//     header.nodeTableOffset    JDPathNode [header.numPathNodes]
+//     header.stringPoolOffset   String pool (header.stringPoolSize bytes of null-terminated path strings)
+//     header.hashTableOffset    JDHashSlot [header.numHashSlots] (see Path Index)
+//     header.tailIndexOffset    uint32_t [header.numPathNodes] (see Tail Index)
+//     header.nodeEntryOffset    uint32_t [header.numPathNodes] (see Tail Index)
+//     header.trigramOffset      JDTrigram [header.numTrigrams + 1] (see Trigram Index)
+//     header.postingsOffset     uint32_t [header.numPostings] (see Trigram Index)
+//     header.prefixOffset       uint32_t [header.numHistEntries] (see Prefix Index)
+//
+// No entry, node, string or hash slot straddles a page boundary. The string pool is padded with null characters
+// where needed, so every pool page ends with a null character. The string pool always begins with an empty string,
+// so a string offset of zero denotes an empty (or absent) string.
+//
+// Paths are stored as a trie of path components with parent pointers. Each entry references the trie node for its
+// final component, and the full path is the chain of component names from the root down to that node, joined with
+// '/'. Each distinct component string is stored once in the string pool, and each distinct path prefix is stored
+// once in the node table, so entries that share a prefix share its storage.
+//
+// Each distinct volume is stored once in the volume table, and entries refer to it by index.
+//
+// Path Index
+//
+// The path index is an open-addressing hash table (with linear probing) from path to entry index, so that the
+// entry for a given path is found without walking the history. Its size is a power of two, at least twice the
+// number of entries. Each slot holds the high 32 bits of the 64-bit FNV-1a hash of the path key (see
+// JumpData::PathKey) and the entry index, or c_noEntry for an empty slot. A slot's hash bits screen out nearly every
+// collision before the candidate entry is decoded and compared. Recency order needs no links of its own: each
+// snapshot stores its entries in recency order, and order only changes when a new snapshot is written.
+//
+// Tail Index
+//
+// The tail index serves the Tail Match strategy, which looks for paths that end in a given string. It lists every
+// trie node, ordered by its component name reversed and lowercased, so all components that end in a given string
+// form one contiguous run that a binary search finds. A companion table gives, for each trie node, the entry whose
+// path ends at that node (c_noEntry if none). A tail such as "x86/icecap" is matched by finding the nodes named
+// "icecap" and checking that each one's parent name ends in "x86"; the matching entries then come straight from the
+// node table, without a scan of the history.
+//
+// Trigram Index
+//
+// The trigram index serves the Wildcard Match strategy. For each trigram (three consecutive characters) that occurs
+// in any path key, the trigram table gives a posting list: the ascending list of entries whose path keys contain
+// it. The table is sorted by trigram, and ends with a sentinel whose m_first is the total posting count, so each
+// list runs from its own m_first to the next one's. Trigrams are taken only from runs of ASCII characters within
+// a single path component, since the path matcher treats slashes and case folding of other characters specially.
+// Every literal run of a wildcard pattern must appear in a matching path, so intersecting the posting lists of the
+// pattern's trigrams yields a short list of candidate entries, and only those need the full pattern match.
+//
+// Prefix Index
+//
+// The prefix index serves nearest-match ranking (--nearest), which prefers the match fewest hops from the current
+// directory (up to the common ancestor, then back down). It lists every entry, ordered by path key, so the entries
+// under any directory form one contiguous run that a binary search finds. Starting from the current directory,
+// each ancestor's run, less the run of the ancestor below it, holds the entries whose nearest common ancestor it
+// is. Taking these rings outward visits matches in order of increasing minimum hop count, and the search stops at
+// the first ring that can't beat the best match so far, without measuring the distance to every match.
+//
+// The header carries the format version and a CRC-32 of the header itself (taken with the checksum field zeroed)
+// followed by the page directory, which in turn holds a CRC-32 for each page past the directory. A damaged header
+// field, such as a table offset or count, fails the check just as a damaged directory does.
+//
+// Paged Loading
+//
+// Entries are written most recent first, and trie nodes and component names are written in the order the entries
+// first use them, so the pages of every table run from newest to oldest history. Loading checks only the header and
+// the page directory. Each other page is checked against its directory CRC the first time it is used. A lookup that
+// is satisfied by recent history therefore faults in just the first few pages of each table, however long the
+// history is. A page that fails its check is treated as missing, and the entries that depend on it are skipped.
+// Compaction reads every entry, and so finds any damaged page; rather than publish a snapshot without the entries it
+// lost, it recovers them from the previous generation.
+//
+// Snapshots and Generations
+//
+// A snapshot is never modified once published. Each is written to "<data>.tmp", flushed to disk, and renamed to
+// "<data>.<generation>". The data file itself ("<data>") holds only a JDControlBlock, which every process maps
+// shared, and which holds the generation number of the current snapshot. A writer publishes a new snapshot with a
+// single atomic store of its generation number. A reader pins a snapshot by reading the generation number and
+// opening that snapshot; readers take no locks and never wait on a writer. After publishing, the writer deletes the
+// generation before the previous one. Snapshots are opened with delete sharing, so a reader that still has a deleted
+// snapshot open keeps its view until it is done. If the current snapshot fails validation, Load falls back to the
+// previous generation.
+//======================================================================================================================
+
+static const uint32_t c_jdMagic         = 0x5244504A;    // 'JPDR', little-endian
+static const uint32_t c_jdControlMagic  = 0x4344504A;    // 'JPDC', little-endian
+static const uint32_t c_jdFormatVersion = 11;            // Current data file format version
+static const uint32_t c_jdPageSize      = 4096;          // Size of data file pages
+static const int      c_maxLoadAttempts = 16;            // Snapshot pin attempts before settling
+static const uint32_t c_noEntry         = 0xffffffff;    // Null entry index
+static const uint32_t c_noNode          = 0xffffffff;    // Null path node index (parent of top-level nodes)
+
+
+//--------------------------------------------------------------------------------------------------
+static uint32_t Crc32 (uint32_t crc, const void* data, size_t size) {
+
+    // Returns the running CRC-32 (IEEE 802.3 polynomial) of the given data, continuing from the
+    // CRC of any prior data. Use a starting CRC of zero.
+    //----------------------------------------------------------------------------------------------
+
+    static const auto table = [] {
+        std::array<uint32_t, 256> entries;
+        for (uint32_t i=0;  i < 256;  ++i) {
+            uint32_t value = i;
+            for (int bit=0;  bit < 8;  ++bit)
+                value = (value & 1) ? (0xEDB88320 ^ (value >> 1)) : (value >> 1);
+            entries[i] = value;
+        }
+        return entries;
+    }();
+
+    auto bytes = static_cast<const unsigned char*>(data);
+
+    crc = ~crc;
+
+    while (size--)
+        crc = table[(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+
+
+//======================================================================================================================
+// Struct DirEntry
+//======================================================================================================================
+
+struct DirEntry {
+    //--------------------------------------------------------------------------
+    // A history entry, as decoded from an entry page (see Entry Encoding).
+    //--------------------------------------------------------------------------
+
+    uint32_t m_dvol_name;              // Offset of Volume Name
+    uint32_t m_dvol_label;             // Offset of Volume Label
+    uint32_t m_dpath;                  // Path (index of final JDPathNode)
+    DWORD    m_serialnum;              // Volume Serial Number
+    int64_t  m_lastverified;           // Date Last Verified (time_t)
+    uint32_t m_next;                   // Index of Next Directory Entry (c_noEntry terminates)
+    uint32_t m_valid;                  // Entry Valid (nonzero)
+    uint32_t m_visitCount;             // Number of Visits
+    float    m_score;                  // Frecency Score as of m_lastverified (see Frecency)
+};
+
+
+
+//======================================================================================================================
+// Struct JDVolume
+//======================================================================================================================
+
+struct JDVolume {
+    DWORD    m_serialnum;              // Volume Serial Number
+    uint32_t m_name;                   // Offset of Volume Name
+    uint32_t m_label;                  // Offset of Volume Label
+};
+
+static_assert (sizeof(JDVolume) == 12, "JDVolume is part of the data file layout.");
+
+
+
+//======================================================================================================================
+// Entry Encoding
+//
+// History entries are stored in entry pages, most recent first. Each entry page begins with a JDEntryPageHeader,
+// followed by a run of variable-length entry records, each of which is five unsigned LEB128 varints:
+//
+//     Visit time, as the (zig-zag encoded) difference from the previous record's time
+//     Volume table index
+//     Path trie node index, as the (zig-zag encoded) difference from the previous record's node index
+//     Visit count
+//     Frecency score, in units of 1/c_scoreScale
+//
+// The first record of each page is relative to the page header's base time and to node zero, so any page decodes
+// on its own. Since entries are in recency order, time deltas are small, and since trie nodes are numbered in order
+// of first use, node deltas are small too. A typical entry takes six to ten bytes.
+//======================================================================================================================
+
+struct JDEntryPageHeader {
+    uint32_t firstEntry;               // Index of the first entry on this page
+    uint32_t numEntries;               // Count of entries on this page
+    int64_t  baseTime;                 // Time that the first record's time delta is relative to
+};
+
+static_assert (sizeof(JDEntryPageHeader) == 16, "JDEntryPageHeader is part of the data file layout.");
+
+static const size_t c_maxEntryRecordSize = 10 + 5 + 10 + 5 + 10;   // Largest record varints
+static const double c_scoreScale         = 1024.0;              // Stored score units per point
+
+
+//--------------------------------------------------------------------------------------------------
+static size_t PutVarint (uint8_t* out, uint64_t value) {
+
+    // Writes the value as an unsigned LEB128 varint, and returns the number of bytes written.
+    //----------------------------------------------------------------------------------------------
+
+    size_t size = 0;
+
+    while (value >= 0x80) {
+        out[size++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+
+    out[size++] = static_cast<uint8_t>(value);
+
+    return size;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+static bool GetVarint (const uint8_t*& in, const uint8_t* end, uint64_t& value) {
+
+    // Reads an unsigned LEB128 varint, advancing the input pointer past it.
+    //
+    // Returns false if the varint runs past the end of the input or is too long.
+    //----------------------------------------------------------------------------------------------
+
+    value = 0;
+
+    for (int shift=0;  (in < end) && (shift < 64);  shift += 7) {
+        auto byte = *in++;
+        value |= uint64_t{byte & 0x7fu} << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+static uint64_t ZigZag (int64_t value) {
+
+    // Maps signed values to unsigned ones so that small magnitudes encode small: 0, -1, 1, -2, ...
+    // become 0, 1, 2, 3, ...
+    //----------------------------------------------------------------------------------------------
+
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+static int64_t UnZigZag (uint64_t value) {
+
+    // Reverses ZigZag().
+    //----------------------------------------------------------------------------------------------
+
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+
+
+//======================================================================================================================
+// Struct JDPathNode
+//======================================================================================================================
+
+struct JDPathNode {
+    uint32_t m_parent;                 // Index of Parent Node (c_noNode for top-level components)
+    uint32_t m_name;                   // Offset of Component Name
+};
+
+static_assert (sizeof(JDPathNode) == 8, "JDPathNode is part of the data file layout.");
+static_assert (c_jdPageSize % sizeof(JDPathNode) == 0, "Path nodes must not straddle pages.");
+
+
+
+//======================================================================================================================
+// Struct JDTrigram
+//======================================================================================================================
+
+struct JDTrigram {
+    uint32_t m_trigram;                // Trigram (first character in bits 16-23, last in bits 0-7)
+    uint32_t m_first;                  // Index of First Posting
+};
+
+static_assert (sizeof(JDTrigram) == 8, "JDTrigram is part of the data file layout.");
+static_assert (c_jdPageSize % sizeof(JDTrigram) == 0, "Trigrams must not straddle pages.");
+
+
+//--------------------------------------------------------------------------------------------------
+static void PathTrigrams (const string& key, vector<uint32_t>& trigrams) {
+
+    // Appends the distinct trigrams of the given path key (or lowercased pattern literal) to the
+    // list, in ascending order. See Trigram Index for which characters contribute trigrams.
+    //----------------------------------------------------------------------------------------------
+
+    auto start = trigrams.size();
+    auto isRun = [](char c) { return (c != '/') && !(static_cast<unsigned char>(c) & 0x80); };
+
+    for (size_t i=0;  i + 2 < key.size();  ++i) {
+        if (isRun(key[i]) && isRun(key[i+1]) && isRun(key[i+2])) {
+            trigrams.push_back (  (uint32_t{static_cast<unsigned char>(key[i])}   << 16)
+                                | (uint32_t{static_cast<unsigned char>(key[i+1])} <<  8)
+                                |  uint32_t{static_cast<unsigned char>(key[i+2])});
+        }
+    }
+
+    std::sort (trigrams.begin() + start, trigrams.end());
+    trigrams.erase (std::unique (trigrams.begin() + start, trigrams.end()), trigrams.end());
+}
+
+
+
+//======================================================================================================================
+// Struct JDHashSlot
+//======================================================================================================================
+
+struct JDHashSlot {
+    uint32_t m_hash;                   // High 32 bits of the path key hash
+    uint32_t m_entry;                  // Entry Index (c_noEntry for an empty slot)
+};
+
+static_assert (sizeof(JDHashSlot) == 8, "JDHashSlot is part of the data file layout.");
+static_assert (c_jdPageSize % sizeof(JDHashSlot) == 0, "Hash slots must not straddle pages.");
+
+
+//--------------------------------------------------------------------------------------------------
+static uint64_t PathHash (const string& key) {
+
+    // Returns the 64-bit FNV-1a hash of the given path key.
+    //----------------------------------------------------------------------------------------------
+
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (auto c : key) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+static int CompareTail (const char* name, size_t nameLength, const char* tail, size_t tailLength) {
+
+    // Compares a component name against a lowercase tail string, backwards from their last
+    // characters and without regard to case. This is the tail index order (see Tail Index).
+    //
+    // Returns zero if the name ends in the tail, otherwise less than or greater than zero as the
+    // reversed name sorts before or after the reversed tail.
+    //----------------------------------------------------------------------------------------------
+
+    for (size_t i=1;  i <= tailLength;  ++i) {
+        if (i > nameLength)
+            return -1;
+
+        int nameChar = tolower (static_cast<unsigned char>(name[nameLength - i]));
+        int tailChar = static_cast<unsigned char>(tail[tailLength - i]);
+
+        if (nameChar != tailChar)
+            return (nameChar < tailChar) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+static vector<string> PathComponents (const string& key) {
+
+    // Returns the components of a path key, in order. Empty components (from doubled, leading or
+    // trailing slashes) are dropped.
+    //----------------------------------------------------------------------------------------------
+
+    vector<string> components;
+    size_t         start = 0;
+
+    while (start < key.size()) {
+        auto end = key.find ('/', start);
+
+        if (end == string::npos)
+            end = key.size();
+
+        if (end > start)
+            components.emplace_back (key, start, end - start);
+
+        start = end + 1;
+    }
+
+    return components;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+static uint32_t HopCount (const vector<string>& from, const string& toKey) {
+
+    // Returns the number of directory hops from the path with the given components to the path
+    // with the given key: up to their nearest common ancestor, and then back down.
+    //----------------------------------------------------------------------------------------------
+
+    auto   to     = PathComponents (toKey);
+    size_t common = 0;
+
+    while ((common < from.size()) && (common < to.size()) && (from[common] == to[common]))
+        ++common;
+
+    return static_cast<uint32_t>((from.size() - common) + (to.size() - common));
+}
+
+
+
+//======================================================================================================================
+// Class JDMemPool
+//======================================================================================================================
+
+class JDMemPool {
+    //--------------------------------------------------------------------------
+    // The string pool of the jump data file. The pool does not own its memory; it is attached to the string pool
+    // region of the mapped data file.
+    //--------------------------------------------------------------------------
+
+  public:
+    JDMemPool () : m_size{0}, m_heap{0} { }
+
+    void Attach (const void* block, unsigned int size);
+
+    const char* String (unsigned int offset) const;
+
+  private:
+    unsigned int  m_size;
+    const char   *m_heap;
+};
+
+
+//--------------------------------------------------------------------------------------------------
+void JDMemPool::Attach (const void *block, unsigned int size) {
+
+    // This method sets the block and size for the memory pool, as mapped from the data file. This
+    // memory pool can be effectively detached by calling it with (0,0) as the arguments.
+    //
+    // Ensure that the block is non-null if the size is non-zero.
+    //----------------------------------------------------------------------------------------------
+
+    assert ((size == 0) == (block == NULL));
+
+    m_heap = static_cast<const char*>(block);
+    m_size = size;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+const char* JDMemPool::String (unsigned int offset) const {
+
+    // Returns the pool string at the given offset. Offsets outside the pool (as from a damaged data
+    // file) yield the empty string. Every pool page ends in a null character (see Data File
+    // Layout), so any in-range offset on an intact page yields a terminated string.
+    //----------------------------------------------------------------------------------------------
+
+    if (offset >= m_size)
+        return "";
+
+    return m_heap + offset;
+}
+
+
+
+//======================================================================================================================
+// Class JDFileHeader
+//======================================================================================================================
+
+class JDFileHeader {
+  public:
+
+    JDFileHeader ()
+      : magic            {c_jdMagic},
+        version          {c_jdFormatVersion},
+        headerSize       {sizeof(JDFileHeader)},
+        pageSize         {c_jdPageSize},
+        numPages         {0},
+        firstDataPage    {0},
+        maxHistSize      {-1},
+        dirEcho          {false},
+        verbose          {false},
+        netSearch        {true},
+        automap          {true},
+        numHistEntries   {0},
+        headEntry        {c_noEntry},
+        numEntryPages    {0},
+        numVolumes       {0},
+        entryTableOffset {0},
+        numPathNodes     {0},
+        nodeTableOffset  {0},
+        stringPoolOffset {0},
+        stringPoolSize   {0},
+        hashTableOffset  {0},
+        numHashSlots     {0},
+        tailIndexOffset  {0},
+        nodeEntryOffset  {0},
+        trigramOffset    {0},
+        numTrigrams      {0},
+        postingsOffset   {0},
+        numPostings      {0},
+        prefixOffset     {0},
+        checksum         {0},
+        generation       {0}
+    {
+    }
+
+    uint32_t Checksum (const void* directory, size_t directorySize) const {
+        //--------------------------------------------------------------------------
+        // Returns the CRC-32 of this header (taken with its checksum field zeroed) followed by the page directory.
+        //--------------------------------------------------------------------------
+
+        JDFileHeader header;
+        memcpy (&header, this, sizeof(header));
+        header.checksum = 0;
+
+        return Crc32 (Crc32 (0, &header, sizeof(header)), directory, directorySize);
+    }
+
+    // Data Fields
+
+    uint32_t     magic;            // Data file signature (c_jdMagic)
+    uint32_t     version;          // Data file format version (c_jdFormatVersion)
+    uint32_t     headerSize;       // Size of this header in the data file
+    uint32_t     pageSize;         // Size of data file pages (c_jdPageSize)
+    uint32_t     numPages;         // Count of pages in the data file
+    uint32_t     firstDataPage;    // Index of the first page after the page directory
+    int          maxHistSize;      // Max Number of History Entries
+    bool         dirEcho;          // Echo new directories?
+    bool         verbose;          // Echo resultant shell commands?
+    bool         netSearch;        // Search network paths?
+    bool         automap;          // Automatically map network drives?
+    unsigned int numHistEntries;   // Current count of path history entries
+    uint32_t     headEntry;        // Index of most recent history entry
+    uint32_t     numEntryPages;    // Count of entry pages
+    uint32_t     numVolumes;       // Count of volume table entries
+    uint32_t     entryTableOffset; // File offset of the first entry page
+    uint32_t     numPathNodes;     // Count of path trie nodes
+    uint32_t     nodeTableOffset;  // File offset of the JDPathNode table
+    uint32_t     stringPoolOffset; // File offset of the string pool
+    uint32_t     stringPoolSize;   // Size in bytes of the string pool
+    uint32_t     hashTableOffset;  // File offset of the path index
+    uint32_t     numHashSlots;     // Count of path index slots (a power of two)
+    uint32_t     tailIndexOffset;  // File offset of the tail index
+    uint32_t     nodeEntryOffset;  // File offset of the node entry table
+    uint32_t     trigramOffset;    // File offset of the trigram table
+    uint32_t     numTrigrams;      // Count of trigrams (not counting the sentinel)
+    uint32_t     postingsOffset;   // File offset of the trigram posting lists
+    uint32_t     numPostings;      // Count of trigram postings
+    uint32_t     prefixOffset;     // File offset of the prefix index
+    uint32_t     checksum;         // CRC-32 of this header and the page directory (see Checksum())
+    int64_t      generation;       // Snapshot generation number
+};
+
+
+
+//======================================================================================================================
+// Struct JDControlBlock
+//======================================================================================================================
+
+struct JDControlBlock {
+    //--------------------------------------------------------------------------
+    // The contents of the data file proper, mapped shared by all jumpdir processes (see Snapshots and Generations).
+    // Both counters are only ever changed with interlocked operations, by the process holding the data file lock.
+    //--------------------------------------------------------------------------
+
+    uint32_t         magic;            // Control block signature (c_jdControlMagic)
+    uint32_t         version;          // Data file format version (c_jdFormatVersion)
+    volatile int64_t generation;       // Generation of the current snapshot (zero if none)
+    volatile int64_t journalSeq;       // Journal rotation sequence; odd while a rotation is under way
+};
+
+
+//--------------------------------------------------------------------------------------------------
+static int64_t ReadShared (const volatile int64_t* value) {
+
+    // Reads a control block counter with full fence semantics, so that everything the writer did
+    // before publishing the value is visible to this process.
+    //----------------------------------------------------------------------------------------------
+
+    return InterlockedCompareExchange64 (const_cast<volatile LONGLONG*>(value), 0, 0);
+}
+
+
+
+//======================================================================================================================
+// Class JDMappedFile
+//======================================================================================================================
+
+class JDMappedFile {
+    //--------------------------------------------------------------------------
+    // A view of an entire file, mapped into the address space of this process. Pages are brought in by the operating
+    // system as they are touched. Views are read-only unless opened as writable.
+    //--------------------------------------------------------------------------
+
+  public:
+
+    JDMappedFile () : m_file{INVALID_HANDLE_VALUE}, m_mapping{NULL}, m_view{nullptr}, m_size{0} {}
+    ~JDMappedFile() { Close(); }
+
+    bool Open (const string& filename, bool writable = false);
+    void Close ();
+
+    const void* Data () const { return m_view; }
+    void*       MutableData () const { return m_view; }
+    size_t      Size () const { return m_size; }
+
+  private:
+    HANDLE      m_file;            // Data File Handle
+    HANDLE      m_mapping;         // File Mapping Handle
+    void*       m_view;            // Mapped View of the Entire File
+    size_t      m_size;            // Size of the Mapped File
+};
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDMappedFile::Open (const string& filename, bool writable) {
+
+    // Maps the named file, read-only unless 'writable' is true. Other processes may map, write, or
+    // delete the file while it is mapped; a deleted file's mapping continues to see its contents.
+    // An empty file opens successfully, with a null view and zero size.
+    //
+    // Returns true on success, otherwise false.
+    //----------------------------------------------------------------------------------------------
+
+    Close();
+
+    m_file = CreateFileA (filename.c_str(), GENERIC_READ | (writable ? GENERIC_WRITE : 0),
+                          FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (m_file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx (m_file, &fileSize)) {
+        Close();
+        return false;
+    }
+
+    // Files cannot be mapped with zero size, so just leave the view empty.
+
+    if (fileSize.QuadPart == 0)
+        return true;
+
+    m_mapping = CreateFileMappingA (m_file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+
+    if (m_mapping == NULL) {
+        Close();
+        return false;
+    }
+
+    m_view = MapViewOfFile (m_mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+
+    if (m_view == nullptr) {
+        Close();
+        return false;
+    }
+
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JDMappedFile::Close () {
+
+    // Unmaps the view and releases the file. Safe to call on a closed file.
+    //----------------------------------------------------------------------------------------------
+
+    if (m_view)
+        UnmapViewOfFile (m_view);
+
+    if (m_mapping != NULL)
+        CloseHandle (m_mapping);
+
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle (m_file);
+
+    m_file    = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+    m_view    = nullptr;
+    m_size    = 0;
+}
+
+
+
+//======================================================================================================================
+// Class JDPathTrieBuilder
+//======================================================================================================================
+
+class JDPathTrieBuilder {
+    //--------------------------------------------------------------------------
+    // Builds the path trie node table and string pool for a new data file snapshot (see Data File Layout). Paths
+    // that share a prefix share the trie nodes for that prefix, and each distinct component name is pooled once.
+    // Nodes and names are laid out in the order that paths are added.
+    //--------------------------------------------------------------------------
+
+  public:
+    JDPathTrieBuilder () : m_pool(1, '\0') {}
+
+    uint32_t AddPath   (const string& path);
+    uint32_t AddString (const string& str);
+
+    const vector<JDPathNode>& Nodes () const { return m_nodes; }
+    const string&             Pool  () const { return m_pool; }
+
+  private:
+    vector<JDPathNode>             m_nodes;      // Trie Node Table
+    string                         m_pool;       // String Pool
+    unordered_map<string,uint32_t> m_strings;    // Pooled string to its offset
+    unordered_map<string,uint32_t> m_children;   // Parent index + component name to child node
+};
+
+
+//--------------------------------------------------------------------------------------------------
+uint32_t JDPathTrieBuilder::AddPath (const string& path) {
+
+    // Adds the given slash-separated path to the trie, reusing any nodes already present for its
+    // prefixes. Every slash separates two components, so empty components (as in the leading
+    // slashes of a UNC path) are preserved, and the path can be rebuilt exactly.
+    //
+    // Returns the index of the node for the final component, or c_noNode for an empty path.
+    //----------------------------------------------------------------------------------------------
+
+    if (path.empty())
+        return c_noNode;
+
+    uint32_t parent = c_noNode;
+    size_t   start  = 0;
+
+    while (true) {
+        auto end  = path.find ('/', start);
+        auto name = path.substr (start, (end == string::npos) ? string::npos : end - start);
+
+        string key (reinterpret_cast<const char*>(&parent), sizeof(parent));
+        key += name;
+
+        auto child = m_children.find (key);
+
+        if (child != m_children.end()) {
+            parent = child->second;
+        } else {
+            auto node = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.push_back ({parent, AddString(name)});
+            m_children.emplace (std::move(key), node);
+            parent = node;
+        }
+
+        if (end == string::npos)
+            return parent;
+
+        start = end + 1;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+uint32_t JDPathTrieBuilder::AddString (const string& str) {
+
+    // Returns the string pool offset of the given string, adding it to the pool if needed. The
+    // empty string is always at offset zero. A string that would straddle a page boundary instead
+    // starts on the next page, and the rest of the current page is filled with null characters.
+    //----------------------------------------------------------------------------------------------
+
+    if (str.empty())
+        return 0;
+
+    auto pooled = m_strings.find (str);
+
+    if (pooled != m_strings.end())
+        return pooled->second;
+
+    auto pageRoom = c_jdPageSize - (m_pool.size() % c_jdPageSize);
+
+    if ((str.size() + 1 > pageRoom) && (str.size() + 1 <= c_jdPageSize))
+        m_pool.append (pageRoom, '\0');
+
+    auto offset = static_cast<uint32_t>(m_pool.size());
+
+    m_pool.append (str);
+    m_pool.push_back ('\0');
+    m_strings.emplace (str, offset);
+
+    return offset;
+}
+
+
+
+//======================================================================================================================
+// Frecency
+//
+// Each history entry carries a visit count and a frecency score that combines how often and how recently the entry
+// has been visited. Every visit adds one point to the score, and the score halves every c_frecencyHalfLife seconds.
+// The score is stored as of the entry's last visit, and decayed to the present only when it is read, so no pass over
+// the history is ever needed to age it. Recording a visit decays the entry's score to the visit time and adds one.
+//======================================================================================================================
+
+static const double c_frecencyHalfLife     = 14 * 24 * 60 * 60.0; // Seconds for a score to decay by half
+static const double c_sparseFrecencyWeight = 16.0;                 // Sparse match rank per doubling of frecency
+
+
+//--------------------------------------------------------------------------------------------------
+static double DecayedScore (double score, int64_t scoreTime, int64_t now) {
+
+    // Returns the given score (as of 'scoreTime') decayed to time 'now'.
+    //----------------------------------------------------------------------------------------------
+
+    if (now <= scoreTime)
+        return score;
+
+    return score * exp2 (-static_cast<double>(now - scoreTime) / c_frecencyHalfLife);
+}
+
+
+
+//======================================================================================================================
+// Visit Journal
+//
+// Visits are not written to the data file directly. Instead, each visit appends a single fixed-size JDJournalRecord
+// to the journal file (the data file name plus ".jnl"). Appends are a single write to a file opened for append
+// access, so any number of shells may record visits at the same time. Readers skip over any record left partial by an
+// interrupted append, and the next append realigns the journal to a record boundary.
+//
+// Once the journal grows past c_journalCompactSize bytes, a detached "jumpdir --compact" process folds the journal
+// into a new data file snapshot. The compactor first renames the journal to ".jnl.old", so that new visits go to a
+// fresh journal while the old one is folded. Readers replay the snapshot, then ".jnl.old" (if present), then ".jnl".
+// Appenders open the journal without delete sharing, so the rename cannot happen while a record is being appended
+// (the record would otherwise land in ".jnl.old" after the compactor had read it); the compactor retries instead.
+// Each record carries the path's visit count and frecency score as updated by that visit, so folding is idempotent
+// (the most recent visit for a path always wins), and an interrupted compaction is simply repeated by the next one.
+//======================================================================================================================
+
+static const uint32_t c_jdJournalMagic    = 0x324E4A4A;         // 'JJN2', little-endian
+static const size_t   c_journalCompactSize = 256 * 1024;        // Journal size that triggers compaction
+static const int      c_maxRotateAttempts  = 100;               // Journal rename attempts before giving up
+static const DWORD    c_rotateRetryMs      = 10;                // Wait between journal rename attempts
+
+struct JDJournalRecord {
+    uint32_t magic;                    // Record Signature (c_jdJournalMagic)
+    DWORD    serialnum;                // Volume Serial Number
+    int64_t  time;                     // Visit Time (time_t)
+    uint32_t visitCount;               // Visit Count, including this visit
+    float    score;                    // Frecency Score as of this visit
+    char     path [MAX_PATH + 4];      // Visited Path (active code page, null-terminated)
+};
+
+static_assert ((sizeof(JDJournalRecord) & 0x7) == 0, "JDJournalRecord is part of the journal file layout.");
+
+
+//--------------------------------------------------------------------------------------------------
+static bool AppendJournalRecord (const string& journalName, const JDJournalRecord& record,
+                                 uint64_t* journalSize) {
+
+    // Appends a single record to the end of the named journal file, creating the journal if
+    // needed. The file is opened for append access only, so the write lands at the end of the file
+    // even when other processes are appending at the same time. It is not opened for delete
+    // sharing, so the compactor cannot rotate the journal out from under the write.
+    //
+    // If the journal does not end on a record boundary (a torn write left a partial record), the
+    // record is preceded by enough zero bytes to realign it, in the same write. Readers skip the
+    // padding and the partial record (see ReadJournal).
+    //
+    // On success, 'journalSize' receives the resulting size of the journal.
+    //----------------------------------------------------------------------------------------------
+
+    auto journal = CreateFileA (journalName.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (journal == INVALID_HANDLE_VALUE) {
+        ErrorPrint ("Couldn't open journal file \"%s\".", journalName.c_str());
+        return false;
+    }
+
+    char          buffer [2 * sizeof(JDJournalRecord)] = {};
+    DWORD         padding = 0;
+    LARGE_INTEGER size;
+
+    if (GetFileSizeEx (journal, &size) && (size.QuadPart % sizeof(JDJournalRecord)))
+        padding = static_cast<DWORD>(sizeof(JDJournalRecord) - size.QuadPart % sizeof(JDJournalRecord));
+
+    memcpy (buffer + padding, &record, sizeof(record));
+
+    DWORD nWritten = 0;
+    bool  written  = WriteFile (journal, buffer, padding + sizeof(record), &nWritten, NULL)
+                  && (nWritten == padding + sizeof(record));
+
+    if (written && GetFileSizeEx (journal, &size))
+        *journalSize = static_cast<uint64_t>(size.QuadPart);
+
+    CloseHandle (journal);
+
+    if (!written)
+        ErrorPrint ("Couldn't write to journal file \"%s\".", journalName.c_str());
+
+    return written;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+static bool ReadJournal (const string& journalName, vector<JDJournalRecord>& records) {
+
+    // Reads all complete, well-formed records from the named journal file and appends them to
+    // 'records'. A missing journal is the same as an empty one. The journal is opened with full
+    // read/write sharing, so appenders are never locked out while it is read.
+    //
+    // A writer that was interrupted can leave a partial record anywhere in the journal, followed
+    // by the realigning padding of the next append (see AppendJournalRecord), so records are not
+    // assumed to lie on multiples of the record size. Wherever a well-formed record does not begin,
+    // the reader scans forward a byte at a time to the next record signature, skipping partial
+    // records, padding and damaged bytes alike.
+    //
+    // Returns false only if an existing journal could not be read.
+    //----------------------------------------------------------------------------------------------
+
+    if (0 != _access(journalName.c_str(), 0))
+        return true;
+
+    auto journal = _fsopen (journalName.c_str(), "rb", _SH_DENYNO);
+
+    if (!journal) {
+        ErrorPrint ("Couldn't open journal file \"%s\".", journalName.c_str());
+        return false;
+    }
+
+    vector<char> contents;
+    char         block [64 * 1024];
+    size_t       nRead;
+
+    while (0 < (nRead = fread (block, 1, sizeof(block), journal)))
+        contents.insert (contents.end(), block, block + nRead);
+
+    auto readError = ferror (journal);
+
+    fclose (journal);
+
+    if (readError) {
+        ErrorPrint ("Couldn't read journal file \"%s\".", journalName.c_str());
+        return false;
+    }
+
+    JDJournalRecord record;
+    size_t          offset = 0;
+
+    while (offset + sizeof(record) <= contents.size()) {
+        memcpy (&record, contents.data() + offset, sizeof(record));
+
+        if ((record.magic == c_jdJournalMagic) && memchr(record.path, 0, sizeof(record.path))) {
+            records.push_back (record);
+            offset += sizeof(record);
+            continue;
+        }
+
+        // Not a record here: resynchronize at the next record signature.
+
+        do {
+            ++offset;
+        } while (  (offset + sizeof(record) <= contents.size())
+                && memcmp (contents.data() + offset, &c_jdJournalMagic, sizeof(c_jdJournalMagic)));
+    }
+
+    return true;
+}
+
+
+
+//======================================================================================================================
+// Class JumpData
+//======================================================================================================================
+
+struct JDHistoryItem {
+    const char* path;                  // Directory Path
+    int64_t     lastVisit;             // Time of Most Recent Visit (time_t)
+    DWORD       serialnum;             // Volume Serial Number
+    uint32_t    visitCount;            // Number of Visits
+    double      score;                 // Frecency Score as of lastVisit
+
+    double Frecency (int64_t now) const { return DecayedScore (score, lastVisit, now); }
+};
+
+struct JDVisit {
+    string   path;                     // Directory Path
+    int64_t  time;                     // Visit Time (time_t)
+    DWORD    serialnum;                // Volume Serial Number
+    uint32_t visitCount;               // Number of Visits
+    double   score;                    // Frecency Score as of time
+};
+
+// The callback function signature that JumpData::VisitHistory uses to report history entries. Return false to stop
+// the walk.
+typedef bool (JDHistoryCallback) (const JDHistoryItem& item, void* userData);
+
+// The callback function signature that JumpData::BestMatch uses to test history entries. Return true if the entry
+// matches.
+typedef bool (JDMatchCallback) (const JDHistoryItem& item, void* userData);
+
+
+class JDMatchSelector {
+    //--------------------------------------------------------------------------
+    // Picks the best of a set of matching history items: the one with the highest frecency (see Frecency), or of
+    // those with equal frecency, the most recent. Items may also be given a distance (see BestNearestMatch), in
+    // which case the nearest wins, and frecency and recency only break ties.
+    //--------------------------------------------------------------------------
+
+  public:
+    JDMatchSelector () : m_now{static_cast<int64_t>(time(nullptr))}, m_bestDistance{0}, m_bestFrecency{0},
+                         m_bestTime{0}, m_found{false} {}
+
+    void Consider (const JDHistoryItem& item, uint32_t distance = 0);
+
+    bool          Found    () const { return m_found; }
+    const string& Path     () const { return m_bestPath; }
+    uint32_t      Distance () const { return m_bestDistance; }
+
+  private:
+    int64_t  m_now;                    // Time that frecencies are computed for
+    uint32_t m_bestDistance;           // Distance of the best item so far
+    double   m_bestFrecency;           // Frecency of the best item so far
+    int64_t  m_bestTime;               // Last visit time of the best item so far
+    string   m_bestPath;               // Path of the best item so far
+    bool     m_found;                  // True => at least one item was considered
+};
+
+
+//--------------------------------------------------------------------------------------------------
+void JDMatchSelector::Consider (const JDHistoryItem& item, uint32_t distance) {
+
+    // Takes the given item as the best so far if it beats the current best.
+    //----------------------------------------------------------------------------------------------
+
+    auto frecency = item.Frecency (m_now);
+
+    if (  m_found
+       && (  (distance > m_bestDistance)
+          || (  (distance == m_bestDistance)
+             && ((frecency < m_bestFrecency) || ((frecency == m_bestFrecency) && (item.lastVisit <= m_bestTime))))))
+    {
+        return;
+    }
+
+    m_bestDistance = distance;
+    m_bestFrecency = frecency;
+    m_bestTime     = item.lastVisit;
+    m_bestPath     = item.path;
+    m_found        = true;
+}
+
+
+
+static const size_t c_searchBatchSize = 16384;   // History entries matched between search budget checks
+
+class JumpData {
+  public:
+
+    JumpData() : m_header{&m_defaultHeader}, m_pathNodes{nullptr}, m_hashSlots{nullptr}, m_pageChecksums{nullptr},
+                 m_entryPageFirst{nullptr}, m_volumes{nullptr}, m_generation{0}, m_budget{nullptr},
+                 m_hasPending{false}, m_needsCompaction{false} {};
+
+    bool Load    (const string& filename, bool liveJournal = true);
+    bool Store   (const string& filename);
+    bool Compact (const string& filename, const char* purgePattern = nullptr);
+
+    bool ExportJson (const string& jsonName) const;
+    bool ImportJson (const string& filename, const string& jsonName);
+
+    void RecordVisit (const char* path, DWORD serialnum);
+    bool FindVisit (const char* path, JDVisit& visit) const;
+    uint32_t FindEntry (const string& key) const;
+    void TailMatchEntries (const char* tail, vector<uint32_t>& entries) const;
+    void TailMatchNodes (const char* tail, vector<uint32_t>& nodes) const;
+    void PartialPathCandidates (const char* dest, vector<string>& candidates) const;
+    bool WildcardCandidates (const char* pattern, vector<uint32_t>& entries) const;
+    bool ReadPostings (uint32_t trigram, vector<uint32_t>& postings) const;
+    void SelectEntries (const vector<uint32_t>& entries, JDMatchCallback* match, void* userData,
+                        JDMatchSelector& selector) const;
+    void CollectEntries (const vector<uint32_t>& entries, vector<JDVisit>& visits) const;
+    void MatchHistory (const char* pattern, vector<JDVisit>& matches) const;
+    uint32_t TailIndexNode (uint32_t position) const;
+    uint32_t NodeEntry (uint32_t node) const;
+    uint32_t PrefixIndexEntry (uint32_t position) const;
+    uint32_t PrefixLowerBound (const string& key) const;
+    bool NeedsCompaction () const { return m_needsCompaction; }
+
+    // Sets the budget that history searches charge their matches to, and stop at once it is spent.
+    // A null budget (the default) leaves searches unlimited.
+    void SetSearchBudget (SearchBudget* budget) { m_budget = budget; }
+
+    void VisitHistory (JDHistoryCallback* callback, void* userData) const;
+    void CopyHistory (vector<JDVisit>& visits) const;
+    bool BestMatch (JDMatchCallback* match, void* userData, string& bestPath) const;
+    bool BestNearestMatch (const char* origin, JDMatchCallback* match, void* userData, string& bestPath) const;
+    bool BestTailMatch (const char* tail, JDMatchCallback* match, void* userData, string& bestPath,
+                        const char* nearTo = nullptr) const;
+    bool BestWildcardMatch (const char* pattern, JDMatchCallback* match, void* userData, string& bestPath,
+                            const char* nearTo = nullptr) const;
+    bool BestSparseMatch (const char* pattern, JDMatchCallback* match, void* userData, string& bestPath,
+                          const char* nearTo = nullptr) const;
+
+    const JDFileHeader& Header () const { return *m_header; }
+
+    unsigned int    NumEntries () const { return m_header->numHistEntries; }
+    const DirEntry* Entry (uint32_t index) const;
+    const DirEntry* First () const { return Entry (m_header->headEntry); }
+    const DirEntry* Next (const DirEntry& entry) const { return Entry (entry.m_next); }
+
+    size_t BuildPath (uint32_t node, char* buffer, size_t bufferSize) const;
+
+    unsigned int      NumPathNodes () const { return m_header->numPathNodes; }
+    const JDPathNode* PathNode (uint32_t index) const;
+    const char*       NodeName (const JDPathNode& node) const;
+
+  private:
+    enum class PinResult { Pinned, Superseded, Damaged };
+
+    PinResult PinSnapshot (const string& filename, int64_t generation);
+    bool HasDamagedPages () const;
+    void RecoverDamagedEntries (const string& filename, vector<JDVisit>& visits) const;
+    bool MapSnapshot (const string& filename);
+    bool AttachImage (const void* image, size_t size);
+    bool CheckPage (uint64_t offset, bool isPoolPage = false) const;
+    const vector<DirEntry>& DecodeEntryPage (uint32_t entryPage) const;
+    void DetachImage ();
+    void Unload ();
+    void ReplayJournal (const vector<JDJournalRecord>& records);
+    bool PublishSnapshot (const string& filename, const vector<JDVisit>& visits) const;
+    bool WriteSnapshot (const string& snapshotName, int64_t generation, const vector<JDVisit>& visits) const;
+
+    static string SnapshotName (const string& filename, int64_t generation);
+    static bool   OpenControlBlock (const string& filename, JDMappedFile& controlFile);
+    static HANDLE LockDataFile (const string& filename);
+
+    static string PathKey (const char* path);
+    static void   MatchVisits (const char* pattern, const vector<JDVisit>& visits, vector<size_t>& matches,
+                               SearchBudget* budget = nullptr);
+    static void   WidenVisitPaths (const vector<JDVisit>& visits, size_t first, size_t count,
+                                   vector<std::wstring>& widePaths, vector<const wchar_t*>& pathPointers);
+
+    bool SearchSpent () const { return m_budget && m_budget->Spent(); }
+    bool ChargeMatch () const { return !m_budget || m_budget->AddMatch(); }
+
+    JDFileHeader        m_defaultHeader;   // Header used when there is no data file
+    const JDFileHeader *m_header;          // Active Header (mapped or default)
+    const JDPathNode   *m_pathNodes;       // Path Trie Node Table
+    JDMemPool           m_strpool;         // String Pool
+    const JDHashSlot   *m_hashSlots;       // Path Index
+
+    JDMappedFile        m_dataFile;        // Mapped Data File Contents
+    int64_t             m_generation;      // Generation of the mapped snapshot (0 if none)
+    const uint32_t     *m_pageChecksums;   // Page Directory (CRC-32 of each page from firstDataPage on)
+    const uint32_t     *m_entryPageFirst;  // Index of the first entry on each entry page
+    const JDVolume     *m_volumes;         // Volume Table
+
+    enum PageState : uint8_t { PageUnchecked, PageGood, PageBad };
+
+    mutable vector<PageState>        m_pageStates;      // Check result of each page, filled in as pages are used
+    mutable vector<vector<DirEntry>> m_entryPages;      // Decoded entries of each entry page, filled in as used
+    mutable vector<bool>             m_entryPageDone;   // True => entry page has been decoded
+
+    vector<JDVisit>               m_recent;       // Journaled visits not yet in the snapshot, most recent first
+    unordered_map<string, size_t> m_recentKeys;   // Path key of each m_recent visit to its index
+
+    SearchBudget* m_budget;                // Search Budget of history searches (null if unlimited)
+
+    JDVisit m_pending;                     // Visit to be recorded by Store()
+    bool    m_hasPending;                  // True => m_pending holds a visit
+    bool    m_needsCompaction;             // True => journal has grown past the compaction threshold
+};
+
+
+//--------------------------------------------------------------------------------------------------
+string JumpData::PathKey (const char* path) {
+
+    // Returns the key used to identify a path in the history. Paths compare without regard to case
+    // or slash direction.
+    //----------------------------------------------------------------------------------------------
+
+    string key {path};
+
+    for (auto& c : key)
+        c = (c == '\\') ? '/' : static_cast<char>(tolower(static_cast<unsigned char>(c)));
+
+    return key;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+const DirEntry* JumpData::Entry (uint32_t index) const {
+
+    // Returns the directory entry at the given index, or null if the index is out of range (which
+    // includes c_noEntry) or the entry lies on a damaged page.
+    //----------------------------------------------------------------------------------------------
+
+    if (index >= m_header->numHistEntries)
+        return nullptr;
+
+    // Find the last entry page that starts at or before this entry.
+
+    auto pagesEnd  = m_entryPageFirst + m_header->numEntryPages;
+    auto entryPage = std::upper_bound (m_entryPageFirst, pagesEnd, index) - m_entryPageFirst - 1;
+
+    if (entryPage < 0)
+        return nullptr;
+
+    auto& entries = DecodeEntryPage (static_cast<uint32_t>(entryPage));
+    auto  slot    = index - m_entryPageFirst[entryPage];
+
+    if (slot >= entries.size())
+        return nullptr;
+
+    return &entries[slot];
+}
+
+
+//--------------------------------------------------------------------------------------------------
+const vector<DirEntry>& JumpData::DecodeEntryPage (uint32_t entryPage) const {
+
+    // Returns the decoded entries of the given entry page, decoding the page the first time it is
+    // asked for (see Entry Encoding). A damaged page decodes to no entries.
+    //----------------------------------------------------------------------------------------------
+
+    auto& entries = m_entryPages[entryPage];
+
+    if (m_entryPageDone[entryPage])
+        return entries;
+
+    m_entryPageDone[entryPage] = true;
+
+    auto offset = m_header->entryTableOffset + uint64_t{entryPage} * c_jdPageSize;
+
+    if (!CheckPage (offset))
+        return entries;
+
+    auto page       = static_cast<const uint8_t*>(m_dataFile.Data()) + offset;
+    auto pageEnd    = page + c_jdPageSize;
+    auto pageHeader = reinterpret_cast<const JDEntryPageHeader*>(page);
+
+    if (  (pageHeader->firstEntry != m_entryPageFirst[entryPage])
+       || (pageHeader->numEntries > (c_jdPageSize - sizeof(JDEntryPageHeader))))
+    {
+        DPrint ("Entry page %u is damaged; skipping its entries.", entryPage);
+        return entries;
+    }
+
+    auto     in   = page + sizeof(JDEntryPageHeader);
+    int64_t  time = pageHeader->baseTime;
+    int64_t  node = 0;
+
+    entries.reserve (pageHeader->numEntries);
+
+    for (uint32_t i=0;  i < pageHeader->numEntries;  ++i) {
+        uint64_t timeDelta, volume, nodeDelta, visitCount, score;
+
+        if (  !GetVarint (in, pageEnd, timeDelta)
+           || !GetVarint (in, pageEnd, volume)
+           || !GetVarint (in, pageEnd, nodeDelta)
+           || !GetVarint (in, pageEnd, visitCount)
+           || !GetVarint (in, pageEnd, score)
+           || (volume >= m_header->numVolumes))
+        {
+            DPrint ("Entry page %u is damaged; skipping its entries.", entryPage);
+            entries.clear();
+            return entries;
+        }
+
+        time += UnZigZag (timeDelta);
+        node += UnZigZag (nodeDelta);
+
+        auto index = pageHeader->firstEntry + i;
+
+        DirEntry entry;
+
+        entry.m_dvol_name    = m_volumes[volume].m_name;
+        entry.m_dvol_label   = m_volumes[volume].m_label;
+        entry.m_dpath        = static_cast<uint32_t>(node);
+        entry.m_serialnum    = m_volumes[volume].m_serialnum;
+        entry.m_lastverified = time;
+        entry.m_next         = (index + 1 < m_header->numHistEntries) ? index + 1 : c_noEntry;
+        entry.m_valid        = 1;
+        entry.m_visitCount   = static_cast<uint32_t>(visitCount);
+        entry.m_score        = static_cast<float>(score / c_scoreScale);
+
+        entries.push_back (entry);
+    }
+
+    return entries;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+const JDPathNode* JumpData::PathNode (uint32_t index) const {
+
+    // Returns the path trie node at the given index, or null if the index is out of range (which
+    // includes c_noNode) or the node lies on a damaged page.
+    //----------------------------------------------------------------------------------------------
+
+    if (index >= m_header->numPathNodes)
+        return nullptr;
+
+    if (!CheckPage (m_header->nodeTableOffset + uint64_t{index} * sizeof(JDPathNode)))
+        return nullptr;
+
+    return m_pathNodes + index;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+const char* JumpData::NodeName (const JDPathNode& node) const {
+
+    // Returns the component name of the given trie node, or null if the name lies on a damaged
+    // page.
+    //----------------------------------------------------------------------------------------------
+
+    if ((node.m_name < m_header->stringPoolSize)
+        && !CheckPage (m_header->stringPoolOffset + uint64_t{node.m_name}, true))
+    {
+        return nullptr;
+    }
+
+    return m_strpool.String (node.m_name);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+size_t JumpData::BuildPath (uint32_t node, char* buffer, size_t bufferSize) const {
+
+    // Reconstructs the full path for the given trie node into the buffer, by walking parent links
+    // up to the root and then writing the component names back down, separated by slashes.
+    //
+    // Returns the length of the path, or zero (with an empty buffer) if the path does not fit or
+    // the node chain is damaged.
+    //----------------------------------------------------------------------------------------------
+
+    const char* components [MAX_PATH];    // Component names, leaf first
+    size_t      depth  = 0;
+    size_t      length = 0;
+    uint32_t    index  = node;
+
+    for (auto pathNode = PathNode(index);  pathNode;  pathNode = PathNode(index)) {
+        auto name = NodeName (*pathNode);
+
+        if (!name || (depth == std::size(components))) {     // Damaged, or deeper than any valid path
+            depth = 0;
+            break;
+        }
+
+        components[depth++] = name;
+        index = pathNode->m_parent;
+    }
+
+    // A chain that ends anywhere but the root ran into a damaged page.
+
+    if (index != c_noNode)
+        depth = 0;
+
+    for (auto i = depth;  i-- > 0;  ) {
+        auto componentLength = strlen (components[i]);
+        auto separator       = (i + 1 < depth) ? 1 : 0;
+
+        if (length + separator + componentLength + 1 > bufferSize) {
+            length = 0;
+            break;
+        }
+
+        if (separator)
+            buffer[length++] = '/';
+
+        memcpy (buffer + length, components[i], componentLength);
+        length += componentLength;
+    }
+
+    if (bufferSize > 0)
+        buffer[length] = 0;
+
+    return length;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::Load (const string& filename, bool liveJournal) {
+
+    // Loads the current snapshot and replays the journals over it. If 'liveJournal' is false, only
+    // the journal set aside for compaction is replayed, and not the one that visits are going to.
+    //----------------------------------------------------------------------------------------------
+
+    DPrint ("Reading jumpdata from \"%s\".", filename.c_str());
+
+    Unload();
+
+    // If the data file does not exist, then silently assume that we're starting
+    // from scratch (though there may already be journaled visits).
+
+    JDMappedFile          controlFile;
+    const JDControlBlock* control = nullptr;
+
+    if (0 == _access(filename.c_str(), 0)) {
+        if (controlFile.Open (filename) && (controlFile.Size() >= sizeof(JDControlBlock)))
+            control = static_cast<const JDControlBlock*>(controlFile.Data());
+
+        if (control && ((control->magic != c_jdControlMagic) || (control->version != c_jdFormatVersion))) {
+            DPrint ("Data file \"%s\" is of an unknown format; ignoring it.", filename.c_str());
+            control = nullptr;
+        }
+    }
+
+    // Pin the current snapshot and read the journals. If a writer rotates the journal while we
+    // are reading it, some visits could be missed, so start over (see Snapshots and Generations).
+    // On the last attempt, settle for whatever is read.
+
+    for (int attempt=1;  attempt <= c_maxLoadAttempts;  ++attempt) {
+        auto lastAttempt = (attempt == c_maxLoadAttempts);
+
+        Unload();
+
+        int64_t journalSeq = control ? ReadShared (&control->journalSeq) : 0;
+        int64_t generation = control ? ReadShared (&control->generation) : 0;
+
+        if ((journalSeq & 1) && !lastAttempt) {
+            SwitchToThread();
+            continue;
+        }
+
+        if (generation > 0) {
+            auto pinned = PinSnapshot (filename, generation);
+
+            if (pinned == PinResult::Superseded && !lastAttempt)
+                continue;
+
+            if (pinned == PinResult::Damaged) {
+                ErrorPrint ("Data file \"%s\" is damaged.", SnapshotName(filename, generation).c_str());
+                return false;
+            }
+        }
+
+        // Pick up any visits that have been journaled but not yet folded into the snapshot.
+
+        vector<JDJournalRecord> records;
+
+        if (!ReadJournal (filename + ".jnl.old", records)
+            || (liveJournal && !ReadJournal (filename + ".jnl", records)))
+            return false;
+
+        ReplayJournal (records);
+
+        if (!control || lastAttempt || (ReadShared (&control->journalSeq) == journalSeq))
+            return true;
+
+        DPrint ("Journal rotated during load; retrying.");
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+string JumpData::SnapshotName (const string& filename, int64_t generation) {
+
+    // Returns the file name of the snapshot with the given generation number.
+    //----------------------------------------------------------------------------------------------
+
+    return filename + "." + std::to_string (generation);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+JumpData::PinResult JumpData::PinSnapshot (const string& filename, int64_t generation) {
+
+    // Maps the snapshot of the given generation. If that snapshot no longer exists, it has been
+    // superseded and deleted since the generation number was read. If it is damaged, then the
+    // previous generation is used instead.
+    //----------------------------------------------------------------------------------------------
+
+    auto snapshotName = SnapshotName (filename, generation);
+
+    if (MapSnapshot (snapshotName)) {
+        m_generation = generation;
+        return PinResult::Pinned;
+    }
+
+    if (0 != _access(snapshotName.c_str(), 0))
+        return PinResult::Superseded;
+
+    if ((generation > 1) && MapSnapshot (SnapshotName (filename, generation - 1))) {
+        DPrint ("Using previous snapshot generation %lld.", static_cast<long long>(generation - 1));
+        m_generation = generation - 1;
+        return PinResult::Pinned;
+    }
+
+    return PinResult::Damaged;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::HasDamagedPages () const {
+
+    // Returns true if any page checked so far failed its check (see CheckPage).
+    //----------------------------------------------------------------------------------------------
+
+    return std::find (m_pageStates.begin(), m_pageStates.end(), PageBad) != m_pageStates.end();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::RecoverDamagedEntries (const string& filename, vector<JDVisit>& visits) const {
+
+    // Adds to 'visits' (a copy of the history, which has lost the entries on damaged pages) every
+    // entry of the previous snapshot generation whose path it lacks, and then puts the visits back
+    // in order, most recent first. The recovered entries are as of the previous compaction. The
+    // previous generation can't tell an entry lost to damage from one purged since, so an entry
+    // purged by the last compaction may be recovered along with the rest.
+    //----------------------------------------------------------------------------------------------
+
+    JumpData previous;
+
+    if ((m_generation < 2) || !previous.MapSnapshot (SnapshotName (filename, m_generation - 1))) {
+        ErrorPrint ("Data file \"%s\" is damaged, and its damaged entries can't be recovered.",
+                    SnapshotName(filename, m_generation).c_str());
+        return;
+    }
+
+    unordered_set<string> present;
+
+    for (auto& visit : visits)
+        present.insert (PathKey (visit.path.c_str()));
+
+    vector<JDVisit> older;
+    previous.CopyHistory (older);
+
+    size_t recovered = 0;
+
+    for (auto& visit : older) {
+        if (present.insert (PathKey (visit.path.c_str())).second) {
+            visits.push_back (std::move (visit));
+            ++recovered;
+        }
+    }
+
+    std::stable_sort (visits.begin(), visits.end(), [](const JDVisit& a, const JDVisit& b) {
+        return a.time > b.time;
+    });
+
+    ErrorPrint ("Data file \"%s\" is damaged; recovered %zu history entries from generation %lld.",
+                SnapshotName(filename, m_generation).c_str(), recovered,
+                static_cast<long long>(m_generation - 1));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::OpenControlBlock (const string& filename, JDMappedFile& controlFile) {
+
+    // Maps the control block for writing, first creating (or, if it isn't a valid control block,
+    // re-creating) the data file as needed. Must be called with the data file lock held.
+    //----------------------------------------------------------------------------------------------
+
+    JDControlBlock block {};
+    FILE*          datafile;
+
+    if (0 == fopen_s (&datafile, filename.c_str(), "rb")) {
+        if (1 != fread (&block, sizeof(block), 1, datafile))
+            block.magic = 0;
+        fclose (datafile);
+    }
+
+    if ((block.magic != c_jdControlMagic) || (block.version != c_jdFormatVersion)) {
+        block            = {};
+        block.magic      = c_jdControlMagic;
+        block.version    = c_jdFormatVersion;
+
+        bool written = (0 == fopen_s (&datafile, filename.c_str(), "wb"));
+
+        if (written) {
+            written = (1 == fwrite (&block, sizeof(block), 1, datafile));
+            if (0 != fclose (datafile))
+                written = false;
+        }
+
+        if (!written) {
+            ErrorPrint ("Couldn't create data file \"%s\".", filename.c_str());
+            return false;
+        }
+    }
+
+    if (!controlFile.Open (filename, true) || (controlFile.Size() < sizeof(JDControlBlock))) {
+        ErrorPrint ("Couldn't open data file \"%s\".", filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::MapSnapshot (const string& filename) {
+
+    // Maps the named snapshot into memory. The header, entry table and string pool are then used
+    // directly from the mapped image. An empty file is treated as an empty history.
+    //
+    // Returns false if the file could not be mapped, or if it fails validation.
+    //----------------------------------------------------------------------------------------------
+
+    if (!m_dataFile.Open (filename)) {
+        DPrint ("Couldn't open data file \"%s\".", filename.c_str());
+        return false;
+    }
+
+    if (m_dataFile.Size() == 0)
+        return true;
+
+    if (!AttachImage (m_dataFile.Data(), m_dataFile.Size())) {
+        DPrint ("Data file \"%s\" failed validation.", filename.c_str());
+        DetachImage();
+        return false;
+    }
+
+    DPrint ("Mapped %u history entries (%zu bytes).", m_header->numHistEntries, m_dataFile.Size());
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::Unload () {
+
+    // Releases the mapped data file and any replayed journal visits, returning to an empty history
+    // with default settings.
+    //----------------------------------------------------------------------------------------------
+
+    DetachImage();
+
+    m_recent.clear();
+    m_recentKeys.clear();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::DetachImage () {
+
+    // Releases the mapped data file, and everything decoded from it.
+    //----------------------------------------------------------------------------------------------
+
+    m_header         = &m_defaultHeader;
+    m_pathNodes      = nullptr;
+    m_hashSlots      = nullptr;
+    m_pageChecksums  = nullptr;
+    m_entryPageFirst = nullptr;
+    m_volumes        = nullptr;
+    m_strpool.Attach (nullptr, 0);
+    m_pageStates.clear();
+    m_entryPages.clear();
+    m_entryPageDone.clear();
+    m_dataFile.Close();
+    m_generation = 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::AttachImage (const void* image, size_t size) {
+
+    // Points the header, entry table, node table and string pool at the given data file image.
+    // Only the header and page directory are inspected here; every other page is checked when it
+    // is first used (see Paged Loading).
+    //
+    // Returns false (and leaves the default header in place) if the image is not a valid data file.
+    //----------------------------------------------------------------------------------------------
+
+    auto bytes  = static_cast<const char*>(image);
+    auto header = static_cast<const JDFileHeader*>(image);
+
+    if (size < sizeof(JDFileHeader))
+        return false;
+
+    if (  (header->magic != c_jdMagic)
+       || (header->version != c_jdFormatVersion)
+       || (header->headerSize != sizeof(JDFileHeader))
+       || (header->pageSize != c_jdPageSize)
+       || (uint64_t{header->numPages} * c_jdPageSize != size))
+    {
+        return false;
+    }
+
+    // The page directory must fit in the directory pages, and the three tables must start on page
+    // boundaries past the directory, in order, within the image.
+
+    uint64_t numDataPages    = header->numPages - uint64_t{header->firstDataPage};
+    uint64_t dataStart       = uint64_t{header->firstDataPage} * c_jdPageSize;
+    uint64_t directorySize   = (numDataPages + header->numEntryPages) * sizeof(uint32_t)
+                             + uint64_t{header->numVolumes} * sizeof(JDVolume);
+    uint64_t entryTableEnd   = uint64_t{header->entryTableOffset}
+                             + uint64_t{header->numEntryPages} * c_jdPageSize;
+    uint64_t nodeTableEnd    = uint64_t{header->nodeTableOffset}
+                             + uint64_t{header->numPathNodes} * sizeof(JDPathNode);
+    uint64_t stringPoolEnd   = uint64_t{header->stringPoolOffset} + header->stringPoolSize;
+    uint64_t hashTableEnd    = uint64_t{header->hashTableOffset}
+                             + uint64_t{header->numHashSlots} * sizeof(JDHashSlot);
+    uint64_t tailIndexEnd    = uint64_t{header->tailIndexOffset}
+                             + uint64_t{header->numPathNodes} * sizeof(uint32_t);
+    uint64_t nodeEntryEnd    = uint64_t{header->nodeEntryOffset}
+                             + uint64_t{header->numPathNodes} * sizeof(uint32_t);
+    uint64_t trigramEnd      = uint64_t{header->trigramOffset}
+                             + (uint64_t{header->numTrigrams} + 1) * sizeof(JDTrigram);
+    uint64_t postingsEnd     = uint64_t{header->postingsOffset}
+                             + uint64_t{header->numPostings} * sizeof(uint32_t);
+    uint64_t prefixEnd       = uint64_t{header->prefixOffset}
+                             + uint64_t{header->numHistEntries} * sizeof(uint32_t);
+
+    if (  (header->firstDataPage > header->numPages)
+       || (sizeof(JDFileHeader) + directorySize > dataStart)
+       || ((header->numEntryPages == 0) != (header->numHistEntries == 0))
+       || (  (header->entryTableOffset | header->nodeTableOffset | header->stringPoolOffset
+             | header->hashTableOffset | header->tailIndexOffset | header->nodeEntryOffset
+             | header->trigramOffset | header->postingsOffset | header->prefixOffset) % c_jdPageSize)
+       || (header->entryTableOffset < dataStart)
+       || (entryTableEnd > header->nodeTableOffset)
+       || (nodeTableEnd  > header->stringPoolOffset)
+       || (stringPoolEnd > header->hashTableOffset)
+       || (hashTableEnd  > header->tailIndexOffset)
+       || (tailIndexEnd  > header->nodeEntryOffset)
+       || (nodeEntryEnd  > header->trigramOffset)
+       || (trigramEnd    > header->postingsOffset)
+       || (postingsEnd   > header->prefixOffset)
+       || (prefixEnd     > size)
+       || (header->numHashSlots & (header->numHashSlots - 1))
+       || (header->stringPoolSize == 0))
+    {
+        return false;
+    }
+
+    auto pageChecksums  = reinterpret_cast<const uint32_t*>(bytes + sizeof(JDFileHeader));
+    auto entryPageFirst = pageChecksums + numDataPages;
+    auto volumes        = reinterpret_cast<const JDVolume*>(entryPageFirst + header->numEntryPages);
+
+    if (header->checksum != header->Checksum (pageChecksums, static_cast<size_t>(directorySize)))
+        return false;
+
+    // Entry page start indices must begin at zero, and increase.
+
+    for (uint32_t i=0;  i < header->numEntryPages;  ++i) {
+        if (  (i == 0) ? (entryPageFirst[0] != 0)
+                       : ((entryPageFirst[i] <= entryPageFirst[i-1]) || (entryPageFirst[i] >= header->numHistEntries)))
+        {
+            return false;
+        }
+    }
+
+    m_header         = header;
+    m_pathNodes      = reinterpret_cast<const JDPathNode*>(bytes + header->nodeTableOffset);
+    m_hashSlots      = reinterpret_cast<const JDHashSlot*>(bytes + header->hashTableOffset);
+    m_pageChecksums  = pageChecksums;
+    m_entryPageFirst = entryPageFirst;
+    m_volumes        = volumes;
+    m_strpool.Attach (bytes + header->stringPoolOffset, header->stringPoolSize);
+    m_pageStates.assign (header->numPages, PageUnchecked);
+    m_entryPages.assign (header->numEntryPages, {});
+    m_entryPageDone.assign (header->numEntryPages, false);
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::CheckPage (uint64_t offset, bool isPoolPage) const {
+
+    // Returns true if the page holding the given image offset is intact. The page is checked
+    // against its page directory CRC the first time it is asked about, and the result is kept. A
+    // string pool page must also end with a null character, so that no string runs past its page.
+    //----------------------------------------------------------------------------------------------
+
+    auto page = static_cast<size_t>(offset / c_jdPageSize);
+
+    if ((page < m_header->firstDataPage) || (page >= m_pageStates.size()))
+        return false;
+
+    if (m_pageStates[page] == PageUnchecked) {
+        auto pageData = static_cast<const char*>(m_dataFile.Data()) + page * size_t{c_jdPageSize};
+        auto intact   = (Crc32 (0, pageData, c_jdPageSize) == m_pageChecksums[page - m_header->firstDataPage])
+                     && (!isPoolPage || (pageData[c_jdPageSize - 1] == 0));
+
+        m_pageStates[page] = intact ? PageGood : PageBad;
+
+        if (!intact)
+            DPrint ("Data file page %zu is damaged; skipping its contents.", page);
+    }
+
+    return m_pageStates[page] == PageGood;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::ReplayJournal (const vector<JDJournalRecord>& records) {
+
+    // Folds journal records (oldest first, in journal order) into the list of recent visits. Each
+    // path appears once, with its most recent visit. The resulting list is ordered most recent
+    // first.
+    //----------------------------------------------------------------------------------------------
+
+    unordered_map<string, size_t> latest;    // Path key to index of its most recent record
+
+    for (size_t i=0;  i < records.size();  ++i) {
+        auto slot = latest.emplace (PathKey(records[i].path), i);
+        if (!slot.second && (records[i].time >= records[slot.first->second].time))
+            slot.first->second = i;
+    }
+
+    vector<size_t> order;
+
+    for (auto& keyIndex : latest)
+        order.push_back (keyIndex.second);
+
+    // Most recent first. Visits within the same second fall back to journal order.
+
+    sort (order.begin(), order.end(), [&records](size_t a, size_t b) {
+        return (records[a].time != records[b].time) ? (records[a].time > records[b].time) : (a > b);
+    });
+
+    for (auto index : order) {
+        auto& record = records[index];
+        m_recentKeys.emplace (PathKey (record.path), m_recent.size());
+        m_recent.push_back ({record.path, record.time, record.serialnum, record.visitCount, record.score});
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::VisitHistory (JDHistoryCallback* callback, void* userData) const {
+
+    // Reports every history entry to the given callback, most recent first, until the callback
+    // returns false. Journaled visits come first, followed by the snapshot entries that have not
+    // been revisited since the snapshot was written. The walk also stops once the search budget (if
+    // any) is spent.
+    //----------------------------------------------------------------------------------------------
+
+    for (auto& visit : m_recent) {
+        if (!callback ({visit.path.c_str(), visit.time, visit.serialnum, visit.visitCount, visit.score}, userData))
+            return;
+    }
+
+    char path [MAX_PATH+1];
+
+    // Entries are stored in recency order, so walk the table directly. This skips any entries on a
+    // damaged page, and touches no pages past the point where the callback stops the walk.
+
+    for (uint32_t index=0;  (index < NumEntries()) && !SearchSpent();  ++index) {
+        auto entry = Entry (index);
+
+        if (!entry || (0 == BuildPath (entry->m_dpath, path, sizeof(path))))
+            continue;
+
+        if (!m_recent.empty() && m_recentKeys.count (PathKey(path)))
+            continue;
+
+        JDHistoryItem item {path, entry->m_lastverified, entry->m_serialnum, entry->m_visitCount, entry->m_score};
+
+        if (!callback (item, userData))
+            return;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::CopyHistory (vector<JDVisit>& visits) const {
+
+    // Appends a copy of every history entry to 'visits', most recent first (see VisitHistory).
+    //----------------------------------------------------------------------------------------------
+
+    VisitHistory ([](const JDHistoryItem& item, void* userData) {
+        static_cast<vector<JDVisit>*>(userData)->push_back (
+            {item.path, item.lastVisit, item.serialnum, item.visitCount, item.score});
+        return true;
+    }, &visits);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::BestMatch (JDMatchCallback* match, void* userData, string& bestPath) const {
+
+    // Finds the best history entry (see JDMatchSelector) among all entries that the given match
+    // function accepts.
+    //
+    // Returns true (with the winning path in 'bestPath') if any entry matched, otherwise false.
+    //----------------------------------------------------------------------------------------------
+
+    struct BestState {
+        const JumpData*  data;
+        JDMatchCallback* match;
+        void*            userData;
+        JDMatchSelector  selector;
+    } state { this, match, userData, {} };
+
+    VisitHistory ([](const JDHistoryItem& item, void* userData) {
+        auto state = static_cast<BestState*>(userData);
+
+        if (!state->match (item, state->userData))
+            return true;
+
+        state->selector.Consider (item);
+        return state->data->ChargeMatch();
+    }, &state);
+
+    if (state.selector.Found())
+        bestPath = state.selector.Path();
+
+    return state.selector.Found();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::BestNearestMatch (const char* origin, JDMatchCallback* match, void* userData,
+                                 string& bestPath) const {
+
+    // Finds the history entry that the given match function accepts with the fewest hops from the
+    // origin directory (see HopCount). Of equally near entries, the best by JDMatchSelector wins.
+    // Snapshot entries are taken in rings of increasing distance from the prefix index (see Prefix
+    // Index), so the search usually ends long before the whole history has been tested. Each match
+    // is charged to the search budget, and the search stops once it is spent.
+    //
+    // Returns true (with the winning path in 'bestPath') if any entry matched, otherwise false.
+    //----------------------------------------------------------------------------------------------
+
+    auto originKey  = PathKey (origin);
+    auto components = PathComponents (originKey);
+    auto depth      = static_cast<uint32_t>(components.size());
+
+    JDMatchSelector selector;
+    bool            stopped = false;   // True once the search budget stops the search
+
+    auto consider = [&](const JDHistoryItem& item) {
+        if (match (item, userData)) {
+            selector.Consider (item, HopCount (components, PathKey (item.path)));
+            stopped = !ChargeMatch();
+        }
+    };
+
+    for (auto& visit : m_recent) {
+        if (stopped) break;
+        consider ({visit.path.c_str(), visit.time, visit.serialnum, visit.visitCount, visit.score});
+    }
+
+    // Offers the snapshot entries at prefix index positions [first,last) to the selector, skipping
+    // entries superseded by a journaled visit.
+
+    char path [MAX_PATH+1];
+
+    auto considerRange = [&](uint32_t first, uint32_t last) {
+        for (auto position = first;  (position < last) && !stopped;  ++position) {
+            if (SearchSpent()) {
+                stopped = true;
+                break;
+            }
+
+            auto entry = Entry (PrefixIndexEntry (position));
+
+            if (!entry || (0 == BuildPath (entry->m_dpath, path, sizeof(path))))
+                continue;
+
+            if (!m_recent.empty() && m_recentKeys.count (PathKey(path)))
+                continue;
+
+            consider ({path, entry->m_lastverified, entry->m_serialnum, entry->m_visitCount, entry->m_score});
+        }
+    };
+
+    // Find the run of prefix index positions below each ancestor of the origin (the keys from
+    // "<ancestor>/" up to, but not including, "<ancestor>0", since '0' follows '/'). Level zero
+    // stands for the whole index.
+
+    vector<uint32_t> runFirst (depth + 1, 0);
+    vector<uint32_t> runLast  (depth + 1, m_header->numHistEntries);
+
+    auto ancestor = originKey.substr (0, originKey.find_first_not_of ('/'));   // Leading slashes
+
+    for (uint32_t level=1;  level <= depth;  ++level) {
+        ancestor += ((level > 1) ? "/" : "") + components[level-1];
+        runFirst[level] = PrefixLowerBound (ancestor + '/');
+        runLast[level]  = PrefixLowerBound (ancestor + '0');
+    }
+
+    // Take the rings outward from the origin. The ring at each level holds the entries below that
+    // ancestor but not below the next deeper one, and so includes the deeper ancestor itself,
+    // which is depth - level - 1 hops away. Stop once no ring farther out can hold a match as near
+    // as the best so far.
+
+    for (auto level = depth + 1;  !stopped && (level-- > 0);  ) {
+        auto nearest = (level + 1 >= depth) ? 0 : depth - level - 1;
+
+        if (selector.Found() && (selector.Distance() < nearest)) {
+            DPrint ("Nearest match is %u hops away; searched to depth %u.", selector.Distance(), level + 1);
+            break;
+        }
+
+        if (level == depth) {
+            considerRange (runFirst[level], runLast[level]);
+        } else {
+            considerRange (runFirst[level],  runFirst[level+1]);
+            considerRange (runLast[level+1], runLast[level]);
+        }
+    }
+
+    if (selector.Found())
+        bestPath = selector.Path();
+
+    return selector.Found();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::BestTailMatch (const char* tail, JDMatchCallback* match, void* userData, string& bestPath,
+                              const char* nearTo) const {
+
+    // Finds the best history entry (see JDMatchSelector) whose path ends in the given tail (without
+    // regard to case or slash direction), among those that the given match function accepts.
+    // Journaled visits are tested directly; snapshot entries come from the tail index. If 'nearTo'
+    // is given, the matching entry nearest that directory wins instead (see BestNearestMatch).
+    //
+    // Returns true (with the winning path in 'bestPath') if any entry matched, otherwise false.
+    //----------------------------------------------------------------------------------------------
+
+    if (nearTo) {
+        struct TailState {
+            string           tailKey;
+            JDMatchCallback* match;
+            void*            userData;
+        } state { PathKey (tail), match, userData };
+
+        return BestNearestMatch (nearTo, [](const JDHistoryItem& item, void* userData) {
+            auto  state = static_cast<TailState*>(userData);
+            auto  key   = PathKey (item.path);
+            auto& tail  = state->tailKey;
+
+            return (key.size() >= tail.size())
+                && (0 == key.compare (key.size() - tail.size(), tail.size(), tail))
+                && state->match (item, state->userData);
+        }, &state, bestPath);
+    }
+
+    auto            tailKey = PathKey (tail);
+    JDMatchSelector selector;
+
+    for (auto& visit : m_recent) {
+        auto key = PathKey (visit.path.c_str());
+
+        if (  (key.size() >= tailKey.size())
+           && (0 == key.compare (key.size() - tailKey.size(), tailKey.size(), tailKey)))
+        {
+            JDHistoryItem item {visit.path.c_str(), visit.time, visit.serialnum, visit.visitCount, visit.score};
+
+            if (match (item, userData)) {
+                selector.Consider (item);
+
+                if (!ChargeMatch())
+                    break;
+            }
+        }
+    }
+
+    if (!SearchSpent()) {
+        vector<uint32_t> entries;
+        TailMatchEntries (tailKey.c_str(), entries);
+        SelectEntries (entries, match, userData, selector);
+    }
+
+    if (selector.Found())
+        bestPath = selector.Path();
+
+    return selector.Found();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::BestWildcardMatch (const char* pattern, JDMatchCallback* match, void* userData,
+                                  string& bestPath, const char* nearTo) const {
+
+    // Finds the best history entry (see JDMatchSelector) that matches the given wildcard pattern
+    // (see MatchHistory), among those that the given match function accepts. If 'nearTo' is given,
+    // the matching entry nearest that directory wins instead (see BestNearestMatch).
+    //
+    // Returns true (with the winning path in 'bestPath') if any entry matched, otherwise false.
+    //----------------------------------------------------------------------------------------------
+
+    if (nearTo) {
+        struct WildcardState {
+            CompiledPattern  pattern;
+            JDMatchCallback* match;
+            void*            userData;
+        } state { {WidenPath(pattern).c_str(), CompiledPattern::Syntax::Path}, match, userData };
+
+        return BestNearestMatch (nearTo, [](const JDHistoryItem& item, void* userData) {
+            auto state = static_cast<WildcardState*>(userData);
+            return state->pattern.Match (WidenPath (item.path).c_str()) && state->match (item, state->userData);
+        }, &state, bestPath);
+    }
+
+    vector<JDVisit> matches;
+    MatchHistory (pattern, matches);
+
+    JDMatchSelector selector;
+
+    for (auto& visit : matches) {
+        JDHistoryItem item {visit.path.c_str(), visit.time, visit.serialnum, visit.visitCount, visit.score};
+
+        if (match (item, userData))
+            selector.Consider (item);
+    }
+
+    if (selector.Found())
+        bestPath = selector.Path();
+
+    return selector.Found();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::MatchHistory (const char* pattern, vector<JDVisit>& matches) const {
+
+    // Collects every history entry that matches the given wildcard path pattern (see pathMatch),
+    // most recent first. Only entries that could match the pattern are tested (see Trigram Index).
+    // If the pattern has no literal run long enough to narrow the search, every entry is tested.
+    // The search stops early once the search budget (if any) is spent.
+    //----------------------------------------------------------------------------------------------
+
+    vector<JDVisit>  candidates;
+    vector<uint32_t> entries;
+
+    if (WildcardCandidates (pattern, entries)) {
+        DPrint ("Trigram index narrowed the search to %zu entries.", entries.size());
+        candidates.assign (m_recent.begin(), m_recent.end());
+        CollectEntries (entries, candidates);
+    } else {
+        CopyHistory (candidates);
+    }
+
+    vector<size_t> matchIndices;
+    MatchVisits (pattern, candidates, matchIndices, m_budget);
+
+    for (auto index : matchIndices)
+        matches.push_back (std::move (candidates[index]));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::MatchVisits (const char* pattern, const vector<JDVisit>& visits, vector<size_t>& matches,
+                            SearchBudget* budget) {
+
+    // Tests the given wildcard path pattern against the path of each visit, and appends the index
+    // of each matching visit to 'matches', in ascending order. The visits are tested in batches of
+    // c_searchBatchSize, which the path matcher spreads across the available cores. If a search
+    // budget is given, each match is charged to it, and no further batch is tested once it is spent.
+    //----------------------------------------------------------------------------------------------
+
+    CompiledPattern compiled {WidenPath(pattern).c_str(), CompiledPattern::Syntax::Path};
+
+    vector<std::wstring>   widePaths;
+    vector<const wchar_t*> pathPointers;
+    vector<size_t>         batchMatches;
+
+    for (size_t first=0;  first < visits.size();  first += c_searchBatchSize) {
+        if (budget && budget->Spent())
+            return;
+
+        auto count = std::min (c_searchBatchSize, visits.size() - first);
+        WidenVisitPaths (visits, first, count, widePaths, pathPointers);
+
+        batchMatches.clear();
+        compiled.MatchAll (pathPointers.data(), count, batchMatches);
+
+        for (auto index : batchMatches) {
+            matches.push_back (first + index);
+
+            if (budget && !budget->AddMatch())
+                return;
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::WidenVisitPaths (const vector<JDVisit>& visits, size_t first, size_t count,
+                                vector<std::wstring>& widePaths, vector<const wchar_t*>& pathPointers) {
+
+    // Widens the paths of the 'count' visits from index 'first' on (see WidenPath) for batch
+    // matching, replacing the contents of 'widePaths'. 'pathPointers' receives the string of each
+    // entry of 'widePaths', in visit order.
+    //----------------------------------------------------------------------------------------------
+
+    widePaths.clear();
+    pathPointers.clear();
+    widePaths.reserve (count);
+    pathPointers.reserve (count);
+
+    for (auto index = first;  index < first + count;  ++index)
+        widePaths.push_back (WidenPath (visits[index].path.c_str()));
+
+    for (auto& widePath : widePaths)
+        pathPointers.push_back (widePath.c_str());
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::BestSparseMatch (const char* pattern, JDMatchCallback* match, void* userData,
+                                string& bestPath, const char* nearTo) const {
+
+    // Finds the best history entry that holds the characters of the given pattern in order (see
+    // SparsePattern), among those that the given match function accepts. Each entry is ranked by
+    // its sparse match score plus c_sparseFrecencyWeight per doubling of its frecency, so a tight
+    // match beats a scattered one unless the scattered one is used far more. Of equally ranked
+    // entries, the most recent wins. If 'nearTo' is given, the matching entry nearest that
+    // directory wins instead (see BestNearestMatch).
+    //
+    // Returns true (with the winning path in 'bestPath') if any entry matched, otherwise false.
+    //----------------------------------------------------------------------------------------------
+
+    SparsePattern sparse {WidenPath(pattern).c_str()};
+
+    if (!sparse.IsValid()) {
+        DPrint ("Sparse pattern is empty or too long.");
+        return false;
+    }
+
+    if (nearTo) {
+        struct SparseState {
+            const SparsePattern& pattern;
+            JDMatchCallback*     match;
+            void*                userData;
+        } state { sparse, match, userData };
+
+        return BestNearestMatch (nearTo, [](const JDHistoryItem& item, void* userData) {
+            auto state = static_cast<SparseState*>(userData);
+            int  score;
+            return state->pattern.Score (WidenPath (item.path).c_str(), score) && state->match (item, state->userData);
+        }, &state, bestPath);
+    }
+
+    vector<JDVisit> history;
+    CopyHistory (history);
+
+    // Score the history in batches, charging each match to the search budget, and stop once it is
+    // spent.
+
+    vector<std::wstring>               widePaths;
+    vector<const wchar_t*>             pathPointers;
+    vector<SparsePattern::ScoredMatch> matches;
+
+    for (size_t first=0;  (first < history.size()) && !SearchSpent();  first += c_searchBatchSize) {
+        auto count     = std::min (c_searchBatchSize, history.size() - first);
+        auto numScored = matches.size();
+
+        WidenVisitPaths (history, first, count, widePaths, pathPointers);
+        sparse.ScoreAll (pathPointers.data(), count, matches);
+
+        auto charged = numScored;
+
+        while (charged < matches.size()) {
+            matches[charged++].index += first;
+
+            if (!ChargeMatch())
+                break;
+        }
+
+        if (charged < matches.size()) {
+            matches.resize (charged);
+            break;
+        }
+    }
+
+    auto    now      = static_cast<int64_t>(time(nullptr));
+    bool    found    = false;
+    double  bestRank = 0;
+    int64_t bestTime = 0;
+
+    for (auto& scored : matches) {
+        auto& visit = history[scored.index];
+
+        JDHistoryItem item {visit.path.c_str(), visit.time, visit.serialnum, visit.visitCount, visit.score};
+
+        if (!match (item, userData))
+            continue;
+
+        auto rank = scored.score + c_sparseFrecencyWeight * log2 (1.0 + item.Frecency (now));
+
+        if (found && ((rank < bestRank) || ((rank == bestRank) && (item.lastVisit <= bestTime))))
+            continue;
+
+        DPrint ("Sparse match %s (score %d, rank %.1f).", item.path, scored.score, rank);
+
+        found    = true;
+        bestRank = rank;
+        bestTime = item.lastVisit;
+        bestPath = visit.path;
+    }
+
+    return found;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::SelectEntries (const vector<uint32_t>& entries, JDMatchCallback* match, void* userData,
+                              JDMatchSelector& selector) const {
+
+    // Offers each of the given snapshot entries that the match function accepts to the selector.
+    // Entries that have since been revisited (and so are superseded by a journaled visit) are
+    // skipped. Each match is charged to the search budget, and the search stops once it is spent.
+    //----------------------------------------------------------------------------------------------
+
+    char path [MAX_PATH+1];
+
+    for (auto index : entries) {
+        if (SearchSpent())
+            return;
+
+        auto entry = Entry (index);
+
+        if (!entry || (0 == BuildPath (entry->m_dpath, path, sizeof(path))))
+            continue;
+
+        if (!m_recent.empty() && m_recentKeys.count (PathKey(path)))
+            continue;
+
+        JDHistoryItem item {path, entry->m_lastverified, entry->m_serialnum, entry->m_visitCount, entry->m_score};
+
+        if (match (item, userData)) {
+            selector.Consider (item);
+
+            if (!ChargeMatch())
+                return;
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::CollectEntries (const vector<uint32_t>& entries, vector<JDVisit>& visits) const {
+
+    // Appends a copy of each of the given snapshot entries to 'visits', skipping entries that have
+    // since been revisited (and so are superseded by a journaled visit). Stops early once the
+    // search budget (if any) is spent.
+    //----------------------------------------------------------------------------------------------
+
+    char path [MAX_PATH+1];
+
+    for (auto index : entries) {
+        if (SearchSpent())
+            return;
+
+        auto entry = Entry (index);
+
+        if (!entry || (0 == BuildPath (entry->m_dpath, path, sizeof(path))))
+            continue;
+
+        if (!m_recent.empty() && m_recentKeys.count (PathKey(path)))
+            continue;
+
+        visits.push_back ({path, entry->m_lastverified, entry->m_serialnum, entry->m_visitCount, entry->m_score});
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::WildcardCandidates (const char* pattern, vector<uint32_t>& entries) const {
+
+    // Collects the snapshot entries that contain every trigram of the given wildcard pattern's
+    // literal runs (see Trigram Index), in ascending order.
+    //
+    // Returns false if the pattern yields no trigrams (or the snapshot has no trigram index), in
+    // which case every entry is a candidate.
+    //----------------------------------------------------------------------------------------------
+
+    if (m_header->numTrigrams == 0)
+        return false;
+
+    // Blank out the wildcard operators, so that only literal runs contribute trigrams.
+
+    auto literals = PathKey (pattern);
+
+    for (size_t i=0;  i < literals.size();  ++i) {
+        if (isWildStr (&literals[i])) {
+            auto length = (literals[i] == '.') ? 3 : 1;
+            literals.replace (i, length, length, '/');
+            i += length - 1;
+        }
+    }
+
+    vector<uint32_t> trigrams;
+    PathTrigrams (literals, trigrams);
+
+    if (trigrams.empty())
+        return false;
+
+    // Intersect the posting lists, starting from the first.
+
+    vector<uint32_t> postings, intersection;
+
+    for (size_t i=0;  i < trigrams.size();  ++i) {
+        if (!ReadPostings (trigrams[i], postings)) {
+            entries.clear();
+            return true;
+        }
+
+        if (i == 0) {
+            entries.swap (postings);
+        } else {
+            intersection.clear();
+            std::set_intersection (entries.begin(), entries.end(), postings.begin(), postings.end(),
+                                   std::back_inserter (intersection));
+            entries.swap (intersection);
+        }
+
+        if (entries.empty())
+            break;
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::ReadPostings (uint32_t trigram, vector<uint32_t>& postings) const {
+
+    // Reads the posting list of the given trigram, replacing the contents of 'postings'.
+    //
+    // Returns false if no entry contains the trigram. A posting list on a damaged page reads as
+    // empty.
+    //----------------------------------------------------------------------------------------------
+
+    auto bytes = static_cast<const char*>(m_dataFile.Data());
+
+    auto trigramAt = [&](uint32_t index) -> const JDTrigram* {
+        auto offset = m_header->trigramOffset + uint64_t{index} * sizeof(JDTrigram);
+        return CheckPage (offset) ? reinterpret_cast<const JDTrigram*>(bytes + offset) : nullptr;
+    };
+
+    postings.clear();
+
+    uint32_t low = 0, high = m_header->numTrigrams;
+
+    while (low < high) {
+        auto mid   = low + (high - low) / 2;
+        auto entry = trigramAt (mid);
+
+        if (!entry)
+            return false;
+
+        if (entry->m_trigram < trigram) low = mid + 1; else high = mid;
+    }
+
+    if (low >= m_header->numTrigrams)
+        return false;
+
+    auto first = trigramAt (low);
+    auto next  = trigramAt (low + 1);
+
+    if (!first || !next || (first->m_trigram != trigram))
+        return false;
+
+    if ((first->m_first > next->m_first) || (next->m_first > m_header->numPostings))
+        return false;
+
+    postings.reserve (next->m_first - first->m_first);
+
+    for (auto index = first->m_first;  index < next->m_first;  ++index) {
+        auto offset = m_header->postingsOffset + uint64_t{index} * sizeof(uint32_t);
+
+        if (!CheckPage (offset)) {
+            postings.clear();
+            return false;
+        }
+
+        postings.push_back (*reinterpret_cast<const uint32_t*>(bytes + offset));
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::TailMatchEntries (const char* tail, vector<uint32_t>& entries) const {
+
+    // Collects the snapshot entries whose paths end in the given tail (see TailMatchNodes).
+    //----------------------------------------------------------------------------------------------
+
+    vector<uint32_t> nodes;
+    TailMatchNodes (tail, nodes);
+
+    for (auto node : nodes) {
+        auto entry = NodeEntry (node);
+
+        if (entry != c_noEntry)
+            entries.push_back (entry);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::TailMatchNodes (const char* tail, vector<uint32_t>& nodes) const {
+
+    // Collects the snapshot trie nodes whose paths end in the given tail, which must be a path key
+    // (see PathKey). The last component of the tail must match a full component name, and the
+    // first may match the end of one. Every node is a candidate, whether or not an entry ends at
+    // it, since each stands for a directory that some entry passed through. See Tail Index.
+    //----------------------------------------------------------------------------------------------
+
+    auto numNodes = m_header->numPathNodes;
+
+    if ((numNodes == 0) || (m_header->tailIndexOffset == 0) || !*tail)
+        return;
+
+    // Split the tail into its leading partial part, and the final component that the index is
+    // searched for. With a single component, the final component is itself partial.
+
+    auto lastSlash  = strrchr (tail, '/');
+    auto last       = lastSlash ? lastSlash + 1 : tail;
+    auto lastLength = strlen (last);
+
+    auto compare = [&](uint32_t position) {
+        auto node = PathNode (TailIndexNode (position));
+        auto name = node ? NodeName (*node) : nullptr;
+        return name ? CompareTail (name, strlen(name), last, lastLength) : 0;
+    };
+
+    // Binary search for the run of index positions whose names end in the final component.
+
+    uint32_t low = 0, high = numNodes;
+
+    while (low < high) {
+        auto mid = low + (high - low) / 2;
+        if (compare(mid) < 0) low = mid + 1; else high = mid;
+    }
+
+    for (auto position = low;  (position < numNodes) && (compare(position) == 0);  ++position) {
+        auto nodeIndex = TailIndexNode (position);
+        auto node      = PathNode (nodeIndex);
+        auto name      = node ? NodeName (*node) : nullptr;
+
+        if (!name)
+            continue;
+
+        // With more than one component, the final one must match the whole name, and each one
+        // before it must match the names up the trie.
+
+        if (lastSlash) {
+            if ((strlen(name) != lastLength) || ((lastSlash == tail) && (node->m_parent == c_noNode)))
+                continue;
+
+            auto matched = true;
+            auto partEnd = lastSlash;
+            auto parent  = node;
+
+            while (matched && (partEnd > tail)) {
+                auto partStart = partEnd;
+                while ((partStart > tail) && (partStart[-1] != '/'))
+                    --partStart;
+
+                parent = PathNode (parent->m_parent);
+                auto parentName = parent ? NodeName (*parent) : nullptr;
+
+                if (!parentName) {
+                    matched = false;
+                    break;
+                }
+
+                auto partLength = static_cast<size_t>(partEnd - partStart);
+                auto nameLength = strlen (parentName);
+
+                matched = (0 == CompareTail (parentName, nameLength, partStart, partLength))
+                       && ((partStart == tail) || (nameLength == partLength));
+
+                partEnd = (partStart > tail) ? partStart - 1 : tail;
+            }
+
+            if (!matched)
+                continue;
+        }
+
+        nodes.push_back (nodeIndex);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::PartialPathCandidates (const char* dest, vector<string>& candidates) const {
+
+    // Collects the candidate directories for the Partial Path Match strategy, which looks for the
+    // destination path hanging off some directory on the way to a visited one. For a destination
+    // "ox/yz/zy", the candidates are first each visited directory ending in "ox/yz/zy" (where "ox"
+    // may end a longer name, as in "box"), then each ending in "ox/yz" with "/zy" appended, then
+    // each ending in "ox" with "/yz/zy" appended. Snapshot directories come from the tail index
+    // (see TailMatchNodes), so only directories that actually line up with the destination are
+    // ever candidates. Within each group, directories of more recent entries come first.
+    //----------------------------------------------------------------------------------------------
+
+    auto parts = PathComponents (dest);
+
+    unordered_set<string> seen;        // Path keys of the candidates so far
+
+    auto addCandidate = [&](string path, const string& rest) {
+        if (!rest.empty())
+            path += ((path.back() == '/') ? "" : "/") + rest;
+
+        if (seen.insert (PathKey (path.c_str())).second)
+            candidates.push_back (std::move (path));
+    };
+
+    for (auto lineup = parts.size();  lineup > 0;  --lineup) {
+        string tail, rest;
+
+        for (size_t i=0;  i < parts.size();  ++i) {
+            auto& part = (i < lineup) ? tail : rest;
+
+            if (!part.empty())
+                part += '/';
+
+            part += parts[i];
+        }
+
+        auto tailKey = PathKey (tail.c_str());
+
+        // Journaled visits aren't in the snapshot trie, so test each directory along their paths.
+
+        for (auto& visit : m_recent) {
+            auto& path = visit.path;
+
+            for (size_t end = 1;  end <= path.size();  ++end) {
+                if ((end < path.size()) && ((path[end] != '/') || (path[end-1] == '/')))
+                    continue;
+
+                auto key = PathKey (path.substr (0, end).c_str());
+
+                if (  (key.size() >= tailKey.size())
+                   && (0 == key.compare (key.size() - tailKey.size(), tailKey.size(), tailKey)))
+                {
+                    addCandidate (path.substr (0, end), rest);
+                }
+            }
+        }
+
+        // Trie nodes are numbered in the order that entries (most recent first) first use them.
+
+        vector<uint32_t> nodes;
+        TailMatchNodes (tailKey.c_str(), nodes);
+        std::sort (nodes.begin(), nodes.end());
+
+        char path [MAX_PATH+1];
+
+        for (auto node : nodes) {
+            if (BuildPath (node, path, sizeof(path)))
+                addCandidate (path, rest);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+uint32_t JumpData::TailIndexNode (uint32_t position) const {
+
+    // Returns the trie node at the given position of the tail index, or c_noNode if the position
+    // lies on a damaged page.
+    //----------------------------------------------------------------------------------------------
+
+    auto offset = m_header->tailIndexOffset + uint64_t{position} * sizeof(uint32_t);
+
+    if (!CheckPage (offset))
+        return c_noNode;
+
+    return *reinterpret_cast<const uint32_t*>(static_cast<const char*>(m_dataFile.Data()) + offset);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+uint32_t JumpData::NodeEntry (uint32_t node) const {
+
+    // Returns the entry whose path ends at the given trie node, or c_noEntry if there is none (or
+    // its node entry table page is damaged).
+    //----------------------------------------------------------------------------------------------
+
+    auto offset = m_header->nodeEntryOffset + uint64_t{node} * sizeof(uint32_t);
+
+    if ((node >= m_header->numPathNodes) || !CheckPage (offset))
+        return c_noEntry;
+
+    return *reinterpret_cast<const uint32_t*>(static_cast<const char*>(m_dataFile.Data()) + offset);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+uint32_t JumpData::PrefixIndexEntry (uint32_t position) const {
+
+    // Returns the entry at the given position of the prefix index, or c_noEntry if the position
+    // lies on a damaged page.
+    //----------------------------------------------------------------------------------------------
+
+    auto offset = m_header->prefixOffset + uint64_t{position} * sizeof(uint32_t);
+
+    if (!CheckPage (offset))
+        return c_noEntry;
+
+    return *reinterpret_cast<const uint32_t*>(static_cast<const char*>(m_dataFile.Data()) + offset);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+uint32_t JumpData::PrefixLowerBound (const string& key) const {
+
+    // Returns the first position of the prefix index whose entry's path key does not sort before
+    // the given key (see Prefix Index). Positions on damaged pages compare as equal.
+    //----------------------------------------------------------------------------------------------
+
+    char     path [MAX_PATH+1];
+    uint32_t low = 0, high = m_header->numHistEntries;
+
+    while (low < high) {
+        auto mid   = low + (high - low) / 2;
+        auto entry = Entry (PrefixIndexEntry (mid));
+
+        if (entry && BuildPath (entry->m_dpath, path, sizeof(path)) && (PathKey(path) < key))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JumpData::RecordVisit (const char* path, DWORD serialnum) {
+
+    // Notes a visit to the given path, to be recorded by the next call to Store(). The path's visit
+    // count and frecency score carry forward from its existing history entry, if it has one.
+    //----------------------------------------------------------------------------------------------
+
+    auto now = static_cast<int64_t>(time(nullptr));
+
+    JDVisit prior {path, now, serialnum, 0, 0.0};
+    FindVisit (path, prior);
+
+    m_pending    = {path, now, serialnum, prior.visitCount + 1, DecayedScore (prior.score, prior.time, now) + 1.0};
+    m_hasPending = true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::FindVisit (const char* path, JDVisit& visit) const {
+
+    // Looks up the history entry for the given path: first among the journaled visits, and then
+    // through the snapshot's path index.
+    //
+    // Returns true (with the entry in 'visit') if the path is in the history, otherwise false.
+    //----------------------------------------------------------------------------------------------
+
+    auto key    = PathKey (path);
+    auto recent = m_recentKeys.find (key);
+
+    if (recent != m_recentKeys.end()) {
+        visit = m_recent[recent->second];
+        return true;
+    }
+
+    auto entry = Entry (FindEntry (key));
+
+    if (!entry)
+        return false;
+
+    char entryPath [MAX_PATH+1];
+
+    if (0 == BuildPath (entry->m_dpath, entryPath, sizeof(entryPath)))
+        return false;
+
+    visit = {entryPath, entry->m_lastverified, entry->m_serialnum, entry->m_visitCount, entry->m_score};
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+uint32_t JumpData::FindEntry (const string& key) const {
+
+    // Probes the snapshot's path index (see Path Index) for the entry with the given path key.
+    //
+    // Returns the entry index, or c_noEntry if the snapshot has no entry for the path.
+    //----------------------------------------------------------------------------------------------
+
+    if (m_header->numHashSlots == 0)
+        return c_noEntry;
+
+    auto hash = PathHash (key);
+    auto tag  = static_cast<uint32_t>(hash >> 32);
+    auto mask = m_header->numHashSlots - 1;
+
+    char entryPath [MAX_PATH+1];
+
+    auto slot = static_cast<uint32_t>(hash) & mask;
+
+    for (uint32_t probe=0;  probe <= mask;  ++probe, slot = (slot + 1) & mask) {
+        if (!CheckPage (m_header->hashTableOffset + uint64_t{slot} * sizeof(JDHashSlot)))
+            return c_noEntry;
+
+        auto& hashSlot = m_hashSlots[slot];
+
+        if (hashSlot.m_entry == c_noEntry)
+            return c_noEntry;
+
+        if (hashSlot.m_hash != tag)
+            continue;
+
+        auto entry = Entry (hashSlot.m_entry);
+
+        if (entry && BuildPath (entry->m_dpath, entryPath, sizeof(entryPath)) && (PathKey(entryPath) == key))
+            return hashSlot.m_entry;
+    }
+
+    return c_noEntry;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::Store (const string& filename) {
+
+    // Records the pending visit (if any) by appending it to the visit journal. This never rewrites
+    // the data file itself; see Compact().
+    //----------------------------------------------------------------------------------------------
+
+    if (!m_hasPending) {
+        DPrint ("No visit to record.");
+        return true;
+    }
+
+    JDJournalRecord record {};
+
+    if (FAILED(strncpy_s (record.path, sizeof(record.path), m_pending.path.c_str(), _TRUNCATE))) {
+        ErrorPrint ("Path too long to record (%s).", m_pending.path.c_str());
+        return false;
+    }
+
+    record.magic      = c_jdJournalMagic;
+    record.serialnum  = m_pending.serialnum;
+    record.time       = m_pending.time;
+    record.visitCount = m_pending.visitCount;
+    record.score      = static_cast<float>(m_pending.score);
+
+    uint64_t journalSize = 0;
+
+    if (!AppendJournalRecord (filename + ".jnl", record, &journalSize))
+        return false;
+
+    m_hasPending      = false;
+    m_needsCompaction = (journalSize >= c_journalCompactSize);
+
+    DPrint ("Journaled visit to \"%s\" (journal is %llu bytes).", record.path,
+            static_cast<unsigned long long>(journalSize));
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+HANDLE JumpData::LockDataFile (const string& filename) {
+
+    // Takes the data file write lock, which serializes compaction and import. The lock file is held
+    // exclusively (no sharing) until the returned handle is closed, and is deleted when closed.
+    //
+    // Returns INVALID_HANDLE_VALUE if another process holds the lock.
+    //----------------------------------------------------------------------------------------------
+
+    auto lockName = filename + ".lock";
+
+    return CreateFileA (lockName.c_str(), GENERIC_WRITE, 0, NULL, OPEN_ALWAYS,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::Compact (const string& filename, const char* purgePattern) {
+
+    // Folds the visit journal into a new data file snapshot. If a purge pattern is given, history
+    // entries that match it (see MatchHistory) are left out of the new snapshot. Only one process
+    // compacts at a time; if another compaction is already under way, this returns immediately.
+    //
+    // Returns true on success, or if another process holds the compaction lock and there is nothing
+    // to purge.
+    //----------------------------------------------------------------------------------------------
+
+    auto lock = LockDataFile (filename);
+
+    if (lock == INVALID_HANDLE_VALUE) {
+        if (purgePattern) {
+            ErrorPrint ("The data file is being compacted; try the purge again.");
+            return false;
+        }
+
+        DPrint ("Compaction already in progress.");
+        return true;
+    }
+
+    // Set the current journal aside, unless a prior interrupted compaction already left one to be
+    // folded. New visits will start a fresh journal. Readers that overlap the rotation see the
+    // journal sequence change, and start over. The rename fails while another process has the
+    // journal open to append or read a record, so wait for it to let go.
+    //
+    // Only the journal set aside is folded. Visits journaled after the rotation stay in the current
+    // journal, and are replayed over the new snapshot; a purge leaves them alone. A purge must
+    // cover every visit journaled before it began, though, so if an interrupted compaction left a
+    // journal set aside, fold that one first without purging, then set the current one aside and
+    // fold it with the purge.
+
+    auto journalName    = filename + ".jnl";
+    auto oldJournalName = filename + ".jnl.old";
+
+    JDMappedFile controlFile;
+
+    if (!OpenControlBlock (filename, controlFile)) {
+        CloseHandle (lock);
+        return false;
+    }
+
+    auto control = static_cast<JDControlBlock*>(controlFile.MutableData());
+    auto success = true;
+    auto done    = false;
+
+    while (success && !done) {
+        auto leftOver = (0 == _access(oldJournalName.c_str(), 0));
+        auto current  = (0 == _access(journalName.c_str(), 0));
+
+        if (!leftOver && current) {
+            auto rotated = false;
+
+            for (int attempt=1;  !rotated && (attempt <= c_maxRotateAttempts);  ++attempt) {
+                if (attempt > 1)
+                    Sleep (c_rotateRetryMs);
+
+                InterlockedIncrement64 (&control->journalSeq);
+                rotated = MoveFileExA (journalName.c_str(), oldJournalName.c_str(), MOVEFILE_WRITE_THROUGH);
+                InterlockedIncrement64 (&control->journalSeq);
+            }
+
+            if (!rotated) {
+                ErrorPrint ("Couldn't rotate journal file \"%s\".", journalName.c_str());
+                CloseHandle (lock);
+                return false;
+            }
+        }
+
+        auto purgeNow = purgePattern && !(leftOver && current);
+
+        // Reload so that the view includes everything journaled up to the rotation, then copy out
+        // the merged history.
+
+        if (!Load (filename, false)) {
+            CloseHandle (lock);
+            return false;
+        }
+
+        JDFileHeader settings = Header();
+        vector<JDVisit> visits;
+
+        CopyHistory (visits);
+
+        if (HasDamagedPages())
+            RecoverDamagedEntries (filename, visits);
+
+        if (purgeNow) {
+            vector<size_t> matches;
+            MatchVisits (purgePattern, visits, matches);
+
+            // Keep the visits that didn't match, in order.
+
+            vector<JDVisit> kept;
+            size_t          next = 0;
+
+            for (size_t i=0;  i < visits.size();  ++i) {
+                if ((next < matches.size()) && (matches[next] == i))
+                    ++next;
+                else
+                    kept.push_back (std::move (visits[i]));
+            }
+
+            visits.swap (kept);
+            printf ("echo Purged %zu history entries.\n", matches.size());
+        }
+
+        if ((settings.maxHistSize > 0) && (visits.size() > static_cast<size_t>(settings.maxHistSize)))
+            visits.resize (settings.maxHistSize);
+
+        Unload();
+        m_defaultHeader = settings;
+
+        success = PublishSnapshot (filename, visits);
+
+        if (success) {
+            InterlockedIncrement64 (&control->journalSeq);
+            DeleteFileA (oldJournalName.c_str());
+            InterlockedIncrement64 (&control->journalSeq);
+        }
+
+        DPrint ("Compacted %zu history entries.", visits.size());
+
+        done = !purgePattern || purgeNow;
+    }
+
+    CloseHandle (lock);
+
+    return success && Load (filename);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::PublishSnapshot (const string& filename, const vector<JDVisit>& visits) const {
+
+    // Writes the next snapshot generation from the current header settings and the given visits,
+    // and makes it the current snapshot. Must be called with the data file lock held.
+    //----------------------------------------------------------------------------------------------
+
+    JDMappedFile controlFile;
+
+    if (!OpenControlBlock (filename, controlFile))
+        return false;
+
+    auto control    = static_cast<JDControlBlock*>(controlFile.MutableData());
+    auto generation = ReadShared (&control->generation) + 1;
+
+    if (!WriteSnapshot (SnapshotName (filename, generation), generation, visits))
+        return false;
+
+    // Publish the new generation. Readers that already pinned an older snapshot keep using it.
+
+    InterlockedExchange64 (&control->generation, generation);
+    FlushViewOfFile (control, sizeof(JDControlBlock));
+
+    DPrint ("Published snapshot generation %lld.", static_cast<long long>(generation));
+
+    // Keep the previous generation as a fallback, and collect the one before it.
+
+    if (generation > 2)
+        DeleteFileA (SnapshotName (filename, generation - 2).c_str());
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::WriteSnapshot (const string& snapshotName, int64_t generation,
+                              const vector<JDVisit>& visits) const {
+
+    // Writes a complete snapshot file from the current header settings and the given visits (most
+    // recent first). See the Data File Layout description above.
+    //----------------------------------------------------------------------------------------------
+
+    // Build the path trie and the volume table, and encode the entries that reference them into
+    // entry pages (see Entry Encoding).
+
+    JDPathTrieBuilder              trie;
+    vector<JDVolume>               volumes;
+    unordered_map<DWORD, uint32_t> volumeIndex;     // Serial number to volume table index
+    vector<uint8_t>                entryPages;
+    vector<uint32_t>               entryPageFirst;
+    vector<uint64_t>               entryHashes;     // Path key hash of each entry
+    vector<uint32_t>               entryNodes;      // Trie node of each entry
+    vector<string>                 entryKeys;       // Path key of each entry
+    vector<uint64_t>               trigramPostings; // Trigram (high 32 bits) and entry (low 32 bits) pairs
+    vector<uint32_t>               trigrams;
+    uint32_t                       numEntries = 0;
+
+    JDEntryPageHeader* pageHeader = nullptr;
+    size_t             pageUsed   = 0;
+    int64_t            prevTime   = 0;
+    int64_t            prevNode   = 0;
+
+    for (auto& visit : visits) {
+        auto node = trie.AddPath (visit.path);
+
+        if (node == c_noNode)
+            continue;
+
+        auto volume = volumeIndex.emplace (visit.serialnum, static_cast<uint32_t>(volumes.size()));
+
+        if (volume.second)
+            volumes.push_back ({visit.serialnum, 0, 0});
+
+        // Start a new entry page when this record might not fit in the current one.
+
+        if (!pageHeader || (pageUsed + c_maxEntryRecordSize > c_jdPageSize)) {
+            entryPages.resize (entryPages.size() + c_jdPageSize, 0);
+            entryPageFirst.push_back (numEntries);
+
+            pageHeader = reinterpret_cast<JDEntryPageHeader*>(entryPages.data() + entryPages.size() - c_jdPageSize);
+            pageHeader->firstEntry = numEntries;
+            pageHeader->numEntries = 0;
+            pageHeader->baseTime   = visit.time;
+
+            pageUsed = sizeof(JDEntryPageHeader);
+            prevTime = visit.time;
+            prevNode = 0;
+        }
+
+        auto out = reinterpret_cast<uint8_t*>(pageHeader) + pageUsed;
+
+        out += PutVarint (out, ZigZag (visit.time - prevTime));
+        out += PutVarint (out, volume.first->second);
+        out += PutVarint (out, ZigZag (int64_t{node} - prevNode));
+        out += PutVarint (out, visit.visitCount);
+        out += PutVarint (out, static_cast<uint64_t>(std::max (0.0, visit.score) * c_scoreScale + 0.5));
+
+        pageUsed = out - reinterpret_cast<uint8_t*>(pageHeader);
+
+        prevTime = visit.time;
+        prevNode = node;
+
+        auto key = PathKey (visit.path.c_str());
+
+        entryHashes.push_back (PathHash (key));
+        entryNodes.push_back (node);
+        entryKeys.push_back (key);
+
+        trigrams.clear();
+        PathTrigrams (key, trigrams);
+
+        for (auto trigram : trigrams)
+            trigramPostings.push_back ((uint64_t{trigram} << 32) | numEntries);
+
+        ++pageHeader->numEntries;
+        ++numEntries;
+    }
+
+    // Build the path index. Entries are inserted most recent first, so if a path somehow appears
+    // twice, lookups find its most recent entry.
+
+    uint32_t numHashSlots = (numEntries == 0) ? 0 : 8;
+
+    while (numHashSlots < 2 * uint64_t{numEntries})
+        numHashSlots <<= 1;
+
+    vector<JDHashSlot> hashSlots (numHashSlots, JDHashSlot{0, c_noEntry});
+
+    for (uint32_t entry=0;  entry < numEntries;  ++entry) {
+        auto slot = static_cast<uint32_t>(entryHashes[entry]) & (numHashSlots - 1);
+
+        while (hashSlots[slot].m_entry != c_noEntry)
+            slot = (slot + 1) & (numHashSlots - 1);
+
+        hashSlots[slot] = { static_cast<uint32_t>(entryHashes[entry] >> 32), entry };
+    }
+
+    auto& nodes = trie.Nodes();
+    auto& pool  = trie.Pool();
+
+    // Build the tail index and the node entry table (see Tail Index).
+
+    vector<uint32_t> tailIndex (nodes.size());
+    vector<uint32_t> nodeEntries (nodes.size(), c_noEntry);
+    vector<string>   reversedNames (nodes.size());      // Lowercase component names, reversed
+
+    for (uint32_t node=0;  node < nodes.size();  ++node) {
+        tailIndex[node]     = node;
+        reversedNames[node] = PathKey (pool.c_str() + nodes[node].m_name);
+        std::reverse (reversedNames[node].begin(), reversedNames[node].end());
+    }
+
+    std::sort (tailIndex.begin(), tailIndex.end(), [&reversedNames](uint32_t a, uint32_t b) {
+        return reversedNames[a] < reversedNames[b];
+    });
+
+    for (uint32_t entry=numEntries;  entry-- > 0;  )
+        nodeEntries[entryNodes[entry]] = entry;
+
+    // Build the trigram table and posting lists (see Trigram Index). Sorting the pairs groups
+    // them by trigram, with each group's entries in ascending order.
+
+    std::sort (trigramPostings.begin(), trigramPostings.end());
+
+    vector<JDTrigram> trigramTable;
+    vector<uint32_t>  postings;
+
+    postings.reserve (trigramPostings.size());
+
+    for (auto pair : trigramPostings) {
+        auto trigram = static_cast<uint32_t>(pair >> 32);
+
+        if (trigramTable.empty() || (trigramTable.back().m_trigram != trigram))
+            trigramTable.push_back ({trigram, static_cast<uint32_t>(postings.size())});
+
+        postings.push_back (static_cast<uint32_t>(pair));
+    }
+
+    auto numTrigrams = static_cast<uint32_t>(trigramTable.size());
+
+    trigramTable.push_back ({0xffffffff, static_cast<uint32_t>(postings.size())});
+
+    // Build the prefix index (see Prefix Index).
+
+    vector<uint32_t> prefixIndex (numEntries);
+
+    for (uint32_t entry=0;  entry < numEntries;  ++entry)
+        prefixIndex[entry] = entry;
+
+    std::sort (prefixIndex.begin(), prefixIndex.end(), [&entryKeys](uint32_t a, uint32_t b) {
+        return entryKeys[a] < entryKeys[b];
+    });
+
+    // Lay out the tables on page boundaries, after enough directory pages to hold the page
+    // checksums, the entry page start indices and the volume table.
+
+    auto pagesFor = [](uint64_t size) {
+        return static_cast<uint32_t>((size + c_jdPageSize - 1) / c_jdPageSize);
+    };
+
+    uint32_t numEntryPages = static_cast<uint32_t>(entryPageFirst.size());
+    uint32_t nodePages     = pagesFor (nodes.size() * sizeof(JDPathNode));
+    uint32_t poolPages     = pagesFor (pool.size());
+    uint32_t hashPages     = pagesFor (hashSlots.size() * sizeof(JDHashSlot));
+    uint32_t tailPages     = pagesFor (tailIndex.size() * sizeof(uint32_t));
+    uint32_t trigramPages  = pagesFor (trigramTable.size() * sizeof(JDTrigram));
+    uint32_t postingPages  = pagesFor (postings.size() * sizeof(uint32_t));
+    uint32_t prefixPages   = pagesFor (prefixIndex.size() * sizeof(uint32_t));
+    uint32_t dataPages     = numEntryPages + nodePages + poolPages + hashPages + 2 * tailPages
+                           + trigramPages + postingPages + prefixPages;
+    size_t   directorySize = (size_t{dataPages} + numEntryPages) * sizeof(uint32_t)
+                           + volumes.size() * sizeof(JDVolume);
+    uint32_t dirPages      = pagesFor (sizeof(JDFileHeader) + directorySize);
+
+    JDFileHeader header = *m_header;
+
+    header.magic            = c_jdMagic;
+    header.version          = c_jdFormatVersion;
+    header.headerSize       = sizeof(JDFileHeader);
+    header.pageSize         = c_jdPageSize;
+    header.firstDataPage    = dirPages;
+    header.numPages         = dirPages + dataPages;
+    header.numHistEntries   = numEntries;
+    header.headEntry        = (numEntries == 0) ? c_noEntry : 0;
+    header.numEntryPages    = numEntryPages;
+    header.numVolumes       = static_cast<uint32_t>(volumes.size());
+    header.entryTableOffset = dirPages * c_jdPageSize;
+    header.numPathNodes     = static_cast<uint32_t>(nodes.size());
+    header.nodeTableOffset  = (dirPages + numEntryPages) * c_jdPageSize;
+    header.stringPoolOffset = (dirPages + numEntryPages + nodePages) * c_jdPageSize;
+    header.stringPoolSize   = static_cast<uint32_t>(pool.size());
+    header.hashTableOffset  = (dirPages + numEntryPages + nodePages + poolPages) * c_jdPageSize;
+    header.numHashSlots     = numHashSlots;
+    header.tailIndexOffset  = header.hashTableOffset + hashPages * c_jdPageSize;
+    header.nodeEntryOffset  = header.tailIndexOffset + tailPages * c_jdPageSize;
+    header.trigramOffset    = header.nodeEntryOffset + tailPages * c_jdPageSize;
+    header.numTrigrams      = numTrigrams;
+    header.postingsOffset   = header.trigramOffset + trigramPages * c_jdPageSize;
+    header.numPostings      = static_cast<uint32_t>(postings.size());
+    header.prefixOffset     = header.postingsOffset + postingPages * c_jdPageSize;
+    header.generation       = generation;
+
+    // Assemble the image, then fill in the page directory and its checksum.
+
+    vector<char> image (size_t{header.numPages} * c_jdPageSize, 0);
+
+    memcpy (image.data() + header.entryTableOffset, entryPages.data(), entryPages.size());
+    memcpy (image.data() + header.nodeTableOffset,  nodes.data(),      nodes.size() * sizeof(JDPathNode));
+    memcpy (image.data() + header.stringPoolOffset, pool.data(),       pool.size());
+    memcpy (image.data() + header.hashTableOffset,  hashSlots.data(),  hashSlots.size() * sizeof(JDHashSlot));
+    memcpy (image.data() + header.tailIndexOffset,  tailIndex.data(),  tailIndex.size() * sizeof(uint32_t));
+    memcpy (image.data() + header.nodeEntryOffset,  nodeEntries.data(), nodeEntries.size() * sizeof(uint32_t));
+    memcpy (image.data() + header.trigramOffset,    trigramTable.data(), trigramTable.size() * sizeof(JDTrigram));
+    memcpy (image.data() + header.postingsOffset,   postings.data(),    postings.size() * sizeof(uint32_t));
+    memcpy (image.data() + header.prefixOffset,     prefixIndex.data(), prefixIndex.size() * sizeof(uint32_t));
+
+    auto pageChecksums = reinterpret_cast<uint32_t*>(image.data() + sizeof(JDFileHeader));
+
+    memcpy (pageChecksums + dataPages, entryPageFirst.data(), entryPageFirst.size() * sizeof(uint32_t));
+    memcpy (pageChecksums + dataPages + numEntryPages, volumes.data(), volumes.size() * sizeof(JDVolume));
+
+    for (uint32_t page = dirPages;  page < header.numPages;  ++page)
+        pageChecksums[page - dirPages] = Crc32 (0, image.data() + size_t{page} * c_jdPageSize, c_jdPageSize);
+
+    memcpy (image.data(), &header, sizeof(header));
+
+    auto checksum = header.Checksum (pageChecksums, directorySize);
+    memcpy (image.data() + offsetof(JDFileHeader, checksum), &checksum, sizeof(checksum));
+
+    // Write the complete snapshot to a temporary file, and force it to disk before giving it its
+    // final name. A crash at any point leaves no partial snapshot under a snapshot name.
+
+    auto tempName = snapshotName + ".tmp";
+    FILE *datafile;
+
+    if (0 != fopen_s (&datafile, tempName.c_str(), "wb")) {
+        ErrorPrint ("Couldn't create data file \"%s\".", tempName.c_str());
+        return false;
+    }
+
+    bool written = (1 == fwrite (image.data(), image.size(), 1, datafile))
+                && (0 == fflush (datafile))
+                && (0 == _commit (_fileno (datafile)));
+
+    if (0 != fclose (datafile))
+        written = false;
+
+    if (!written) {
+        ErrorPrint ("Error while writing data file \"%s\".", tempName.c_str());
+        DeleteFileA (tempName.c_str());
+        return false;
+    }
+
+    // A snapshot file with this name can only be left over from a writer that failed before
+    // publishing it, so it is safe to replace.
+
+    if (!MoveFileExA (tempName.c_str(), snapshotName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        ErrorPrint ("Couldn't create snapshot \"%s\" (error %lu).", snapshotName.c_str(),
+                    static_cast<unsigned long>(GetLastError()));
+        DeleteFileA (tempName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+
+//======================================================================================================================
+// JSON Import / Export
+//
+// The full history and data file settings can be exported to (and imported from) a JSON file of this form:
+//
+//     {
+//       "format": "jumpdir-history",
+//       "version": 1,
+//       "settings": { "maxHistSize": -1, "dirEcho": false, "verbose": false, "netSearch": true, "automap": true },
+//       "history": [
+//         { "path": "C:/foo/bar", "lastVisit": 1700000000, "serialnum": 305419896, "visitCount": 12, "score": 3.75 },
+//         ...
+//       ]
+//     }
+//
+// History entries are ordered most recent first. The score is the frecency score as of the last visit (see
+// Frecency). Entries without a visit count or score are taken as having been visited once. Export writes one entry
+// at a time, and import reads the file through a SAX handler, so neither side ever holds a JSON document tree in
+// memory.
+//
+// Paths are written as UTF-8, as JSON requires, and converted back to the active code page on import. Imported paths
+// that the active code page can't represent, or that don't fit in MAX_PATH, are skipped and counted.
+//======================================================================================================================
+
+static const char  c_jsonFormatName[] = "jumpdir-history";
+static const int   c_jsonFormatVersion = 1;
+
+
+class JDJsonImporter : public nlohmann::json_sax<json> {
+    //--------------------------------------------------------------------------
+    // SAX handler that reads a history export. Settings are stored into the given header, and history entries are
+    // appended to the given visit list as they are parsed. Unknown keys (and everything nested within them) are
+    // skipped, as are entries whose paths can't be used here (see Skipped).
+    //--------------------------------------------------------------------------
+
+  public:
+
+    JDJsonImporter (JDFileHeader& settings, vector<JDVisit>& visits)
+      : m_settings{settings}, m_visits{visits}, m_formatSeen{false}, m_skipped{0} {}
+
+    bool FormatSeen () const { return m_formatSeen; }
+    size_t Skipped () const { return m_skipped; }
+    const std::string& Error () const { return m_error; }
+
+    // SAX Events
+
+    bool null () override                                  { return true; }
+    bool boolean (bool value) override                     { return Boolean (value); }
+    bool number_integer (number_integer_t value) override  { return Integer (value); }
+    bool number_unsigned (number_unsigned_t value) override {
+        return Integer (static_cast<int64_t>(value));
+    }
+    bool number_float (number_float_t value, const string_t&) override { return Float (value); }
+    bool string (string_t& value) override;
+    bool binary (binary_t&) override                       { return true; }
+    bool start_object (std::size_t) override;
+    bool key (string_t& value) override                    { m_key = value;  return true; }
+    bool end_object () override;
+    bool start_array (std::size_t) override;
+    bool end_array () override                             { m_scopes.pop_back();  return true; }
+    bool parse_error (std::size_t position, const std::string&, const nlohmann::detail::exception& ex) override;
+
+  private:
+
+    enum class Scope { Root, Settings, History, Entry, Skipped };
+
+    bool In (Scope scope) const { return !m_scopes.empty() && (m_scopes.back() == scope); }
+
+    bool Boolean (bool value);
+    bool Integer (int64_t value);
+    bool Float (double value);
+
+    JDFileHeader&    m_settings;       // Imported Settings
+    vector<JDVisit>& m_visits;         // Imported History
+    vector<Scope>    m_scopes;         // Enclosing objects and arrays, innermost last
+    std::string      m_key;            // Most recent object key
+    JDVisit          m_entry;          // History entry being parsed
+    bool             m_formatSeen;     // True => the format signature was found
+    size_t           m_skipped;        // History entries skipped for unusable paths
+    std::string      m_error;          // Parse error message
+};
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDJsonImporter::start_object (std::size_t) {
+
+    // Enters a new object, which is the root object, the settings object, a history entry, or
+    // something to be skipped.
+    //----------------------------------------------------------------------------------------------
+
+    if (m_scopes.empty()) {
+        m_scopes.push_back (Scope::Root);
+    } else if (In(Scope::Root) && (m_key == "settings")) {
+        m_scopes.push_back (Scope::Settings);
+    } else if (In(Scope::History)) {
+        m_entry = {"", 0, 0, 1, 1.0};
+        m_scopes.push_back (Scope::Entry);
+    } else {
+        m_scopes.push_back (Scope::Skipped);
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDJsonImporter::end_object () {
+
+    // Leaves the current object. A completed history entry is added to the visit list.
+    //----------------------------------------------------------------------------------------------
+
+    if (In(Scope::Entry) && !m_entry.path.empty())
+        m_visits.push_back (std::move(m_entry));
+
+    m_scopes.pop_back();
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDJsonImporter::start_array (std::size_t) {
+
+    // Enters a new array. Only the root "history" array is of interest.
+    //----------------------------------------------------------------------------------------------
+
+    if (In(Scope::Root) && (m_key == "history"))
+        m_scopes.push_back (Scope::History);
+    else
+        m_scopes.push_back (Scope::Skipped);
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDJsonImporter::string (string_t& value) {
+
+    // Handles string values: the format signature, and history entry paths. Paths are converted
+    // from UTF-8 to the active code page; an entry whose path can't be converted, or is too long
+    // for the data file (which holds paths of fewer than MAX_PATH characters), is dropped.
+    //----------------------------------------------------------------------------------------------
+
+    if (In(Scope::Root) && (m_key == "format")) {
+        if (value != c_jsonFormatName) {
+            m_error = "not a jumpdir history file";
+            return false;
+        }
+        m_formatSeen = true;
+    } else if (In(Scope::Entry) && (m_key == "path")) {
+        if (!ConvertCodePage (CP_UTF8, CP_ACP, value, m_entry.path) || (m_entry.path.size() >= MAX_PATH)) {
+            m_entry.path.clear();
+            ++m_skipped;
+        }
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDJsonImporter::Boolean (bool value) {
+
+    // Handles boolean values, which are all settings.
+    //----------------------------------------------------------------------------------------------
+
+    if (!In(Scope::Settings))
+        return true;
+
+    if      (m_key == "dirEcho")   m_settings.dirEcho   = value;
+    else if (m_key == "verbose")   m_settings.verbose   = value;
+    else if (m_key == "netSearch") m_settings.netSearch = value;
+    else if (m_key == "automap")   m_settings.automap   = value;
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDJsonImporter::Integer (int64_t value) {
+
+    // Handles integer values: the format version, the history size setting, and the numeric fields
+    // of history entries.
+    //----------------------------------------------------------------------------------------------
+
+    if (In(Scope::Root) && (m_key == "version")) {
+        if (value > c_jsonFormatVersion) {
+            m_error = "unsupported history file version";
+            return false;
+        }
+    } else if (In(Scope::Settings) && (m_key == "maxHistSize")) {
+        m_settings.maxHistSize = static_cast<int>(value);
+    } else if (In(Scope::Entry)) {
+        if (m_key == "lastVisit")
+            m_entry.time = value;
+        else if (m_key == "serialnum")
+            m_entry.serialnum = static_cast<DWORD>(value);
+        else if (m_key == "visitCount")
+            m_entry.visitCount = static_cast<uint32_t>(value);
+        else if (m_key == "score")
+            m_entry.score = static_cast<double>(value);
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDJsonImporter::Float (double value) {
+
+    // Handles floating-point values, which are history entry scores.
+    //----------------------------------------------------------------------------------------------
+
+    if (In(Scope::Entry) && (m_key == "score"))
+        m_entry.score = value;
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDJsonImporter::parse_error (std::size_t position, const std::string&,
+                                  const nlohmann::detail::exception& ex) {
+
+    // Records the parse error and stops the parse.
+    //----------------------------------------------------------------------------------------------
+
+    m_error = ex.what();
+    (void) position;
+
+    return false;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::ExportJson (const string& jsonName) const {
+
+    // Writes the data file settings and the full history to the named JSON file. See the JSON
+    // Import / Export description above. A path that isn't valid in the active code page is
+    // written with its bad bytes replaced, rather than failing the export.
+    //----------------------------------------------------------------------------------------------
+
+    FILE* jsonFile;
+
+    if (0 != fopen_s (&jsonFile, jsonName.c_str(), "wb")) {
+        ErrorPrint ("Couldn't create export file \"%s\".", jsonName.c_str());
+        return false;
+    }
+
+    static char buffer [1 << 16];
+    setvbuf (jsonFile, buffer, _IOFBF, sizeof(buffer));
+
+    auto& header = Header();
+
+    json settings = {
+        {"maxHistSize", header.maxHistSize},
+        {"dirEcho",     header.dirEcho},
+        {"verbose",     header.verbose},
+        {"netSearch",   header.netSearch},
+        {"automap",     header.automap}
+    };
+
+    fprintf (jsonFile, "{\n  \"format\": \"%s\",\n  \"version\": %d,\n  \"settings\": %s,\n  \"history\": [",
+             c_jsonFormatName, c_jsonFormatVersion, settings.dump().c_str());
+
+    struct ExportState {
+        FILE*  file;
+        size_t count;
+        string error;
+    } state { jsonFile, 0, string() };
+
+    VisitHistory ([](const JDHistoryItem& item, void* userData) {
+        auto state = static_cast<ExportState*>(userData);
+
+        string path;
+
+        if (!ConvertCodePage (CP_ACP, CP_UTF8, item.path, path))
+            path = item.path;
+
+        json entry = {
+            {"path",       path},
+            {"lastVisit",  item.lastVisit},
+            {"serialnum",  item.serialnum},
+            {"visitCount", item.visitCount},
+            {"score",      item.score}
+        };
+
+        try {
+            auto text = entry.dump (-1, ' ', false, json::error_handler_t::replace);
+            fprintf (state->file, "%s\n    %s", (state->count++ ? "," : ""), text.c_str());
+        } catch (const json::exception& ex) {
+            state->error = ex.what();
+            return false;
+        }
+
+        return true;
+    }, &state);
+
+    fputs ("\n  ]\n}\n", jsonFile);
+
+    bool written = !ferror (jsonFile);
+
+    if (0 != fclose (jsonFile))
+        written = false;
+
+    if (!state.error.empty()) {
+        ErrorPrint ("Couldn't export history entry %zu: %s.", state.count + 1, state.error.c_str());
+        return false;
+    }
+
+    if (!written) {
+        ErrorPrint ("Error while writing export file \"%s\".", jsonName.c_str());
+        return false;
+    }
+
+    DPrint ("Exported %zu history entries to \"%s\".", state.count, jsonName.c_str());
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JumpData::ImportJson (const string& filename, const string& jsonName) {
+
+    // Replaces the data file settings and history with the contents of the named JSON file (see
+    // JSON Import / Export). Journaled visits are discarded, since the imported history supersedes
+    // them.
+    //----------------------------------------------------------------------------------------------
+
+    FILE* jsonFile;
+
+    if (0 != fopen_s (&jsonFile, jsonName.c_str(), "rb")) {
+        ErrorPrint ("Couldn't open import file \"%s\".", jsonName.c_str());
+        return false;
+    }
+
+    static char buffer [1 << 16];
+    setvbuf (jsonFile, buffer, _IOFBF, sizeof(buffer));
+
+    JDFileHeader    settings;
+    vector<JDVisit> visits;
+    JDJsonImporter  importer {settings, visits};
+
+    auto parsed = json::sax_parse (jsonFile, &importer);
+
+    fclose (jsonFile);
+
+    if (!parsed || !importer.FormatSeen()) {
+        ErrorPrint ("Couldn't import \"%s\": %s.", jsonName.c_str(),
+                    importer.Error().empty() ? "not a jumpdir history file" : importer.Error().c_str());
+        return false;
+    }
+
+    auto lock = LockDataFile (filename);
+
+    if (lock == INVALID_HANDLE_VALUE) {
+        ErrorPrint ("Data file \"%s\" is busy; try again.", filename.c_str());
+        return false;
+    }
+
+    Unload();
+    m_defaultHeader = settings;
+
+    JDMappedFile controlFile;
+
+    auto success = OpenControlBlock (filename, controlFile) && PublishSnapshot (filename, visits);
+
+    if (success) {
+        auto control = static_cast<JDControlBlock*>(controlFile.MutableData());
+
+        InterlockedIncrement64 (&control->journalSeq);
+        DeleteFileA ((filename + ".jnl.old").c_str());
+        DeleteFileA ((filename + ".jnl").c_str());
+        InterlockedIncrement64 (&control->journalSeq);
+
+        DPrint ("Imported %zu history entries from \"%s\".", visits.size(), jsonName.c_str());
+
+        if (importer.Skipped())
+            ErrorPrint ("Skipped %zu history entries with unusable paths.", importer.Skipped());
+    }
+
+    CloseHandle (lock);
+
+    return success && Load (filename);
+}
+
+
+
+//======================================================================================================================
+// Search Aggressiveness
+//
+// Each jump runs under a search budget (see SearchBudget), set by the search aggressiveness level (--search). The
+// levels are ordered by how long a jump can take: matching against the history alone is fast, probing the local disk
+// for directories never visited costs a directory lookup per candidate, and probing network paths can cost a server
+// round trip per candidate. Even the most thorough level has a deadline, so a jump never hangs the prompt. The history
+// strategies charge each matching entry to the budget, and stop once the deadline or the match limit is reached.
+//======================================================================================================================
+
+struct JDSearchLevel {
+    const char* name;               // Level name, as given to --search
+    uint32_t    milliseconds;       // Deadline for the whole jump (0 = none)
+    size_t      maxDirectories;     // Most directories probed (0 = no limit)
+    size_t      maxMatches;         // Most history entries matched (0 = no limit)
+    size_t      maxCandidates;      // Most candidates each probing strategy considers (0 = no limit)
+    bool        probeDisk;          // Try the strategies that probe for unvisited directories ([5] and [6])
+    bool        probeNetwork;       // Probe network paths even if netSearch is off
+};
+
+static const JDSearchLevel c_searchLevels[] = {
+    { "quick",      250,     0,  1024,    0,  false,  false },
+    { "normal",    2000,  4096, 16384, 1024,   true,  false },
+    { "thorough", 10000,     0,     0,    0,   true,   true },
+};
+
+static const JDSearchLevel& c_defaultSearchLevel = c_searchLevels[1];
+
+
+
+//======================================================================================================================
+// Class JDContext
+//======================================================================================================================
+
+class JDContext {
+    //--------------------------------------------------------------------------
+    // The main data context structure for the jumpdir program.
+    //--------------------------------------------------------------------------
+
+  public:
+
+    static const int c_numDrives = 26;
+
+    JDContext (FileSysProxy&);
+    ~JDContext() {};
+
+    bool ParseArgs (int argc, const char* const argv[]);
+    bool ScanEnvironment ();
+    bool ScanDrives ();
+
+    bool Load ();
+    bool Store ();
+
+    bool HasDataCommand () const { return m_dataCommand != DataCommand::None; }
+    bool RunDataCommand ();
+    bool ListHistory ();
+    void StartBackgroundCompaction ();
+
+    void EnumerateNetMaps ();
+
+    bool HandleTrivialChange();
+    bool Jump ();
+    bool WildcardMatch ();
+    bool SparseMatch ();
+    bool TailMatch ();
+    bool PartialPathMatch ();
+    bool ChildMatch ();
+    bool ChangeTo (const char* path);
+    void RecordVisit ();
+
+  private:
+
+    bool BudgetSpent ();
+
+    enum class DataCommand {           // Data file maintenance commands
+        None, Compact, ExportJson, ImportJson, List, Purge
+    };
+
+    FileSysProxy& m_fsProxy;           // File System Proxy
+
+    bool AppendDest (const char*);     // Appends Path to Destination
+
+    string   m_dbFilename;             // Jumpdir Data File Name
+    JumpData m_jumpData;               // Jump Directory Data
+
+    PathMatcher m_pathMatcher;         // Wildcard Path Matcher
+
+    char     m_cwd[MAX_PATH+1];        // Current Working Directory
+    char*    m_driveMaps[c_numDrives]; // Drive Network Mappings
+
+    char     m_dest[MAX_PATH+1];       // Specified Destination
+    int      m_destlen;                // Dest String Length
+    bool     m_destwild;               // Destination Contains Wildcards
+    bool     m_destsparse;             // Destination is a Sparse Pattern ('~' prefix)
+    bool     m_nearest;                // Prefer the match nearest the current directory
+
+    const JDSearchLevel* m_searchLevel;   // Search Aggressiveness Level
+    SearchBudget         m_budget;        // Search Budget of the current jump
+
+    DataCommand m_dataCommand;         // Data file command to run instead of jumping
+    string      m_dataCommandArg;      // File or pattern argument of the data file command
+};
+
+
+//--------------------------------------------------------------------------------------------------
+JDContext::JDContext (FileSysProxy& fsProxy)
+  : m_fsProxy{fsProxy}, m_pathMatcher{fsProxy} {
+
+    int drive;
+
+    for (drive=0;  drive < c_numDrives;  ++drive)
+        m_driveMaps[drive] = 0;
+
+    m_dest[0]  = 0;
+    m_destlen  = 0;
+    m_destwild = false;
+    m_destsparse = false;
+    m_nearest = false;
+    m_searchLevel = &c_defaultSearchLevel;
+    m_dataCommand = DataCommand::None;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::ParseArgs (int argc, const char* const argv[]) {
+
+    // Parses the command-line arguments before executing commands. This
+    // function is also responsible for reading in the data file.
+    //
+    // Parameter 'context' is the jumpdir context object. 'argc' and 'argv' are
+    // the standard command line arguments.
+    //
+    // Returns true if the parse succeeded, otherwise false.
+    //----------------------------------------------------------------------------------------------
+
+    int argi;     // Argument Index
+
+    for (argi=1;  argi < argc;  ++argi) {
+        if (  streqic (argv[argi], "-?")
+           || streqic (argv[argi], "/?")
+           || streqic (argv[argi], "-h")
+           || streqic (argv[argi], "/h")
+           || streqic (argv[argi], "--help")
+           )
+        {
+            PrintUsage();
+            continue;
+        }
+
+        if (streqic (argv[argi], "--compact")) {
+            m_dataCommand = DataCommand::Compact;
+            continue;
+        }
+
+        if (streqic (argv[argi], "--nearest")) {
+            m_nearest = true;
+            continue;
+        }
+
+        if (streqic (argv[argi], "--search")) {
+            if (argi + 1 >= argc) {
+                ErrorPrint ("Missing level for %s.", argv[argi]);
+                return false;
+            }
+
+            auto name = argv[++argi];
+            m_searchLevel = nullptr;
+
+            for (auto& level : c_searchLevels) {
+                if (streqic (name, level.name))
+                    m_searchLevel = &level;
+            }
+
+            if (!m_searchLevel) {
+                ErrorPrint ("Unknown search level (%s); use quick, normal or thorough.", name);
+                return false;
+            }
+
+            continue;
+        }
+
+        if (streqic (argv[argi], "--export-json") || streqic (argv[argi], "--import-json")) {
+            if (argi + 1 >= argc) {
+                ErrorPrint ("Missing file name for %s.", argv[argi]);
+                return false;
+            }
+
+            m_dataCommand = streqic (argv[argi], "--export-json") ? DataCommand::ExportJson
+                                                                 : DataCommand::ImportJson;
+            m_dataCommandArg = argv[++argi];
+            continue;
+        }
+
+        if (streqic (argv[argi], "--list") || streqic (argv[argi], "--purge")) {
+            if (argi + 1 >= argc) {
+                ErrorPrint ("Missing pattern for %s.", argv[argi]);
+                return false;
+            }
+
+            m_dataCommand = streqic (argv[argi], "--list") ? DataCommand::List : DataCommand::Purge;
+            m_dataCommandArg = argv[++argi];
+            continue;
+        }
+
+        if (argv[argi][0] == '-') {
+
+            switch (argv[argi][1]) {
+
+                case 'd': case 'D': {
+                    fDebug = 1;
+                    break;
+                }
+
+                default: {
+                    ErrorPrint ("Unrecognized command option (%s).", argv[argi]);
+                    exit (1);
+                    break;
+                }
+            }
+        } else {
+            if (!AppendDest (argv[argi]))
+                return false;
+        }
+    }
+
+    DPrint ("Debug flag on");
+    DPrint ("Destination \"%s\"", m_dest);
+    DPrint ("Destination is %swild.", m_destwild ? "" : "not ");
+    DPrint ("Destination is %ssparse.", m_destsparse ? "" : "not ");
+    DPrint ("Nearest match is %spreferred.", m_nearest ? "" : "not ");
+    DPrint ("Search level is \"%s\".", m_searchLevel->name);
+
+    // Return true to indicate success.
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::ScanEnvironment () {
+
+    // Scans the current environment and initializes the context object
+    // accordingly.  This includes the current working directory, the current
+    // drive mappings, the data file, and so forth.
+    //
+    // Returns true if the scan/initialization succeeded, otherwise false.
+    //--------------------------------------------------------------------------
+
+    // Load the current working directory.
+
+    if (!_getcwd (m_cwd, static_cast<int>(std::size(m_cwd))))
+        return false;
+
+    SlashForward (m_cwd);
+
+    if (!ScanDrives()) return false;
+
+    if (!Load()) return false;
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::ScanDrives () {
+
+    // Scan the currently mapped drives for type and other info. Returns True if
+    // the scan was successful, otherwise false.
+    //----------------------------------------------------------------------------------------------
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::Load () {
+
+    // Loads the jumpdir data file and initializes the related fields in the JDContext object.
+    //
+    // Returns True if the scan was successful, otherwise false.
+    //----------------------------------------------------------------------------------------------
+
+    DPrint ("Loading jump data.");
+
+    size_t jumpDataStrLength;
+
+    getenv_s (&jumpDataStrLength, NULL, 0, "JUMPDATA");
+
+    if (jumpDataStrLength) {
+
+        auto dbFilename = new char [jumpDataStrLength];
+
+        if (0 != getenv_s (&jumpDataStrLength, dbFilename, jumpDataStrLength, "JUMPDATA"))
+            return false;
+
+        m_dbFilename = dbFilename;
+
+        DPrint ("Using %%JUMPDATA%%=\"%s\"", m_dbFilename);
+    } else {
+        DPrint ("JUMPDATA is not defined.");
+
+        size_t userProfileStrLength;
+        getenv_s (&userProfileStrLength, NULL, 0, "USERPROFILE");
+
+        if (!userProfileStrLength) {
+            DPrint ("USERPROFILE is not defined. Hmmm, didn't expect THAT.");
+            ErrorPrint ("Couldn't find jumpdir.dat file. Neither JUMPDATA nor\nUSERPROFILE is defined.");
+            exit (1);
+        }
+
+        auto  userProfilePath = new char [userProfileStrLength];
+
+        if (0 != getenv_s (&userProfileStrLength, userProfilePath, userProfileStrLength, "USERPROFILE"))
+            return false;
+
+        m_dbFilename = userProfilePath;
+        m_dbFilename += "\\jumpdir.dat";
+
+        DPrint ("Using \"%s\"", m_dbFilename);
+    }
+
+    return m_jumpData.Load(m_dbFilename);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::Store () {
+
+    // Records the visit made by this jump (if any). If the visit journal has grown large enough,
+    // then kick off a compaction of the data file in the background.
+    //----------------------------------------------------------------------------------------------
+
+    if (!m_jumpData.Store(m_dbFilename))
+        return false;
+
+    if (m_jumpData.NeedsCompaction())
+        StartBackgroundCompaction();
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::RunDataCommand () {
+
+    // Runs the data file command given on the command line, in place of a jump:
+    //
+    //     --compact              Fold the visit journal into the data file (see Visit Journal)
+    //     --export-json <file>   Write the settings and history to a JSON file
+    //     --import-json <file>   Replace the settings and history from a JSON file
+    //     --list <pattern>       List the history entries that match the pattern
+    //     --purge <pattern>      Remove the history entries that match the pattern
+    //
+    // Returns true on success.
+    //----------------------------------------------------------------------------------------------
+
+    switch (m_dataCommand) {
+        case DataCommand::Compact:    return m_jumpData.Compact (m_dbFilename);
+        case DataCommand::ExportJson: return m_jumpData.ExportJson (m_dataCommandArg);
+        case DataCommand::ImportJson: return m_jumpData.ImportJson (m_dbFilename, m_dataCommandArg);
+        case DataCommand::List:       return ListHistory();
+        case DataCommand::Purge:      return m_jumpData.Compact (m_dbFilename, m_dataCommandArg.c_str());
+        default:                      return true;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::ListHistory () {
+
+    // Lists the history entries that match the --list pattern, most recent first. Like all output
+    // of this program, the list is written as shell commands (see j.cmd).
+    //----------------------------------------------------------------------------------------------
+
+    vector<JDVisit> matches;
+    m_jumpData.MatchHistory (m_dataCommandArg.c_str(), matches);
+
+    for (auto& visit : matches)
+        printf ("echo %s\n", visit.path.c_str());
+
+    DPrint ("Listed %zu history entries.", matches.size());
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JDContext::StartBackgroundCompaction () {
+
+    // Launches a detached copy of this program to compact the data file, so that the current jump
+    // completes without waiting. The new process inherits the environment (and thus JUMPDATA), but
+    // no handles, so it writes nothing to the launching shell.
+    //----------------------------------------------------------------------------------------------
+
+    char exePath [MAX_PATH+1];
+
+    if (!GetModuleFileNameA (NULL, exePath, static_cast<DWORD>(std::size(exePath))))
+        return;
+
+    string commandLine = "\"" + string(exePath) + "\" --compact";
+
+    STARTUPINFOA        startupInfo {};
+    PROCESS_INFORMATION processInfo {};
+
+    startupInfo.cb = sizeof(startupInfo);
+
+    if (!CreateProcessA (exePath, &commandLine[0], NULL, NULL, FALSE,
+                         DETACHED_PROCESS | CREATE_NEW_PROCESS_GROUP, NULL, NULL,
+                         &startupInfo, &processInfo)) {
+        DPrint ("Couldn't launch background compaction.");
+        return;
+    }
+
+    DPrint ("Launched background compaction.");
+
+    CloseHandle (processInfo.hThread);
+    CloseHandle (processInfo.hProcess);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JDContext::EnumerateNetMaps () {
+    DPrint ("Enumerating network drive mappings.");
+
+    // char driveStr[] = "X:";
+    // char netName [MAX_PATH + 1];
+    int  driveNum;
+
+    for (driveNum=0;  driveNum < c_numDrives;  ++driveNum) {
+    }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::HandleTrivialChange () {
+
+    // This routine handles trivial target directories. This includes null directories, and
+    // non-wildcard directories that begin with '.' or '..'. This routine assumes that the
+    // m_destwild member variable has already been set properly.
+    //----------------------------------------------------------------------------------------------
+
+    DPrint ("Trivial change?");
+
+    // Bail out if the destination path contains wildcard characters.
+
+    if (m_destwild) {
+        DPrint ("Not trivial; destination path contains wildcards.");
+        return false;
+    }
+
+    // If no directory was specified, and if no other commands were supplied,
+    // then echo the current directory.
+
+    if (m_dest[0] == 0) {
+        DPrint ("Null directory; echo current.");
+        printf ("echo %s\n", m_cwd);
+        return true;
+    }
+
+    // If this is not a dot directory; then handle elsewhere.
+
+    if (m_dest[0] != '.') {
+        DPrint ("Not trivial (not null and not dot directory).");
+        return false;
+    }
+
+    // If the directory is literally ".", we're already there, so return true.
+
+    if (0 == strcmp(m_dest, ".")) {
+        DPrint ("Literally '.'; no action.");
+        return true;
+    }
+
+    // If this is a path that begins with a single dot directory, then use that
+    // path directly.
+
+    if (m_dest[1] == '/') {
+        SlashBackward (m_dest);
+        printf ("cd \"%s\"\n", m_dest);
+        return true;
+    }
+
+    if (m_dest[1] != '.')   // Something else that begins with a dot.
+        return false;
+
+    // If the first subdirectory is "..", then use that path directly.
+
+    if ((m_dest[2] == 0) || (m_dest[2] == '/')) {
+        SlashBackward (m_dest);
+        printf ("cd \"%s\"\n", m_dest);
+        return true;
+    }
+
+    return false;           // For all other paths, handle elsewhere.
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::Jump () {
+
+    // Jumps to the destination directory. Strategies are tried in the order given in setdir.md:
+    // [1] Wildcard Match (only, for wildcard destinations), [2] Straight Match, [4] Tail Match,
+    // [5] Partial Path Match, [6] Child Match. A destination that begins with '~' is instead a
+    // sparse pattern, which gets only the Sparse Match. Where a strategy matches several history
+    // entries, the one with the highest frecency wins, or with --nearest, the one fewest hops from
+    // the current directory.
+    //
+    // The jump runs under the budget of the search level (see Search Aggressiveness), which the
+    // history strategies charge too. Strategies [5] and [6] are skipped at levels that don't probe
+    // the disk, and no further strategy is tried once the budget is spent.
+    //
+    // Returns true if a match was found, and the function successfully changed to that matching
+    // directory.
+    //----------------------------------------------------------------------------------------------
+
+    m_budget.Start (m_searchLevel->milliseconds, m_searchLevel->maxDirectories, m_searchLevel->maxMatches);
+    m_jumpData.SetSearchBudget (&m_budget);
+
+    if (HandleTrivialChange()) return true;
+
+    DPrint ("Seeing if new target matches current directory.");
+
+    if (0 == _stricmp(m_cwd, m_dest)) {
+        DPrint ("Tried to change to same directory as current.");
+        return false;
+    }
+
+    if (m_destsparse) {
+        if (SparseMatch())
+            return true;
+
+        BudgetSpent();
+        return false;
+    }
+
+    if (m_destwild) {
+        if (WildcardMatch())
+            return true;
+
+        BudgetSpent();
+        return false;
+    }
+
+    DPrint ("Straight Match?");
+
+    if (ChangeTo (m_dest))
+        return true;
+
+    if (TailMatch())
+        return true;
+
+    if (BudgetSpent())
+        return false;
+
+    if (!m_searchLevel->probeDisk) {
+        DPrint ("Skipping Partial Path and Child matches (search level \"%s\").", m_searchLevel->name);
+        DPrint ("No match found.");
+        return false;
+    }
+
+    if (PartialPathMatch())
+        return true;
+
+    if (BudgetSpent())
+        return false;
+
+    if (ChildMatch())
+        return true;
+
+    if (BudgetSpent())
+        return false;
+
+    DPrint ("No match found.");
+
+    return false;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::BudgetSpent () {
+
+    // Returns true if the jump's search budget is spent, and reports which limit cut the search.
+    //----------------------------------------------------------------------------------------------
+
+    if (!m_budget.Spent())
+        return false;
+
+    DPrint ("No match found: search cut short by the %s budget (%zu directories probed, %zu matches).",
+        SearchBudget::LimitName (m_budget.Cut()), m_budget.Directories(), m_budget.Matches());
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::WildcardMatch () {
+
+    // Strategy [1]: tests the wildcard destination against every history entry, and jumps to the
+    // best match (by frecency). The current directory never matches.
+    //----------------------------------------------------------------------------------------------
+
+    DPrint ("Wildcard Match: Been somewhere matching \"%s\"?", m_dest);
+
+    string match;
+
+    auto found = m_jumpData.BestWildcardMatch (m_dest, [](const JDHistoryItem& item, void* userData) {
+        return 0 != _stricmp (item.path, static_cast<const char*>(userData));
+    }, m_cwd, match, m_nearest ? m_cwd : nullptr);
+
+    if (!found) {
+        DPrint ("No.");
+        return false;
+    }
+
+    return ChangeTo (match.c_str());
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::SparseMatch () {
+
+    // Sparse Match: looks for history entries that hold the characters after the destination's
+    // leading '~' in order, with anything between them, and jumps to the best of them (see
+    // BestSparseMatch). The current directory never matches.
+    //----------------------------------------------------------------------------------------------
+
+    DPrint ("Sparse Match: Been somewhere holding \"%s\" in order?", m_dest + 1);
+
+    string match;
+
+    auto found = m_jumpData.BestSparseMatch (m_dest + 1, [](const JDHistoryItem& item, void* userData) {
+        return 0 != _stricmp (item.path, static_cast<const char*>(userData));
+    }, m_cwd, match, m_nearest ? m_cwd : nullptr);
+
+    if (!found) {
+        DPrint ("No.");
+        return false;
+    }
+
+    return ChangeTo (match.c_str());
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::TailMatch () {
+
+    // Strategy [4]: looks for history entries that end in the destination string (without regard
+    // to case), and jumps to the best of them (by frecency). The current directory never matches.
+    //----------------------------------------------------------------------------------------------
+
+    DPrint ("Tail Match: Been somewhere ending in \"%s\"?", m_dest);
+
+    string match;
+
+    auto found = m_jumpData.BestTailMatch (m_dest, [](const JDHistoryItem& item, void* userData) {
+        return 0 != _stricmp (item.path, static_cast<const char*>(userData));
+    }, m_cwd, match, m_nearest ? m_cwd : nullptr);
+
+    if (!found) {
+        DPrint ("No.");
+        return false;
+    }
+
+    return ChangeTo (match.c_str());
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::PartialPathMatch () {
+
+    // Strategy [5]: looks for the destination hanging off a directory on the way to some visited
+    // directory (see PartialPathCandidates), and jumps to the first candidate that exists. The
+    // candidates are probed concurrently (see FirstExistingDirectory). The current directory never
+    // matches.
+    //----------------------------------------------------------------------------------------------
+
+    DPrint ("Partial Path Match: Does \"%s\" line up with part of a visited path?", m_dest);
+
+    if ((m_dest[0] == '/') || strchr (m_dest, ':')) {
+        DPrint ("No (destination is rooted).");
+        return false;
+    }
+
+    vector<string> lineups;
+    m_jumpData.PartialPathCandidates (m_dest, lineups);
+
+    auto netSearch = m_jumpData.Header().netSearch || m_searchLevel->probeNetwork;
+
+    if (!netSearch)
+        DPrint ("(Skipping network paths.)");
+
+    vector<string> candidates;
+
+    for (auto& candidate : lineups) {
+        if (!netSearch && (candidate[0] == '/') && (candidate[1] == '/'))
+            continue;
+
+        if (0 == _stricmp (candidate.c_str(), m_cwd))
+            continue;
+
+        if (m_searchLevel->maxCandidates && (candidates.size() == m_searchLevel->maxCandidates)) {
+            DPrint ("(Considering only the first %zu candidates.)", candidates.size());
+            break;
+        }
+
+        candidates.push_back (std::move (candidate));
+    }
+
+    auto winner = FirstExistingDirectory (candidates, m_budget);
+
+    for (size_t i=0;  fDebug && (i < candidates.size()) && (i <= winner);  ++i)
+        DPrint ("Trying %s", candidates[i].c_str());
+
+    if (winner == candidates.size()) {
+        DPrint ("No.");
+        return false;
+    }
+
+    return ChangeTo (candidates[winner].c_str());
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::ChildMatch () {
+
+    // Strategy [6]: looks for the destination as a subdirectory of each history entry, and jumps to
+    // the first that exists, taking entries by rank (see JDMatchSelector). The candidates are probed
+    // concurrently (see FirstExistingDirectory). The current directory never matches.
+    //----------------------------------------------------------------------------------------------
+
+    DPrint ("Child Match: Subdirs of visited paths?");
+
+    if ((m_dest[0] == '/') || strchr (m_dest, ':')) {
+        DPrint ("No (destination is rooted).");
+        return false;
+    }
+
+    vector<JDVisit> history;
+    m_jumpData.CopyHistory (history);
+
+    auto now = static_cast<int64_t>(time(nullptr));
+
+    std::stable_sort (history.begin(), history.end(), [now](const JDVisit& a, const JDVisit& b) {
+        auto aFrecency = DecayedScore (a.score, a.time, now);
+        auto bFrecency = DecayedScore (b.score, b.time, now);
+        return (aFrecency > bFrecency) || ((aFrecency == bFrecency) && (a.time > b.time));
+    });
+
+    auto netSearch = m_jumpData.Header().netSearch || m_searchLevel->probeNetwork;
+
+    if (!netSearch)
+        DPrint ("(Skipping network paths.)");
+
+    vector<string> children;
+
+    for (auto& visit : history) {
+        if (!netSearch && (visit.path[0] == '/') && (visit.path[1] == '/'))
+            continue;
+
+        auto child = visit.path;
+
+        if (child.back() != '/')
+            child += '/';
+
+        child += m_dest;
+
+        if (0 == _stricmp (child.c_str(), m_cwd))
+            continue;
+
+        if (m_searchLevel->maxCandidates && (children.size() == m_searchLevel->maxCandidates)) {
+            DPrint ("(Considering only the first %zu candidates.)", children.size());
+            break;
+        }
+
+        children.push_back (std::move (child));
+    }
+
+    auto winner = FirstExistingDirectory (children, m_budget);
+
+    for (size_t i=0;  fDebug && (i < children.size()) && (i <= winner);  ++i)
+        DPrint ("Trying %s", children[i].c_str());
+
+    if (winner == children.size()) {
+        DPrint ("No.");
+        return false;
+    }
+
+    return ChangeTo (children[winner].c_str());
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::ChangeTo (const char* path) {
+
+    // Changes to the given directory, emits the shell command to do the same, and records the visit.
+    //
+    // Returns true if the directory change succeeded.
+    //----------------------------------------------------------------------------------------------
+
+    DPrint ("Attempting to change to \"%s\".", path);
+
+    if (0 != _chdir(path)) {
+        DPrint ("Attempt failed.");
+        return false;
+    }
+
+    DPrint ("Successfully changed to \"%s\".", path);
+    printf ("cd /d %s\n", path);
+    RecordVisit();
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+void JDContext::RecordVisit () {
+
+    // Records the current working directory (which the jump has just changed to) in the history.
+    //----------------------------------------------------------------------------------------------
+
+    char visited [MAX_PATH+1];
+
+    if (!_getcwd (visited, static_cast<int>(std::size(visited))))
+        return;
+
+    SlashForward (visited);
+
+    m_jumpData.RecordVisit (visited, VolumeSerialNumber(visited));
+}
+
+
+//--------------------------------------------------------------------------------------------------
+bool JDContext::AppendDest (const char* path) {
+    size_t roomleft = sizeof(m_dest) - m_destlen - 1;
+
+    if (m_destlen > 0) roomleft -= 1;
+
+    if (strlen(path) > roomleft) return false;
+
+    if (m_destlen > 0)
+        m_dest[m_destlen++] = ' ';
+    else if (*path == '~')
+        m_destsparse = true;
+
+    for (;  *path != 0;  ++path, ++m_destlen) {
+
+        if (!m_destwild && isWildStr(path))
+            m_destwild = true;
+
+        if (*path == '\\')
+            m_dest[m_destlen] = '/';
+        else
+            m_dest[m_destlen] = *path;
+    }
+
+    m_dest[m_destlen] = 0;
+
+    return true;
+}
+
+
+
+//======================================================================================================================
+// Main Program
+//======================================================================================================================
+
+// int wmain (int argc, const wchar_t* const argv[]) {
+int main (int argc, const char* const argv[]) {
+
+    // The main entry point for the jumpdir program. Returns the return code for the entire program.
+
+    FileSysProxyWindows fsProxy;
+
+    JDContext context {fsProxy};
+
+    if (!context.ParseArgs(argc, argv)) return 1;
+    if (!context.ScanEnvironment()) return 1;
+
+    if (context.HasDataCommand())
+        return context.RunDataCommand() ? 0 : 1;
+
+    if (!context.Jump()) return 1;
+    if (!context.Store()) return 1;
+
+    return 0;
+}
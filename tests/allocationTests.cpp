@@ -0,0 +1,124 @@
+//==================================================================================================
+// allocationTests.cpp
+//
+//     AllocationTest: Counts the heap allocations made by warm PathMatcher traversals. The global
+//     operator new is replaced by one that counts each allocation, and an in-memory file system
+//     proxy (see memoryFileSys.h) serves two balanced directory trees, one many times the size of
+//     the other. Once the matcher's buffers, iterator slots and fetch directories have grown to
+//     fit, a traversal may make a fixed number of allocations per match, but none per directory,
+//     so the same patterns must allocate no more on the large tree than on the small one.
+//==================================================================================================
+
+#include "tests.h"
+#include "memoryFileSys.h"
+#include <pathmatcher.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+using std::wstring;
+using namespace FSProxy;
+
+
+static std::atomic<long> g_allocations { 0 };   // Heap allocations made so far
+
+void* operator new (size_t size)
+{
+    ++g_allocations;
+
+    if (auto block = malloc (size ? size : 1))
+        return block;
+
+    throw std::bad_alloc();
+}
+
+void operator delete (void* block) noexcept { free (block); }
+void operator delete (void* block, size_t) noexcept { free (block); }
+
+
+
+bool AllocationTest (const TestArgs&)
+{
+    static const int c_warmUpRuns   { 10 };   // Matches made before counting
+    static const int c_measuredRuns { 10 };   // Matches counted
+
+    const wchar_t* patterns[] =
+    {
+        L"R/*/*/*/*/*/*/*/file.txt",   // Directory by directory
+        L"R/d*/d*/d*/.../file.txt",    // Directory by directory, then a small fetch below each
+        L"R/...",                      // One fetch of the whole tree
+    };
+
+    struct Counts
+    {
+        long fewest;   // Fewest allocations made by one measured match
+        long total;    // Allocations made by all the measured matches
+    };
+
+    // Returns the allocation counts of warm matches of the pattern against the tree.
+
+    auto measure = [&] (MemoryFileSys& fileSys, const wchar_t* pattern)
+    {
+        PMatcher::PathMatcher matcher { fileSys };
+        Counts counts { LONG_MAX, 0 };
+
+        auto callback = [] (const wchar_t*, const DirectoryIterator&, void*) { return true; };
+
+        for (int run = 0;  run < c_warmUpRuns + c_measuredRuns;  ++run)
+        {
+            auto before = g_allocations.load();
+            matcher.Match (pattern, callback, nullptr);
+            auto allocations = g_allocations.load() - before;
+
+            if (run >= c_warmUpRuns)
+            {
+                counts.fewest = std::min (counts.fewest, allocations);
+                counts.total += allocations;
+            }
+        }
+
+        return counts;
+    };
+
+    MemoryFileSys small { 3, 3 };
+    MemoryFileSys large { 6, 4 };
+
+    auto passed = true;
+
+    printf ("    %-26s %20s %20s\n", "Pattern", "Small tree allocs", "Large tree allocs");
+
+    for (auto pattern : patterns)
+    {
+        auto smallCounts = measure (small, pattern);
+        auto largeCounts = measure (large, pattern);
+
+        wstring shown = pattern;
+        auto    name  = std::string (shown.begin(), shown.end());
+
+        printf ("    %-26s %9ld (%8ld) %9ld (%8ld)\n", name.c_str(), smallCounts.fewest,
+                smallCounts.total, largeCounts.fewest, largeCounts.total);
+
+        // A warm match may allocate a fixed amount, but nothing per directory. A parallel fetch
+        // may still add the odd spare directory when it runs further ahead than ever before, so
+        // the measured matches together need only make fewer allocations than the tree has
+        // directories.
+
+        if (largeCounts.fewest > smallCounts.fewest)
+            passed = Fail ("\"%s\" made %ld allocations on %zu directories, but %ld on %zu",
+                           name.c_str(), largeCounts.fewest, large.NumDirectories(),
+                           smallCounts.fewest, small.NumDirectories());
+
+        if (static_cast<size_t> (largeCounts.total) >= large.NumDirectories())
+            passed = Fail ("\"%s\" made %ld allocations in %d warm matches of %zu directories",
+                           name.c_str(), largeCounts.total, c_measuredRuns,
+                           large.NumDirectories());
+    }
+
+    return passed;
+}
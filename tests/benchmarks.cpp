@@ -0,0 +1,304 @@
+//==================================================================================================
+// benchmarks.cpp
+//
+//     Microbenchmarks of the pattern matchers on real-world path lengths. Each benchmark pattern is
+//     compiled once and matched against a set of generated paths, and again by the reference
+//     (character-at-a-time) matcher; the time per match of each is printed with the speedup. Most
+//     of the benchmark patterns are dominated by literal runs, which the compiled pattern tests
+//     with the literal run kernels (SSE2 or AVX2 on x86 and x64, scalar elsewhere) before stepping
+//     its NFA.
+//
+//     KernelBenchmarkTest times the literal run kernels themselves, searching the same paths for
+//     literals in each kernel form (scalar, SSE2 and AVX2) this machine supports, or only in the
+//     form named on the command line. Each form's time is compared with the scalar form's.
+//
+//     Timings depend on the machine and the build, so the benchmarks fail only if the compiled and
+//     reference matchers (or the kernel forms) disagree. Timings from an unoptimized build say
+//     little. Usage:
+//
+//         jumpdirTests benchmarks [rounds]
+//         jumpdirTests kernels [rounds] [scalar|sse2|avx2]
+//==================================================================================================
+
+#include "tests.h"
+#include <pathmatcher.h>
+
+#include <chrono>
+#include <iterator>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using std::wstring;
+
+typedef PMatcher::CompiledPattern::Syntax Syntax;
+typedef PMatcher::KernelForm KernelForm;
+
+
+static const size_t c_numPaths      { 2000 };   // Generated paths matched by each benchmark
+static const int    c_defaultRounds { 20 };     // Times each benchmark runs through the paths
+
+
+
+static std::vector<wstring> GeneratePaths ()
+{
+    //----------------------------------------------------------------------------------------------
+    // Returns paths like those in a jumpdir history: mostly project directories under the user's
+    // home, from about 30 to 260 characters long, in a mix of letter cases.
+    //----------------------------------------------------------------------------------------------
+
+    const wchar_t* roots[] = {
+        L"C:/Users/steve/source/repos/", L"C:/Program Files (x86)/Microsoft Visual Studio/",
+        L"D:/Work/Clients/", L"C:/Users/steve/AppData/Local/Temp/", L"E:/Archive/2019/"
+    };
+
+    const wchar_t* names[] = {
+        L"src", L"components", L"widgets", L"Common", L"include", L"test", L"Debug", L"x64",
+        L"node_modules", L"ThirdParty", L"Icecap", L"build", L"Release", L"docs", L"internal",
+        L"PathMatcher", L"jumpdir", L"Tools", L"scripts", L"lib"
+    };
+
+    const wchar_t* leaves[] = {
+        L"Button.cpp", L"main.cpp", L"widget.h", L"README.md", L"CMakeLists.txt", L"setup.py"
+    };
+
+    std::mt19937 random { 1234 };
+    std::vector<wstring> paths;
+
+    while (paths.size() < c_numPaths)
+    {
+        wstring path = roots [random() % std::size(roots)];
+        path += L"project" + std::to_wstring (random() % 100) + L"/";
+
+        for (auto depth = 2 + random() % 14;  depth;  --depth)
+            path += wstring (names [random() % std::size(names)]) + L"/";
+
+        path += leaves [random() % std::size(leaves)];
+
+        if (path.size() <= 260)
+            paths.push_back (path);
+    }
+
+    return paths;
+}
+
+
+
+static bool ReferenceMatch (Syntax syntax, const wchar_t* pattern, const wchar_t* string)
+{
+    switch (syntax)
+    {
+        case Syntax::Wild:              return Reference::wildComp (pattern, string);
+        case Syntax::WildCaseSensitive: return Reference::wildCompCaseSensitive (pattern, string);
+        default:                        return Reference::pathMatch (pattern, string);
+    }
+}
+
+
+
+template <typename Matcher>
+static double NanosecondsPerMatch (
+    const std::vector<wstring>& paths, int rounds, std::vector<char>& results, Matcher match)
+{
+    // Runs the matcher over the paths 'rounds' times, and returns the mean time per match. The
+    // results of the last round are left in 'results'.
+
+    results.assign (paths.size(), 0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int round = 0;  round < rounds;  ++round)
+        for (size_t i = 0;  i < paths.size();  ++i)
+            results[i] = match (paths[i].c_str());
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto ns      = std::chrono::duration<double, std::nano>(elapsed).count();
+
+    return ns / (static_cast<double>(rounds) * paths.size());
+}
+
+
+
+bool BenchmarkTest (const TestArgs& args)
+{
+    auto rounds = args.empty() ? c_defaultRounds : atoi (args[0].c_str());
+
+    if (rounds < 1)
+        return Fail ("usage: benchmarks [rounds]");
+
+    struct Benchmark
+    {
+        const char*    name;      // Benchmark description
+        Syntax         syntax;    // Matcher to use
+        const wchar_t* pattern;   // Pattern to match
+    };
+
+    const Benchmark benchmarks[] =
+    {
+        { "literal search, folded",   Syntax::Wild,              L"*icecap*"                     },
+        { "literal search, long",     Syntax::Wild,              L"*components/widgets/button*"  },
+        { "literal prefix, folded",   Syntax::Wild,              L"c:/users/steve/source/*"      },
+        { "literal search, exact",    Syntax::WildCaseSensitive, L"*PathMatcher*"                },
+        { "literals and wildcards",   Syntax::Wild,              L"*/src/*/test/*.cpp"           },
+        { "path with ellipses",       Syntax::Path,              L"c:/users/.../src/.../*.cpp"   },
+    };
+
+    auto paths  = GeneratePaths();
+    auto passed = true;
+
+    size_t totalLength = 0;
+
+    for (auto& path : paths)
+        totalLength += path.size();
+
+    printf ("%zu paths, %zu characters on average, %d rounds.\n\n",
+            paths.size(), totalLength / paths.size(), rounds);
+
+    printf ("    %-24s %-30s %8s %12s %12s %8s\n",
+            "Benchmark", "Pattern", "Matches", "Compiled ns", "Reference ns", "Speedup");
+
+    for (auto& benchmark : benchmarks)
+    {
+        PMatcher::CompiledPattern compiled { benchmark.pattern, benchmark.syntax };
+        std::vector<char> results, expected;
+
+        auto compiledNs = NanosecondsPerMatch (paths, rounds, results,
+            [&] (const wchar_t* path) { return compiled.Match (path); });
+
+        auto referenceNs = NanosecondsPerMatch (paths, rounds, expected,
+            [&] (const wchar_t* path) {
+                return ReferenceMatch (benchmark.syntax, benchmark.pattern, path);
+            });
+
+        size_t matches = 0;
+
+        for (size_t i = 0;  i < paths.size();  ++i)
+        {
+            matches += results[i] ? 1 : 0;
+
+            if (results[i] != expected[i])
+            {
+                auto& path = paths[i];
+                passed = Fail ("%s: the compiled pattern and the reference disagree on \"%s\"",
+                               benchmark.name, std::string (path.begin(), path.end()).c_str());
+            }
+        }
+
+        wstring pattern = benchmark.pattern;
+
+        printf ("    %-24s %-30s %8zu %12.1f %12.1f %7.1fx\n",
+                benchmark.name, std::string (pattern.begin(), pattern.end()).c_str(), matches,
+                compiledNs, referenceNs, referenceNs / compiledNs);
+    }
+
+    return passed;
+}
+
+
+
+bool KernelBenchmarkTest (const TestArgs& args)
+{
+    struct Form
+    {
+        const char* name;   // Form name, as given on the command line
+        KernelForm  form;   // Kernel form
+    };
+
+    const Form forms[] =
+    {
+        { "scalar", KernelForm::Scalar },
+        { "sse2",   KernelForm::SSE2   },
+        { "avx2",   KernelForm::AVX2   },
+    };
+
+    auto rounds = (args.size() < 1) ? c_defaultRounds : atoi (args[0].c_str());
+    auto only   = (args.size() < 2) ? nullptr : args[1].c_str();
+
+    // Run the named form, or else every supported form.
+
+    std::vector<Form> selected;
+
+    for (auto& form : forms)
+    {
+        if (only ? (0 == strcmp (form.name, only)) : PMatcher::KernelFormSupported (form.form))
+            selected.push_back (form);
+    }
+
+    if ((rounds < 1) || (args.size() > 2) || selected.empty())
+        return Fail ("usage: kernels [rounds] [scalar|sse2|avx2]");
+
+    if (!PMatcher::KernelFormSupported (selected[0].form))
+        return Fail ("The %s kernels are not supported on this machine.", selected[0].name);
+
+    struct Literal
+    {
+        const wchar_t* text;   // Literal to find (lower case if folded)
+        bool           fold;   // True => fold the searched paths
+    };
+
+    const Literal literals[] =
+    {
+        { L"icecap",                     true  },
+        { L"components/widgets/button",  true  },
+        { L"PathMatcher",                false },
+        { L"/x64/",                      true  },
+    };
+
+    auto paths  = GeneratePaths();
+    auto passed = true;
+
+    printf ("    %-28s %-7s %8s %12s %8s\n", "Literal", "Form", "Matches", "ns", "Speedup");
+
+    for (auto& literal : literals)
+    {
+        auto count = wcslen (literal.text);
+
+        // Times one kernel form, leaving its results in 'results'.
+
+        auto measure = [&] (KernelForm form, std::vector<char>& results)
+        {
+            return NanosecondsPerMatch (paths, rounds, results, [&] (const wchar_t* path) {
+                return PMatcher::FindLiteral (
+                    form, path, wcslen (path), literal.text, count, literal.fold);
+            });
+        };
+
+        std::vector<char> expected;
+        auto scalarNs = measure (KernelForm::Scalar, expected);
+
+        wstring text = literal.text;
+        auto    name = std::string (text.begin(), text.end()) + (literal.fold ? "" : " (exact)");
+
+        for (auto& form : selected)
+        {
+            auto results = expected;
+            auto formNs  = scalarNs;
+
+            if (form.form != KernelForm::Scalar)
+                formNs = measure (form.form, results);
+
+            size_t matches = 0;
+
+            for (size_t i = 0;  i < paths.size();  ++i)
+            {
+                matches += results[i] ? 1 : 0;
+
+                if (results[i] != expected[i])
+                {
+                    auto& path = paths[i];
+                    passed = Fail ("%s: the %s and scalar kernels disagree on \"%s\"",
+                                   name.c_str(), form.name,
+                                   std::string (path.begin(), path.end()).c_str());
+                }
+            }
+
+            printf ("    %-28s %-7s %8zu %12.1f %7.1fx\n",
+                    name.c_str(), form.name, matches, formNs, scalarNs / formNs);
+        }
+    }
+
+    return passed;
+}
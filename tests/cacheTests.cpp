@@ -0,0 +1,315 @@
+//==================================================================================================
+// cacheTests.cpp
+//
+//     CacheTest: Checks the directory listing cache (FileSysProxyCache) against an in-memory file
+//     system whose directory times the test controls. A cached listing must be used only while
+//     its directory's times are unchanged, so adding or removing an entry must invalidate it, in
+//     this run or the next. A damaged cache file must be ignored, never trusted, and a directory
+//     changed within the racy window must be listed afresh every time, and never cached.
+//==================================================================================================
+
+#include "tests.h"
+#include <fileSystemProxyCache.h>
+
+#include <chrono>
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::wstring;
+using namespace FSProxy;
+
+
+static const char*    c_cacheFile { "jumpdirTests.dircache" };   // Cache file used by the test
+static const uint64_t c_second    { 1000000000 };                // Nanoseconds per second
+
+
+
+static uint64_t Now ()
+{
+    // Returns the current time, in nanoseconds since 1970-01-01 UTC.
+
+    auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch).count());
+}
+
+
+
+class TimedFileSys : public FileSysProxy
+{
+    //----------------------------------------------------------------------------------------------
+    // A file system proxy over in-memory directories of files, each with modification and status
+    // change times set by the test. Directories are keyed by path, without a trailing slash, and
+    // are listed by "<path>/*". Counts the listings made through it.
+    //----------------------------------------------------------------------------------------------
+
+  public:
+
+    struct Directory
+    {
+        std::vector<wstring> names;      // Entry names, in listing order
+        uint64_t             modified;   // Modification time
+        uint64_t             changed;    // Status change time
+    };
+
+    std::map<wstring, Directory> directories;   // Directories by path
+    mutable size_t               listings { 0 }; // Listings made
+
+    size_t maxPathLength () const override { return 260; }
+
+    DirectoryIterator* newDirectoryIterator (const wstring path) const override
+    {
+        ++listings;
+
+        auto found = directories.find (path.substr (0, path.size() - 2));
+        return new Iterator { (found == directories.end()) ? nullptr : &found->second };
+    }
+
+    bool directoryTimes (const wchar_t* path, uint64_t& modified, uint64_t& changed) const override
+    {
+        wstring key = path;
+
+        if (!key.empty() && ((key.back() == L'/') || (key.back() == L'\\')))
+            key.pop_back();
+
+        auto found = directories.find (key);
+
+        if (found == directories.end())
+            return false;
+
+        modified = found->second.modified;
+        changed  = found->second.changed;
+        return true;
+    }
+
+    bool setCurrentDirectory (const wstring) override { return true; }
+
+  private:
+
+    class Iterator : public DirectoryIterator
+    {
+      public:
+
+        explicit Iterator (const Directory* directory) : m_directory(directory) {}
+
+        bool next () override
+        {
+            return m_directory && (++m_index <= m_directory->names.size());
+        }
+
+        bool isDirectory () const override { return false; }
+        const wchar_t* name () const override { return m_directory->names[m_index - 1].c_str(); }
+
+      private:
+
+        const Directory* m_directory;     // Directory listed (null if none)
+        size_t           m_index { 0 };   // Current entry, plus one
+    };
+};
+
+
+
+static std::vector<wstring> List (const FileSysProxy& proxy, const wchar_t* path)
+{
+    // Returns the names listed by the proxy for the given path.
+
+    std::unique_ptr<DirectoryIterator> iterator { proxy.newDirectoryIterator (path) };
+    std::vector<wstring> names;
+
+    while (iterator->next())
+        names.push_back (iterator->name());
+
+    return names;
+}
+
+
+
+static bool Check (
+    const char* what, const FileSysProxy& cache, const TimedFileSys& live, const wchar_t* path,
+    bool listedLive)
+{
+    // Lists the path through the cache, and checks that it yields the live directory's entries,
+    // and that it did (or didn't) list the live directory to get them.
+
+    auto before = live.listings;
+    auto names  = List (cache, path);
+    auto passed = true;
+
+    wstring key = path;
+    key.resize (key.size() - 2);
+
+    if (names != live.directories.at(key).names)
+        passed = Fail ("%s: the cache listed %zu entries, but the directory holds %zu", what,
+                       names.size(), live.directories.at(key).names.size());
+
+    if ((live.listings != before) != listedLive)
+        passed = Fail ("%s: the directory was %slisted", what, listedLive ? "not " : "");
+
+    return passed;
+}
+
+
+
+static TimedFileSys SavedFileSys ()
+{
+    // Returns the file system whose listing is saved to test damaged cache files.
+
+    TimedFileSys fileSys;
+    fileSys.directories[L"C:/D"] = { { L"a.txt", L"b.txt", L"c.txt" }, c_second, c_second };
+    return fileSys;
+}
+
+
+
+static bool Corrupt (const char* what, const std::vector<char>& image)
+{
+    // Writes the given image as the cache file, and checks that a new cache ignores it, listing
+    // the directory afresh.
+
+    auto file = fopen (c_cacheFile, "wb");
+
+    if (!file)
+        return Fail ("%s: couldn't write \"%s\"", what, c_cacheFile);
+
+    fwrite (image.data(), 1, image.size(), file);
+    fclose (file);
+
+    auto live = SavedFileSys();
+
+    FileSysProxyCache cache { live };
+    cache.open (c_cacheFile);
+
+    auto passed = Check (what, cache, live, L"C:/D/*", true);
+
+    cache.open ("");   // Don't save over the damaged file.
+    return passed;
+}
+
+
+
+bool CacheTest (const TestArgs&)
+{
+    auto passed = true;
+    auto old    = Now() - 3600 * c_second;
+
+    remove (c_cacheFile);
+
+    TimedFileSys live;
+    live.directories[L"C:/D"] = { { L"a.txt", L"b.txt", L"c.txt" }, old, old };
+    live.directories[L"C:/E"] = { { L"x.txt" }, old, old };
+
+    // Within one run: a listing is cached, used while the times stand, and dropped when an entry
+    // is added or removed.
+    {
+        FileSysProxyCache cache { live };
+        cache.open (c_cacheFile);
+
+        passed = Check ("first listing", cache, live, L"C:/D/*", true) && passed;
+        passed = Check ("second listing", cache, live, L"C:/D/*", false) && passed;
+        passed = Check ("other directory", cache, live, L"C:/E/*", true) && passed;
+
+        live.directories[L"C:/D"].names.push_back (L"d.txt");
+        live.directories[L"C:/D"].modified = old + c_second;
+        passed = Check ("after an add", cache, live, L"C:/D/*", true) && passed;
+        passed = Check ("after an add, again", cache, live, L"C:/D/*", false) && passed;
+
+        live.directories[L"C:/D"].names.erase (live.directories[L"C:/D"].names.begin());
+        live.directories[L"C:/D"].changed = old + 2 * c_second;
+        passed = Check ("after a remove", cache, live, L"C:/D/*", true) && passed;
+
+        if (!cache.save())
+            passed = Fail ("couldn't save \"%s\"", c_cacheFile);
+    }
+
+    // In the next run: saved listings are used while their times stand, and dropped otherwise.
+    {
+        FileSysProxyCache cache { live };
+        cache.open (c_cacheFile);
+
+        passed = Check ("next run", cache, live, L"C:/D/*", false) && passed;
+
+        live.directories[L"C:/E"].names.push_back (L"y.txt");
+        live.directories[L"C:/E"].modified = old + c_second;
+        passed = Check ("next run, after an add", cache, live, L"C:/E/*", true) && passed;
+    }
+
+    // A directory changed within the racy window, or in the future, is listed afresh every time,
+    // and never cached.
+    {
+        TimedFileSys fresh;
+        fresh.directories[L"C:/R"] = { { L"r.txt" }, Now(), old };
+        fresh.directories[L"C:/F"] = { { L"f.txt" }, old, Now() + 3600 * c_second };
+
+        FileSysProxyCache cache { fresh };
+        cache.open (c_cacheFile);
+
+        passed = Check ("racy directory", cache, fresh, L"C:/R/*", true) && passed;
+        passed = Check ("racy directory, again", cache, fresh, L"C:/R/*", true) && passed;
+        passed = Check ("future directory", cache, fresh, L"C:/F/*", true) && passed;
+        passed = Check ("future directory, again", cache, fresh, L"C:/F/*", true) && passed;
+    }
+
+    // A damaged cache file is ignored. Save a good file holding one listing, then try every
+    // truncation of it, a bad signature, and trailing garbage.
+
+    remove (c_cacheFile);
+    {
+        auto one = SavedFileSys();
+
+        FileSysProxyCache cache { one };
+        cache.open (c_cacheFile);
+        List (cache, L"C:/D/*");
+
+        if (!cache.save())
+            passed = Fail ("couldn't save \"%s\"", c_cacheFile);
+    }
+
+    std::vector<char> image;
+
+    if (auto file = fopen (c_cacheFile, "rb"))
+    {
+        char   buffer [4096];
+        size_t nRead;
+
+        while (0 < (nRead = fread (buffer, 1, sizeof(buffer), file)))
+            image.insert (image.end(), buffer, buffer + nRead);
+
+        fclose (file);
+    }
+
+    if (image.empty())
+        passed = Fail ("the cache file wasn't written");
+    else
+    {
+        // The intact file must be used, or the damaged ones prove nothing.
+
+        auto one = SavedFileSys();
+
+        FileSysProxyCache cache { one };
+        cache.open (c_cacheFile);
+        passed = Check ("intact file", cache, one, L"C:/D/*", false) && passed;
+        cache.open ("");
+
+        for (size_t size = 0;  size < image.size();  ++size)
+        {
+            char what [64];
+            snprintf (what, sizeof(what), "file truncated to %zu bytes", size);
+            passed = Corrupt (what, std::vector<char> (image.begin(), image.begin() + size))
+                  && passed;
+        }
+
+        auto badMagic = image;
+        badMagic[0] ^= 0x20;
+        passed = Corrupt ("bad signature", badMagic) && passed;
+
+        auto garbage = image;
+        garbage.insert (garbage.end(), { 'x', 'y', 'z' });
+        passed = Corrupt ("trailing garbage", garbage) && passed;
+    }
+
+    remove (c_cacheFile);
+    return passed;
+}
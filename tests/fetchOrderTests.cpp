@@ -0,0 +1,220 @@
+//==================================================================================================
+// fetchOrderTests.cpp
+//
+//     FetchOrderTest: Checks that a parallel tree fetch reports what a serial depth-first walk
+//     would, in the same order. Random in-memory trees (see memoryFileSys.h) are matched against
+//     ellipsis patterns, with and without search budgets, and each callback sequence is compared
+//     with a serial walk of the same tree. A budget's directory or match limit must cut the fetch
+//     short at exactly the point where it cuts the serial walk short, so that what's reported is
+//     always a prefix of the full serial order.
+//==================================================================================================
+
+#include "tests.h"
+#include "memoryFileSys.h"
+#include <pathmatcher.h>
+
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using std::wstring;
+
+typedef std::vector<wstring> Paths;
+
+
+class SerialWalk
+{
+    //----------------------------------------------------------------------------------------------
+    // A serial depth-first walk of a MemoryFileSys tree, as a fetch of "R/..." reports it: each
+    // directory's entries in listing order, with each subdirectory's tree right after the
+    // subdirectory itself. Each directory is charged against the directory limit as the walk
+    // reaches it, and the walk stops at the first directory over the limit.
+    //----------------------------------------------------------------------------------------------
+
+  public:
+
+    SerialWalk (const MemoryFileSys& fileSys, bool filesOnly, size_t maxDirectories)
+      : m_fileSys(fileSys), m_filesOnly(filesOnly), m_maxDirectories(maxDirectories)
+    {
+        if (Reach())
+            Walk (L"R");
+    }
+
+    const Paths& Reported () const  { return m_reported; }
+    size_t       Directories () const { return m_directories; }
+
+  private:
+
+    bool Reach ()
+    {
+        if (m_maxDirectories && (m_directories == m_maxDirectories))
+            return false;
+
+        ++m_directories;
+        return true;
+    }
+
+    bool Walk (const wstring& path)
+    {
+        for (auto& node : m_fileSys.ListingOf (path))
+        {
+            if ((node.name == L".") || (node.name == L".."))
+                continue;
+
+            auto entry = path + L"\\" + node.name;
+
+            if (!m_filesOnly || !node.isDirectory)
+                m_reported.push_back (entry);
+
+            if (node.isDirectory && (!Reach() || !Walk (entry)))
+                return false;
+        }
+
+        return true;
+    }
+
+    const MemoryFileSys& m_fileSys;
+    bool                 m_filesOnly;             // True => report only files
+    size_t               m_maxDirectories;        // Directory limit (0 = none)
+    size_t               m_directories { 0 };     // Directories reached
+    Paths                m_reported;              // Entries reported, in order
+};
+
+
+
+static Paths Fetch (MemoryFileSys& fileSys, const wchar_t* pattern, PMatcher::SearchBudget* budget)
+{
+    // Returns the entries reported by a match of the pattern, in callback order, with slashes
+    // made backslashes.
+
+    PMatcher::PathMatcher matcher { fileSys };
+    Paths reported;
+
+    auto callback = [] (const wchar_t* path, const FSProxy::DirectoryIterator&, void* data)
+    {
+        wstring entry = path;
+        std::replace (entry.begin(), entry.end(), L'/', L'\\');
+        static_cast<Paths*>(data)->push_back (entry);
+        return true;
+    };
+
+    matcher.Match (pattern, callback, &reported, budget);
+    return reported;
+}
+
+
+
+static bool Compare (const char* what, const Paths& fetched, const Paths& expected)
+{
+    // Reports the first difference between the fetched and expected entries, if any.
+
+    for (size_t i = 0;  i < std::min (fetched.size(), expected.size());  ++i)
+    {
+        if (fetched[i] != expected[i])
+        {
+            return Fail ("%s: entry %zu is \"%s\", but the serial walk has \"%s\"", what, i,
+                         std::string (fetched[i].begin(), fetched[i].end()).c_str(),
+                         std::string (expected[i].begin(), expected[i].end()).c_str());
+        }
+    }
+
+    if (fetched.size() != expected.size())
+        return Fail ("%s: %zu entries reported, but the serial walk has %zu", what,
+                     fetched.size(), expected.size());
+
+    return true;
+}
+
+
+
+bool FetchOrderTest (const TestArgs&)
+{
+    static const unsigned c_numTrees { 16 };   // Random trees tested
+
+    struct Pattern
+    {
+        const wchar_t* text;        // Pattern to match
+        bool           filesOnly;   // True => pattern reports only files
+    };
+
+    const Pattern patterns[] =
+    {
+        { L"R/...",          false },
+        { L"R/.../f*.txt",   true  },
+    };
+
+    std::mt19937 random { 2024 };
+    auto passed = true;
+
+    for (unsigned tree = 0;  tree < c_numTrees;  ++tree)
+    {
+        auto numDirectories = 1 + random() % 1500;
+        auto numFiles       = random() % 3000;
+
+        MemoryFileSys fileSys { static_cast<unsigned>(random()), numDirectories, numFiles };
+
+        for (auto& pattern : patterns)
+        {
+            char what [128];
+            wstring text = pattern.text;
+
+            snprintf (what, sizeof(what), "tree %u (%zu dirs, %zu files), \"%s\"", tree,
+                      static_cast<size_t>(numDirectories), static_cast<size_t>(numFiles),
+                      std::string (text.begin(), text.end()).c_str());
+
+            // The unlimited fetch must report the whole serial walk, in order.
+
+            SerialWalk full { fileSys, pattern.filesOnly, 0 };
+            passed = Compare (what, Fetch (fileSys, pattern.text, nullptr), full.Reported())
+                  && passed;
+
+            // A directory limit must cut the fetch where it cuts the serial walk, and charge the
+            // same directories.
+
+            size_t dirLimits[] = { 1, 2, 1 + random() % numDirectories, numDirectories };
+
+            for (auto limit : dirLimits)
+            {
+                PMatcher::SearchBudget budget;
+                budget.Start (0, limit, 0);
+
+                SerialWalk cut { fileSys, pattern.filesOnly, limit };
+                auto fetched = Fetch (fileSys, pattern.text, &budget);
+
+                char limitWhat [192];
+                snprintf (limitWhat, sizeof(limitWhat), "%s, %zu directories", what, limit);
+
+                passed = Compare (limitWhat, fetched, cut.Reported()) && passed;
+
+                if (budget.Directories() != cut.Directories())
+                    passed = Fail ("%s: %zu directories charged, but the serial walk reached %zu",
+                                   limitWhat, budget.Directories(), cut.Directories());
+            }
+
+            // A match limit must stop the fetch right after the limiting match.
+
+            if (full.Reported().empty())
+                continue;
+
+            size_t matchLimits[] = { 1, 1 + random() % full.Reported().size() };
+
+            for (auto limit : matchLimits)
+            {
+                PMatcher::SearchBudget budget;
+                budget.Start (0, 0, limit);
+
+                Paths expected (full.Reported().begin(), full.Reported().begin() + limit);
+
+                char limitWhat [192];
+                snprintf (limitWhat, sizeof(limitWhat), "%s, %zu matches", what, limit);
+
+                passed = Compare (limitWhat, Fetch (fileSys, pattern.text, &budget), expected)
+                      && passed;
+            }
+        }
+    }
+
+    return passed;
+}
@@ -0,0 +1,211 @@
+//==================================================================================================
+// linuxProxyTests.cpp
+//
+//     LinuxProxyTest: Lists a scratch directory through FileSysProxyLinux. The directory holds
+//     enough long names to take several getdents64 batches, along with subdirectories, a symbolic
+//     link to a directory and a non-ASCII name. Each listing must return every entry exactly once,
+//     typed correctly, both from the types getdents64 reports and from the fstatat fallback taken
+//     for DT_UNKNOWN. Paths that name a single entry must return just that entry, and iterators
+//     reused across listings and lookups must start afresh each time.
+//==================================================================================================
+
+#include "tests.h"
+#include <fileSystemProxyLinux.h>
+
+#include <map>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::string;
+using std::wstring;
+using namespace FSProxy;
+
+typedef std::map<wstring, bool> Entries;   // Whether each entry is a directory, by name
+
+
+static const int c_numFiles       { 1500 };   // Files with long names, for several batches
+static const int c_numDirectories { 20 };     // Subdirectories
+
+static const char    c_utf8Name[] { "\xc3\xa9t\xc3\xa9" };   // A non-ASCII name, in UTF-8
+static const wchar_t c_wideName[] { L"\u00e9t\u00e9" };       // The same name, decoded
+
+
+
+static wstring Widen (const string& str)
+{
+    // Returns the (ASCII) string as a wide string.
+    return wstring (str.begin(), str.end());
+}
+
+
+
+static string Narrow (const wstring& str)
+{
+    // Returns the wide string as a narrow one for messages, with non-ASCII characters as '?'.
+
+    string result;
+
+    for (auto c : str)
+        result += (c < 0x80) ? static_cast<char>(c) : '?';
+
+    return result;
+}
+
+
+
+static string FileName (int i)
+{
+    // Returns the name of the i'th file, long enough that a 32K batch holds a few hundred.
+
+    char name [80];
+    snprintf (name, sizeof(name), "file-%04d-abcdefghijklmnopqrstuvwxyz-abcdefghijklmnop.txt", i);
+    return name;
+}
+
+
+
+static bool CheckListing (const char* what, DirectoryIterator& iterator, const Entries& expected)
+{
+    // Reads every entry from the iterator, and checks them against the expected entries.
+
+    Entries listed;
+    auto    passed = true;
+
+    while (iterator.next())
+    {
+        if (!listed.emplace (iterator.name(), iterator.isDirectory()).second)
+            passed = Fail ("%s: \"%s\" was listed twice", what, Narrow(iterator.name()).c_str());
+    }
+
+    for (auto& entry : expected)
+    {
+        auto found = listed.find (entry.first);
+
+        if (found == listed.end())
+            passed = Fail ("%s: \"%s\" wasn't listed", what, Narrow(entry.first).c_str());
+        else if (found->second != entry.second)
+            passed = Fail ("%s: \"%s\" was listed as a %s", what, Narrow(entry.first).c_str(),
+                           found->second ? "directory" : "file");
+    }
+
+    if (listed.size() != expected.size())
+        passed = Fail ("%s: %zu entries listed, but the directory holds %zu", what,
+                       listed.size(), expected.size());
+
+    return passed;
+}
+
+
+
+bool LinuxProxyTest (const TestArgs&)
+{
+    char scratch[] = "jumpdirTests.XXXXXX";
+
+    if (!mkdtemp (scratch))
+        return Fail ("couldn't create a scratch directory");
+
+    // Fill the scratch directory, noting each entry as it's made.
+
+    string  root = scratch;
+    Entries expected { { L".", true }, { L"..", true } };
+    auto    passed = true;
+
+    for (int i = 0;  i < c_numFiles;  ++i)
+    {
+        if (auto file = fopen ((root + "/" + FileName(i)).c_str(), "w"))
+            fclose (file);
+
+        expected[Widen (FileName (i))] = false;
+    }
+
+    for (int i = 0;  i < c_numDirectories;  ++i)
+    {
+        auto name = "dir-" + std::to_string (i);
+        mkdir ((root + "/" + name).c_str(), 0700);
+        expected[Widen (name)] = true;
+    }
+
+    if (symlink ("dir-0", (root + "/link").c_str()) == 0)
+        expected[L"link"] = false;   // Listed links are never followed.
+
+    if (auto file = fopen ((root + "/" + c_utf8Name).c_str(), "w"))
+    {
+        fclose (file);
+        expected[c_wideName] = false;
+    }
+
+    FileSysProxyLinux proxy;
+    auto wideRoot = Widen (root);
+
+    // List the whole directory, with each slash, from the reported entry types and then from
+    // fstatat alone.
+
+    for (auto ignoreTypes : { false, true })
+    {
+        for (auto path : { wideRoot + L"/*", wideRoot + L"\\*" })
+        {
+            char what [128];
+            snprintf (what, sizeof(what), "listing \"%s\"%s", Narrow(path).c_str(),
+                      ignoreTypes ? ", types ignored" : "");
+
+            DirectoryIteratorLinux iterator { path.c_str() };
+            iterator.ignoreEntryTypes (ignoreTypes);
+            passed = CheckListing (what, iterator, expected) && passed;
+        }
+    }
+
+    // Look up single entries, reusing one iterator, which is left partway through a listing first.
+
+    std::unique_ptr<DirectoryIterator> iterator {
+        proxy.reuseDirectoryIterator (nullptr, (wideRoot + L"/*").c_str()) };
+
+    for (int i = 0;  (i < 10) && iterator->next();  ++i)
+        continue;
+
+    struct Lookup
+    {
+        wstring name;      // Entry to look up
+        Entries entries;   // Entries it must return
+    };
+
+    const Lookup lookups[] =
+    {
+        { Widen (FileName (0)), { { Widen (FileName (0)), false } } },
+        { L"dir-0",             { { L"dir-0", true } } },
+        { L"link",              { { L"link", true } } },   // Named links are followed.
+        { c_wideName,           { { c_wideName, false } } },
+        { L"missing",           { } },
+    };
+
+    for (auto& lookup : lookups)
+    {
+        auto path = wideRoot + L"/" + lookup.name;
+        auto what = "lookup of \"" + Narrow(path) + "\"";
+
+        iterator.reset (proxy.reuseDirectoryIterator (iterator.release(), path.c_str()));
+        passed = CheckListing (what.c_str(), *iterator, lookup.entries) && passed;
+    }
+
+    // The reused iterator must list the whole directory again.
+
+    iterator.reset (proxy.reuseDirectoryIterator (iterator.release(), (wideRoot + L"/*").c_str()));
+    passed = CheckListing ("listing after lookups", *iterator, expected) && passed;
+
+    // Remove the scratch directory.
+
+    for (auto& entry : expected)
+    {
+        if ((entry.first == L".") || (entry.first == L".."))
+            continue;
+
+        auto path = root + "/" + ((entry.first == c_wideName) ? c_utf8Name : Narrow (entry.first));
+        entry.second ? rmdir (path.c_str()) : unlink (path.c_str());
+    }
+
+    rmdir (scratch);
+    return passed;
+}
@@ -0,0 +1,195 @@
+//==================================================================================================
+// memoryFileSys.h
+//
+//     MemoryFileSys: a file system proxy over an in-memory directory tree, so that tests can walk
+//     trees of any shape without touching the disk. The tree is either balanced, with the same
+//     number of subdirectories in every directory, or random, with directories and files scattered
+//     through it and each directory listed in a random order.
+//==================================================================================================
+
+#ifndef _memoryFileSys_h
+#define _memoryFileSys_h
+
+#include <fileSystemProxy.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+
+class MemoryFileSys : public FSProxy::FileSysProxy
+{
+    //----------------------------------------------------------------------------------------------
+    // A file system proxy over an in-memory tree of directories. The tree's root directory is "R",
+    // relative to the current directory. Every directory lists "." and ".." first. Paths are keyed
+    // with backslashes, as PathMatcher builds them; forward slashes are accepted too.
+    //----------------------------------------------------------------------------------------------
+
+  public:
+
+    struct Node
+    {
+        std::wstring name;          // Entry name
+        bool         isDirectory;   // True => entry is a directory
+    };
+
+    typedef std::vector<Node> Listing;
+
+    // A balanced tree: every directory holds a file named "file.txt", plus 'fan' subdirectories
+    // named "d0", "d1", ..., down to the given depth.
+
+    MemoryFileSys (int fan, int depth) { AddBalanced (L"R", fan, depth); }
+
+    // A random tree of 'numDirectories' directories (counting the root) and 'numFiles' files, each
+    // placed in a directory chosen at random. Subdirectories are named "d<n>" and files "f<n>.txt",
+    // with <n> unique across the tree.
+
+    MemoryFileSys (unsigned seed, size_t numDirectories, size_t numFiles)
+    {
+        std::mt19937 random { seed };
+        std::vector<std::wstring> directories { L"R" };
+
+        AddDirectory (L"R");
+
+        while (directories.size() < numDirectories)
+        {
+            auto parent = directories [random() % directories.size()];
+            auto name   = L"d" + std::to_wstring (directories.size());
+
+            m_tree[parent].push_back ({ name, true });
+            directories.push_back (parent + L"\\" + name);
+            AddDirectory (directories.back());
+        }
+
+        for (size_t i = 0;  i < numFiles;  ++i)
+        {
+            auto& parent = directories [random() % directories.size()];
+            auto  name   = L"f" + std::to_wstring (i) + L".txt";
+
+            m_tree[parent].push_back ({ name, false });
+            m_tree[parent + L"\\" + name] = { { name, false } };
+        }
+
+        for (auto& directory : directories)
+        {
+            auto& listing = m_tree[directory];
+            std::shuffle (listing.begin() + 2, listing.end(), random);
+        }
+    }
+
+    size_t NumDirectories () const { return m_numDirectories; }
+
+    // Returns the listing of the given directory, which must exist.
+
+    const Listing& ListingOf (const std::wstring& path) const { return m_tree.at (path); }
+
+    size_t maxPathLength () const override { return 260; }
+
+    FSProxy::DirectoryIterator* newDirectoryIterator (const std::wstring path) const override
+    {
+        return reuseDirectoryIterator (nullptr, path.c_str());
+    }
+
+    FSProxy::DirectoryIterator* reuseDirectoryIterator (
+        FSProxy::DirectoryIterator* iterator, const wchar_t* path) const override
+    {
+        // Reopens the iterator without allocating, once its key buffer is large enough.
+
+        auto memoryIterator = static_cast<MemoryIterator*> (iterator);
+
+        if (!memoryIterator)
+            memoryIterator = new MemoryIterator;
+
+        memoryIterator->Open (*this, path);
+        return memoryIterator;
+    }
+
+    bool setCurrentDirectory (const std::wstring) override { return true; }
+
+  private:
+
+    class MemoryIterator : public FSProxy::DirectoryIterator
+    {
+      public:
+
+        void Open (const MemoryFileSys& fileSys, const wchar_t* path)
+        {
+            // Looks up the path, with any trailing wildcard and slashes removed. A path to a file
+            // lists just that file.
+
+            m_key.clear();
+
+            for (auto c = path;  *c;  ++c)
+                m_key += (*c == L'/') ? L'\\' : *c;
+
+            if (!m_key.empty() && (m_key.back() == L'*'))
+                m_key.pop_back();
+
+            while (!m_key.empty() && (m_key.back() == L'\\'))
+                m_key.pop_back();
+
+            auto found = fileSys.m_tree.find (m_key);
+
+            m_listing = (found == fileSys.m_tree.end()) ? nullptr : &found->second;
+            m_index   = 0;
+            m_started = false;
+        }
+
+        bool next () override
+        {
+            if (!m_listing)
+                return false;
+
+            if (!m_started)
+            {
+                m_started = true;
+                return !m_listing->empty();
+            }
+
+            return ++m_index < m_listing->size();
+        }
+
+        bool isDirectory () const override { return (*m_listing)[m_index].isDirectory; }
+        const wchar_t* name () const override { return (*m_listing)[m_index].name.c_str(); }
+
+      private:
+
+        std::wstring   m_key;                  // Lookup key, kept for its capacity
+        const Listing* m_listing { nullptr };  // Entries of the open directory
+        size_t         m_index { 0 };          // Current entry
+        bool           m_started { false };    // True => next() has been called
+    };
+
+    void AddDirectory (const std::wstring& path)
+    {
+        auto& listing = m_tree[path];
+
+        listing.push_back ({ L".", true });
+        listing.push_back ({ L"..", true });
+        ++m_numDirectories;
+    }
+
+    void AddBalanced (const std::wstring& path, int fan, int depth)
+    {
+        AddDirectory (path);
+        m_tree[path].push_back ({ L"file.txt", false });
+        m_tree[path + L"\\file.txt"] = { { L"file.txt", false } };
+
+        if (depth == 0)
+            return;
+
+        for (int i = 0;  i < fan;  ++i)
+        {
+            auto name = L"d" + std::to_wstring (i);
+            m_tree[path].push_back ({ name, true });
+            AddBalanced (path + L"\\" + name, fan, depth - 1);
+        }
+    }
+
+    std::map<std::wstring, Listing> m_tree;                // Listing of each directory and file
+    size_t                          m_numDirectories { 0 };
+};
+
+#endif   // ifndef _memoryFileSys_h
@@ -0,0 +1,194 @@
+//==================================================================================================
+// patternTests.cpp
+//
+//     Tests of the wildcard and path pattern matchers:
+//
+//     PatternCorpusTest: Patterns that took the old recursive matchers exponential time, each of
+//         which must now give the right answer within a fixed time budget.
+//
+//     DifferentialTest: Random short patterns and strings, matched by both the compiled matchers
+//         and the reference matchers (see referenceMatcher.cpp), which must agree. The one
+//         intended difference is that pathMatch now treats forward and back slashes alike, as it
+//         is documented to; the random paths use only forward slashes, and the difference is
+//         checked on its own.
+//==================================================================================================
+
+#include "tests.h"
+#include <pathmatcher.h>
+
+#include <chrono>
+#include <iterator>
+#include <random>
+#include <string>
+
+using std::wstring;
+
+typedef PMatcher::CompiledPattern::Syntax Syntax;
+
+
+static const std::chrono::milliseconds c_timeBudget { 1000 };   // Most time for any one match
+
+
+
+static wstring Repeat (const wchar_t* piece, size_t count)
+{
+    wstring result;
+
+    while (count--)
+        result += piece;
+
+    return result;
+}
+
+
+
+static std::string Narrow (const wstring& str)
+{
+    // Returns the (ASCII) string as a narrow string, for messages.
+    return std::string (str.begin(), str.end());
+}
+
+
+
+static bool Match (Syntax syntax, const wchar_t* pattern, const wchar_t* string)
+{
+    switch (syntax)
+    {
+        case Syntax::Wild:              return PMatcher::wildComp (pattern, string);
+        case Syntax::WildCaseSensitive: return PMatcher::wildCompCaseSensitive (pattern, string);
+        default:                        return PMatcher::pathMatch (pattern, string);
+    }
+}
+
+
+
+static bool ReferenceMatch (Syntax syntax, const wchar_t* pattern, const wchar_t* string)
+{
+    switch (syntax)
+    {
+        case Syntax::Wild:              return Reference::wildComp (pattern, string);
+        case Syntax::WildCaseSensitive: return Reference::wildCompCaseSensitive (pattern, string);
+        default:                        return Reference::pathMatch (pattern, string);
+    }
+}
+
+
+
+bool PatternCorpusTest (const TestArgs&)
+{
+    struct Case
+    {
+        Syntax  syntax;     // Matcher to use
+        wstring pattern;    // Pattern
+        wstring string;     // String or path to match
+        bool    expected;   // Expected result
+    };
+
+    const auto wild  = Syntax::Wild;
+    const auto exact = Syntax::WildCaseSensitive;
+    const auto path  = Syntax::Path;
+
+    const Case corpus[] =
+    {
+        // Many asterisks that each could take any split of a long run of the same character.
+
+        { wild,  Repeat(L"*a", 16) + L"*b",   wstring(200, L'a'),          false },
+        { exact, Repeat(L"*a", 16) + L"*b",   wstring(200, L'a'),          false },
+        { wild,  Repeat(L"*a", 16),           wstring(200, L'A'),          true  },
+        { exact, Repeat(L"*a", 16),           wstring(200, L'A'),          false },
+        { wild,  Repeat(L"?*", 40) + L"b",    wstring(300, L'a'),          false },
+        { wild,  Repeat(L"*a", 200) + L"*b",  wstring(100000, L'a'),       false },
+        { wild,  Repeat(L"*a", 2000) + L"*b", wstring(1999, L'a') + L"b",  false },
+
+        // The same, within one path component, and with ellipses spanning components.
+
+        { path,  Repeat(L"*a", 16) + L"*b",      wstring(200, L'a'),         false },
+        { path,  Repeat(L"...a", 16) + L"...b",  Repeat(L"a/", 100),         false },
+        { path,  Repeat(L".../*a*", 12) + L"/b", Repeat(L"aa/", 80) + L"b",  true  },
+        { path,  Repeat(L".../*a*", 12) + L"/c", Repeat(L"aa/", 80) + L"b",  false },
+        { path,  Repeat(L"...*", 50) + L"x",     Repeat(L"ab/", 5000),       false },
+        { path,  Repeat(L"*/", 30) + L"...b",    Repeat(L"a/", 2000) + L"b", true  },
+    };
+
+    auto passed = true;
+
+    for (auto& test : corpus)
+    {
+        auto start   = std::chrono::steady_clock::now();
+        auto result  = Match (test.syntax, test.pattern.c_str(), test.string.c_str());
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        auto ms      = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+
+        auto shown = Narrow (test.pattern.substr (0, 40));
+
+        if (result != test.expected)
+            passed = Fail ("pattern \"%s\" (%zu characters) against %zu characters gave %s",
+                           shown.c_str(), test.pattern.size(), test.string.size(),
+                           result ? "a match" : "no match");
+
+        if (elapsed > c_timeBudget)
+            passed = Fail ("pattern \"%s\" (%zu characters) took %lld ms, over the %lld ms budget",
+                           shown.c_str(), test.pattern.size(), static_cast<long long>(ms.count()),
+                           static_cast<long long>(c_timeBudget.count()));
+    }
+
+    return passed;
+}
+
+
+
+bool DifferentialTest (const TestArgs&)
+{
+    static const size_t c_trials    { 100000 };   // Random pattern/string pairs per syntax
+    static const int    c_maxFailed { 10 };       // Mismatches reported before giving up
+
+    const wchar_t* wildTokens[] = { L"a", L"b", L"A", L"?", L"*" };
+    const wchar_t* pathTokens[] = { L"a", L"b", L"A", L".", L"?", L"*", L"...", L"/" };
+    const wchar_t  wildChars[]  = L"abAB";
+    const wchar_t  pathChars[]  = L"abA./";
+
+    std::mt19937 random { 1234 };
+    int          failed = 0;
+
+    for (auto syntax : { Syntax::Wild, Syntax::WildCaseSensitive, Syntax::Path })
+    {
+        auto isPath     = (syntax == Syntax::Path);
+        auto tokens     = isPath ? pathTokens : wildTokens;
+        auto numTokens  = isPath ? std::size(pathTokens) : std::size(wildTokens);
+        auto chars      = isPath ? pathChars : wildChars;
+        auto numChars   = (isPath ? std::size(pathChars) : std::size(wildChars)) - 1;
+
+        for (size_t trial = 0;  (trial < c_trials) && (failed < c_maxFailed);  ++trial)
+        {
+            wstring pattern, string;
+
+            for (auto n = random() % 9;  n;  --n)
+                pattern += tokens[random() % numTokens];
+
+            for (auto n = random() % 11;  n;  --n)
+                string += chars[random() % numChars];
+
+            auto result   = Match (syntax, pattern.c_str(), string.c_str());
+            auto expected = ReferenceMatch (syntax, pattern.c_str(), string.c_str());
+
+            if (result != expected)
+            {
+                ++failed;
+                Fail ("%s pattern \"%s\" against \"%s\" gave %s; the reference gave %s",
+                      isPath ? "path" : (syntax == Syntax::Wild) ? "wild" : "case-sensitive wild",
+                      Narrow(pattern).c_str(), Narrow(string).c_str(),
+                      result ? "a match" : "no match", expected ? "a match" : "no match");
+            }
+        }
+    }
+
+    // The one intended difference: pathMatch treats forward and back slashes alike.
+
+    if (!PMatcher::pathMatch (L"a\\b", L"a/b") || !PMatcher::pathMatch (L"a/.../c", L"a\\b\\c"))
+    {
+        ++failed;
+        Fail ("pathMatch doesn't treat forward and back slashes alike");
+    }
+
+    return failed == 0;
+}
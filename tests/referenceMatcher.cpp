@@ -0,0 +1,265 @@
+//==================================================================================================
+// referenceMatcher.cpp
+//
+//     The recursive wildComp, wildCompCaseSensitive and pathMatch that the path matcher used before
+//     its patterns were compiled to NFAs (see CompiledPattern), kept unchanged as the reference
+//     for the differential test (see patternTests.cpp). These take exponential time on patterns
+//     with many asterisks or ellipses, so only test them on short patterns.
+//==================================================================================================
+
+#include "tests.h"
+
+#include <ctype.h>
+
+
+namespace Reference {
+
+
+static bool isSlash (const wchar_t c)
+{
+    // Return true if and only if the character is a forward or backward slash.
+    return ((c == L'/') || (c == L'\\'));
+}
+
+
+static bool isEllipsis (const wchar_t *str)
+{
+    // Return true if and only if the string begins with "...".
+    return (str[0] == L'.') && (str[1] == L'.') && (str[2] == L'.');
+}
+
+
+static bool isMultiWildStr (const wchar_t* str)
+{
+    // Return true if and only if the string begins with a wildcard that matches
+    // multiple characters ("*" or "...").
+    return (*str == L'*') || isEllipsis(str);
+}
+
+
+
+bool wildComp (const wchar_t *pattern, const wchar_t *string)
+{
+    if (!pattern || !string) return false;
+
+    // Scan through the single character matches.
+
+    while (*pattern && *string)
+    {
+        if (*pattern == L'*')  // If we've hit an asterisk, then drop down to the section below.
+            break;
+
+        // Stop testing on mismatch.
+
+        if ((*pattern != L'?') && (tolower(*pattern) != tolower(*string)))
+            break;
+
+        ++ pattern;    // On a successful match, increment the pattern and the string and continue.
+        ++ string;
+    }
+
+    // Unless we stopped on an asterisk, we're done matching. The only valid way to match at this
+    // point is if both the pattern and the string are exhausted.
+
+    if (*pattern != L'*')
+        return (*pattern == 0) && (*string == 0);
+
+    // Advance past the asterisk. Handle pathological cases where there is more than one asterisk
+    // in a row.
+
+    while (*pattern == L'*')
+        ++pattern;
+
+    // If the asterisk is the last character of the pattern, then we match any remainder,
+    // so return true.
+
+    if (*pattern == 0)
+        return true;
+
+    // We're at an asterisk with other patterns following, so recursively eat away at the string
+    // until we match or exhaust the string.
+
+    while (true)
+    {
+        if (wildComp (pattern, string))
+            return true;
+
+        if (!*string++)
+            return false;
+    }
+}
+
+
+
+bool wildCompCaseSensitive (const wchar_t *pattern, const wchar_t *string)
+{
+    if (!pattern || !string) return false;
+
+    // Scan through the single character matches.
+
+    while (*pattern && *string)
+    {
+        if (*pattern == L'*')  // If we've hit an asterisk, then drop down to the section below.
+            break;
+
+        // Stop testing on mismatch.
+
+        if ((*pattern != L'?') && (*pattern != *string))
+            break;
+
+        ++ pattern;    // On a successful match, increment the pattern and the string and continue.
+        ++ string;
+    }
+
+    // Unless we stopped on an asterisk, we're done matching. The only valid way to match at this
+    // point is if both the pattern and the string are exhausted.
+
+    if (*pattern != L'*')
+        return (*pattern == 0) && (*string == 0);
+
+    // Advance past the asterisk. Handle pathological cases where there is more than one asterisk
+    // in a row.
+
+    while (*pattern == L'*')
+        ++pattern;
+
+    // If the asterisk is the last character of the pattern, then we match any remainder,
+    // so return true.
+
+    if (*pattern == 0)
+        return true;
+
+    // We're at an asterisk with other patterns following, so recursively eat away at the string
+    // until we match or exhaust the string.
+
+    while (true)
+    {
+        if (wildCompCaseSensitive (pattern, string))
+            return true;
+
+        if (!*string++)
+            return false;
+    }
+}
+
+
+
+bool pathMatch (const wchar_t *pattern, const wchar_t *path)
+{
+    if (!pattern || !path) return false;
+
+    // Scan through the pattern and path until we hit an asterisk or an ellipsis. Handle the special
+    // cases of "/.../" and "/*/", tested against null subdirectories (where both are also
+    // equivalent to "/").
+
+    while (*pattern && *path)
+    {
+        if (isSlash(path[0]))             // Consume repeated slashes on path.
+        {   while (isSlash(path[1]))
+                ++ path;
+        }
+
+        if (isSlash(pattern[0]))
+        {
+            if (!isSlash(path[0]))
+                return false;
+
+            while (isSlash(pattern[1]))  // Consume repeated slashes on pattern.
+                ++ pattern;
+        }
+        else if (isMultiWildStr (pattern))
+        {   // If we've hit a multi-character wildcard character, then drop to section below.
+            break;
+        }
+
+        // Test for a single character match. In order to support case-sensitive path matching,
+        // you'd only need to change the tolower comparison below.
+
+        if (*pattern != L'?')
+        {   if (tolower(*pattern) != tolower(*path))
+                return false;
+        }
+        else if (isSlash(*path))         // '?' matches all but slash.
+        {   return false;
+        }
+
+        ++ pattern;    // On a successful match, increment the pattern and the path and continue.
+        ++ path;
+    }
+
+    // Unless we stopped on a multi-character wildcard, we're done matching. The only valid way to
+    // match at this point is if both the pattern and the path are exhausted.
+
+    if (!isMultiWildStr(pattern))
+        return (*pattern == 0) && (*path == 0);
+
+    // Advance past the multi-character wildcard(s). A sequence of asterisks is equivalent to a
+    // single asterisk, and a sequence of ellipses and asterisks is equivalent to a single
+    // ellipsis. We handle this here because many asterisks and ellipses in a row would yield
+    // exponential (and pathological) runtimes.
+
+    bool fEllipsis { false };
+
+    while (isMultiWildStr (pattern))
+    {
+        if (pattern[0] == L'*')
+            pattern += 1;
+        else
+        {   pattern += 3;
+            fEllipsis = true;
+        }
+    }
+
+    // If the pattern ends in an ellipsis, then we trivially match any remainder of the path, so
+    // return true, otherwise perform match testing.
+
+    if (fEllipsis && (*pattern == 0))
+        return true;
+
+    // A multi-wild pattern (* or ...) followed by any number of slashes can match the empty string,
+    // so we test for that here. Thus, ".../foo" will match against "foo".
+
+    if (isSlash(*pattern))
+    {
+        // Search forward past any number of trailing slashes.
+
+        auto ptr = pattern + 1;
+
+        while (isSlash(*ptr)) ++ptr;
+
+        // Match the remainder of the pattern against the remainder of the path.
+
+        if (pathMatch(ptr,path))
+            return true;
+    }
+
+    if (fEllipsis)
+    {
+        // If we have an ellipsis, then recursively nibble away at the path to see if we can yield
+        // a match, until we either match or exhaust the path.
+
+        for (;; ++path)
+        {
+            if (pathMatch(pattern, path)) return true;
+            if (*path == 0) return false;
+        }
+    }
+    else
+    {
+        // If we have an asterisk, then recursively nibble away at the path until we encounter a
+        // slash or exhaust the path.
+
+        for (; *path && !isSlash(*path);  ++path)
+        {
+            if (pathMatch(pattern, path)) return true;
+        }
+
+        // Test the remainder of the pattern and path.
+
+        return pathMatch(pattern, path);
+    }
+}
+
+
+
+};  // namespace Reference
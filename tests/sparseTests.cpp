@@ -0,0 +1,275 @@
+//==================================================================================================
+// sparseTests.cpp
+//
+//     SparseDifferentialTest: Random sparse patterns and strings, scored both by SparsePattern and
+//     by a naive scorer written straight from SparsePattern's rules, a character at a time and
+//     without bit sets. The two must agree on whether each string matches, and on its score. Most
+//     strings are short, over a small alphabet of letters, slashes and word breaks, so that
+//     matches and ties are common; some are long enough to cross bit set words and to reach the
+//     longest string a sparse match accepts. Batches are also scored with ScoreAll, which must
+//     agree with the naive scorer string for string.
+//==================================================================================================
+
+#include "tests.h"
+#include <pathmatcher.h>
+
+#include <ctype.h>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using std::wstring;
+
+typedef PMatcher::SparsePattern SparsePattern;
+
+
+// Score terms, as SparsePattern defines them
+
+static const int c_charScore      { 16 };   // Each matched character
+static const int c_adjacentBonus  { 16 };   // Character immediately follows the previous one
+static const int c_componentBonus { 24 };   // Character begins a path component
+static const int c_wordBonus      { 12 };   // Character begins a word within a component
+static const int c_tailBonus      {  8 };   // Character lies in the final path component
+static const int c_maxGapPenalty  {  8 };   // Most that the gap before a character costs
+
+
+
+static bool NaiveSparseScore (const wstring& pattern, const wstring& string, int& score)
+{
+    //----------------------------------------------------------------------------------------------
+    // Scores the sparse pattern against the string by the rules SparsePattern documents: place
+    // each pattern character at the first position after the previous one that is, in order of
+    // preference, right after it, the start of a path component, the start of a word, or anywhere,
+    // so long as the rest of the pattern still fits after it. Returns true if the string matches.
+    //----------------------------------------------------------------------------------------------
+
+    auto fold = [] (wchar_t c)
+    {
+        return ((c == L'/') || (c == L'\\')) ? L'/' : static_cast<wchar_t>(tolower (c));
+    };
+
+    auto isSlash     = [] (wchar_t c) { return (c == L'/') || (c == L'\\'); };
+    auto isWordBreak = [] (wchar_t c)
+    {
+        return (c == L' ') || (c == L'-') || (c == L'_') || (c == L'.');
+    };
+
+    if (  pattern.empty() || (pattern.size() > SparsePattern::c_maxPatternLength)
+       || (string.size() > SparsePattern::c_maxStringLength) || (string.size() < pattern.size()))
+    {
+        return false;
+    }
+
+    auto length = static_cast<int>(string.size());
+
+    auto isComponentStart = [&] (int i)
+    {
+        return !isSlash (string[i]) && ((i == 0) || isSlash (string[i-1]));
+    };
+
+    auto isWordStart = [&] (int i)
+    {
+        return !isSlash (string[i]) && !isComponentStart (i) && (i > 0)
+            && isWordBreak (string[i-1]);
+    };
+
+    auto tailStart = 0;
+
+    for (int i = 0;  i < length;  ++i)
+    {
+        if (isSlash (string[i]))
+            tailStart = i + 1;
+    }
+
+    // Find the last position each character can take, leaving room for the rest of the pattern.
+
+    std::vector<int> latest (pattern.size());
+    int limit = length;
+
+    for (auto i = pattern.size();  i-- > 0;  )
+    {
+        do {
+            if (--limit < 0)
+                return false;
+        } while (fold (string[limit]) != fold (pattern[i]));
+
+        latest[i] = limit;
+    }
+
+    // Place and score each character.
+
+    score = 0;
+    int previous = -1;
+
+    for (size_t i = 0;  i < pattern.size();  ++i)
+    {
+        auto c     = fold (pattern[i]);
+        auto first = previous + 1;
+
+        // Returns the first position in [first, latest] holding the character that passes the test.
+
+        auto firstWhere = [&] (auto test)
+        {
+            for (auto position = first;  position <= latest[i];  ++position)
+            {
+                if ((fold (string[position]) == c) && test (position))
+                    return position;
+            }
+
+            return -1;
+        };
+
+        int position = -1;
+
+        if ((previous >= 0) && (fold (string[first]) == c))
+            position = first;
+
+        if (position < 0)
+            position = firstWhere (isComponentStart);
+
+        if (position < 0)
+            position = firstWhere (isWordStart);
+
+        if (position < 0)
+            position = firstWhere ([] (int) { return true; });
+
+        score += c_charScore;
+
+        if (previous >= 0)
+            score += (position == first) ? c_adjacentBonus
+                                         : -std::min (position - first, c_maxGapPenalty);
+
+        if (isComponentStart (position))
+            score += c_componentBonus;
+        else if (isWordStart (position))
+            score += c_wordBonus;
+
+        if (position >= tailStart)
+            score += c_tailBonus;
+
+        previous = position;
+    }
+
+    return true;
+}
+
+
+
+static std::string Narrow (const wstring& str)
+{
+    // Returns the (ASCII) string as a narrow string, for messages.
+    return std::string (str.begin(), str.end());
+}
+
+
+
+bool SparseDifferentialTest (const TestArgs&)
+{
+    static const size_t c_trials    { 200000 };   // Random pattern/string pairs
+    static const size_t c_batches   { 200 };      // Random batches scored with ScoreAll
+    static const int    c_maxFailed { 10 };       // Mismatches reported before giving up
+
+    const wchar_t patternChars[] = L"abAB/-.";
+    const wchar_t stringChars[]  = L"abAB/\\-_. x";
+
+    std::mt19937 random { 1234 };
+    int          failed = 0;
+
+    auto randomString = [&] (const wchar_t* chars, size_t numChars, size_t length)
+    {
+        wstring result;
+
+        while (result.size() < length)
+            result += chars[random() % numChars];
+
+        return result;
+    };
+
+    auto randomPattern = [&]
+    {
+        // Mostly short patterns, but now and then one near or past the longest allowed.
+
+        auto length = (random() % 50) ? 1 + random() % 6
+                                      : SparsePattern::c_maxPatternLength - 2 + random() % 4;
+
+        return randomString (patternChars, std::size(patternChars) - 1, length);
+    };
+
+    auto randomSubject = [&]
+    {
+        // Mostly short strings, but now and then one long enough to cross bit set words, or to
+        // reach or pass the longest string a sparse match accepts.
+
+        auto length = (random() % 20) ? random() % 40
+                                      : SparsePattern::c_maxStringLength - 80 + random() % 90;
+
+        return randomString (stringChars, std::size(stringChars) - 1, length);
+    };
+
+    // Score single strings.
+
+    for (size_t trial = 0;  (trial < c_trials) && (failed < c_maxFailed);  ++trial)
+    {
+        auto pattern = randomPattern();
+        auto string  = randomSubject();
+
+        SparsePattern sparse { pattern.c_str() };
+
+        int  score = 0,  expectedScore = 0;
+        auto result   = sparse.Score (string.c_str(), score);
+        auto expected = NaiveSparseScore (pattern, string, expectedScore);
+
+        if ((result != expected) || (result && (score != expectedScore)))
+        {
+            ++failed;
+            Fail ("sparse pattern \"%s\" against \"%s\" gave %s (%d); the naive scorer gave "
+                  "%s (%d)", Narrow(pattern).c_str(), Narrow(string).c_str(),
+                  result ? "a match" : "no match", score, expected ? "a match" : "no match",
+                  expectedScore);
+        }
+    }
+
+    // Score batches, which ScoreAll may split across threads.
+
+    for (size_t batch = 0;  (batch < c_batches) && (failed < c_maxFailed);  ++batch)
+    {
+        auto pattern = randomPattern();
+        SparsePattern sparse { pattern.c_str() };
+
+        std::vector<wstring>        strings (random() % 3000);
+        std::vector<const wchar_t*> pointers;
+
+        for (auto& string : strings)
+        {
+            string = randomSubject();
+            pointers.push_back (string.c_str());
+        }
+
+        std::vector<SparsePattern::ScoredMatch> matches, expected;
+        sparse.ScoreAll (pointers.data(), pointers.size(), matches);
+
+        for (size_t i = 0;  i < strings.size();  ++i)
+        {
+            int score;
+            if (NaiveSparseScore (pattern, strings[i], score))
+                expected.push_back ({ i, score });
+        }
+
+        auto same = (matches.size() == expected.size());
+
+        for (size_t i = 0;  same && (i < matches.size());  ++i)
+            same = (matches[i].index == expected[i].index)
+                && (matches[i].score == expected[i].score);
+
+        if (!same)
+        {
+            ++failed;
+            Fail ("ScoreAll of sparse pattern \"%s\" over %zu strings gave %zu matches; the naive "
+                  "scorer gave %zu", Narrow(pattern).c_str(), strings.size(), matches.size(),
+                  expected.size());
+        }
+    }
+
+    return failed == 0;
+}
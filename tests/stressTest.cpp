@@ -0,0 +1,242 @@
+//==================================================================================================
+// stressTest.cpp
+//
+//     Runs many jumpdir processes at once against a single data file, the way a crowd of shells
+//     (some of them scripts jumping in loops) would, and checks that no visit was lost and that
+//     readers were never turned away. Each jump goes to a directory of its own, so every one of
+//     them must show up in the final history with a visit count of one. Enough visits are made to
+//     trigger background compactions while jumps and reads are still under way.
+//==================================================================================================
+
+#include "tests.h"
+
+#include <windows.h>
+#include <stdio.h>
+#include <atomic>
+#include <fstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "json.hpp"
+
+using std::string;
+using json = nlohmann::json;
+
+
+static const int c_numShells     { 16 };   // Shells jumping at the same time
+static const int c_jumpsPerShell { 64 };   // Jumps made by each shell
+
+
+
+static string DirectoryName (int shell, int jump)
+{
+    return "d" + std::to_string(shell) + "_" + std::to_string(jump);
+}
+
+
+
+static bool RunProcess (const string& commandLine, DWORD& exitCode)
+{
+    //----------------------------------------------------------------------------------------------
+    // Runs the command line with its input and output connected to NUL, and waits for it to exit.
+    //
+    // Returns false if the process couldn't be started.
+    //----------------------------------------------------------------------------------------------
+
+    SECURITY_ATTRIBUTES inherit { sizeof(inherit), nullptr, TRUE };
+
+    auto nul = CreateFileA ("NUL", GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                            &inherit, OPEN_EXISTING, 0, nullptr);
+
+    if (nul == INVALID_HANDLE_VALUE)
+        return false;
+
+    STARTUPINFOA startup {};
+    startup.cb         = sizeof(startup);
+    startup.dwFlags    = STARTF_USESTDHANDLES;
+    startup.hStdInput  = nul;
+    startup.hStdOutput = nul;
+    startup.hStdError  = nul;
+
+    PROCESS_INFORMATION process {};
+    string command { commandLine };   // CreateProcessA may write to the command line.
+
+    auto started = CreateProcessA (nullptr, &command[0], nullptr, nullptr, TRUE, 0, nullptr,
+                                   nullptr, &startup, &process);
+    CloseHandle (nul);
+
+    if (!started)
+        return false;
+
+    WaitForSingleObject (process.hProcess, INFINITE);
+    GetExitCodeProcess (process.hProcess, &exitCode);
+
+    CloseHandle (process.hThread);
+    CloseHandle (process.hProcess);
+
+    return true;
+}
+
+
+
+static void RemoveTree (const string& directory)
+{
+    // Deletes the directory and everything in it, as far as it can. A background compaction that
+    // is still running may hold a file open; anything left behind is left to the system's temp
+    // directory cleanup.
+
+    WIN32_FIND_DATAA entry;
+    auto find = FindFirstFileA ((directory + "\\*").c_str(), &entry);
+
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            string name { entry.cFileName };
+
+            if ((name == ".") || (name == ".."))
+                continue;
+
+            if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                RemoveTree (directory + "\\" + name);
+            else
+                DeleteFileA ((directory + "\\" + name).c_str());
+        }
+        while (FindNextFileA (find, &entry));
+
+        FindClose (find);
+    }
+
+    RemoveDirectoryA (directory.c_str());
+}
+
+
+
+bool StressTest (const TestArgs& args)
+{
+    if (args.size() != 1)
+        return Fail ("usage: stress <jumpdir exe>");
+
+    auto jumpdir = "\"" + args[0] + "\"";
+
+    // Set up a scratch directory holding the data file and every jump destination. The jumpdir
+    // processes find the data file through JUMPDATA, which they inherit.
+
+    char tempPath [MAX_PATH + 1];
+
+    if (!GetTempPathA (sizeof(tempPath), tempPath))
+        return Fail ("couldn't get the temp directory");
+
+    auto root = string(tempPath) + "jumpdirStress" + std::to_string(GetCurrentProcessId());
+
+    RemoveTree (root);
+
+    if (!CreateDirectoryA (root.c_str(), nullptr))
+        return Fail ("couldn't create \"%s\"", root.c_str());
+
+    for (int shell = 0;  shell < c_numShells;  ++shell)
+        for (int jump = 0;  jump < c_jumpsPerShell;  ++jump)
+            CreateDirectoryA ((root + "\\" + DirectoryName(shell, jump)).c_str(), nullptr);
+
+    SetEnvironmentVariableA ("JUMPDATA", (root + "\\jumpdir.dat").c_str());
+
+    // Each shell jumps to each of its directories in turn, while a reader lists the history and
+    // a compactor folds the journal, over and over until the shells are done.
+
+    std::atomic<int>  failures { 0 };
+    std::atomic<int>  reads { 0 };
+    std::atomic<bool> jumping { true };
+
+    auto run = [&] (const string& arguments)
+    {
+        DWORD exitCode = 0;
+
+        if (!RunProcess (jumpdir + " " + arguments, exitCode) || (exitCode != 0))
+        {
+            Fail ("\"jumpdir %s\" exited with code %lu", arguments.c_str(), exitCode);
+            ++failures;
+        }
+    };
+
+    std::vector<std::thread> shells;
+
+    for (int shell = 0;  shell < c_numShells;  ++shell)
+    {
+        shells.emplace_back ([&, shell] {
+            for (int jump = 0;  jump < c_jumpsPerShell;  ++jump)
+                run ("\"" + root + "\\" + DirectoryName(shell, jump) + "\"");
+        });
+    }
+
+    std::thread reader ([&] {
+        while (jumping)
+        {   run ("--list *");
+            ++reads;
+        }
+    });
+
+    std::thread compactor ([&] {
+        while (jumping)
+            run ("--compact");
+    });
+
+    for (auto& shell : shells)
+        shell.join();
+
+    jumping = false;
+    reader.join();
+    compactor.join();
+
+    // Every jump must have been recorded exactly once.
+
+    auto exportFile = root + "\\history.json";
+
+    run ("--export-json \"" + exportFile + "\"");
+
+    std::set<string> visited;
+    bool             passed = (failures == 0);
+
+    try
+    {
+        std::ifstream file { exportFile };
+        auto history = json::parse (file).at ("history");
+
+        for (auto& entry : history)
+        {
+            auto path  = entry.at("path").get<string>();
+            auto slash = path.find_last_of ("/\\");
+            auto name  = path.substr (slash == string::npos ? 0 : slash + 1);
+
+            if (path.find ("jumpdirStress") == string::npos)
+                continue;
+
+            if (!visited.insert(name).second)
+                passed = Fail ("\"%s\" appears in the history more than once", path.c_str());
+
+            if (entry.at("visitCount").get<int>() != 1)
+                passed = Fail ("\"%s\" has visit count %d, not 1", path.c_str(),
+                               entry.at("visitCount").get<int>());
+        }
+    }
+    catch (const json::exception& ex)
+    {
+        passed = Fail ("couldn't read the exported history: %s", ex.what());
+    }
+
+    for (int shell = 0;  shell < c_numShells;  ++shell)
+    {
+        for (int jump = 0;  jump < c_jumpsPerShell;  ++jump)
+        {
+            if (!visited.count (DirectoryName (shell, jump)))
+                passed = Fail ("the visit to %s was lost", DirectoryName(shell, jump).c_str());
+        }
+    }
+
+    printf ("%d shells made %d jumps each, alongside %d history reads.\n",
+            c_numShells, c_jumpsPerShell, reads.load());
+
+    RemoveTree (root);
+
+    return passed;
+}
@@ -0,0 +1,90 @@
+//==================================================================================================
+// testMain.cpp
+//
+//     The jumpdir test driver. Usage:
+//
+//         jumpdirTests                      Lists the test cases
+//         jumpdirTests <case> [args...]     Runs the named test case
+//
+//     The exit code is zero if the test case passed.
+//==================================================================================================
+
+#include "tests.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+
+struct TestCase
+{
+    const char*   name;       // Test case name, as given on the command line
+    TestFunction* run;        // Test case function
+    const char*   usage;      // Test case arguments and description
+};
+
+static const TestCase c_testCases[] =
+{
+    { "patterns",     PatternCorpusTest, "Pathological patterns, each within a time budget" },
+    { "differential", DifferentialTest,  "Compiled patterns against the reference matchers" },
+    { "sparse",       SparseDifferentialTest, "Sparse pattern scores against a naive scorer" },
+    { "benchmarks",   BenchmarkTest,     "[rounds]: Pattern matching times on real-world paths" },
+    { "kernels",      KernelBenchmarkTest, "[rounds] [form]: Literal run kernel times, by form" },
+    { "allocations",  AllocationTest,    "Heap allocations made by warm directory traversals" },
+    { "fetchorder",   FetchOrderTest,    "Parallel tree fetches against serial walks" },
+    { "cache",        CacheTest,         "Directory listing cache invalidation and damage" },
+#ifndef _WIN32
+    { "linuxproxy",   LinuxProxyTest,    "Linux file system proxy listings and lookups" },
+#endif
+#ifdef _WIN32
+    { "stress",       StressTest,        "<jumpdir exe>: Many jumpdir processes on one data file" },
+#endif
+    { nullptr, nullptr, nullptr }
+};
+
+
+
+bool Fail (const char* format, ...)
+{
+    va_list args;
+    va_start (args, format);
+
+    fputs ("FAILED: ", stdout);
+    vprintf (format, args);
+    fputc ('\n', stdout);
+    fflush (stdout);
+
+    va_end (args);
+
+    return false;
+}
+
+
+
+int main (int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        puts ("Usage: jumpdirTests <case> [args...]\n\nTest cases:");
+
+        for (auto test = c_testCases;  test->name;  ++test)
+            printf ("    %-12s %s\n", test->name, test->usage);
+
+        return 1;
+    }
+
+    for (auto test = c_testCases;  test->name;  ++test)
+    {
+        if (0 != strcmp (test->name, argv[1]))
+            continue;
+
+        TestArgs args (argv + 2, argv + argc);
+        auto passed = test->run (args);
+
+        printf ("%s: %s\n", test->name, passed ? "passed" : "FAILED");
+        return passed ? 0 : 1;
+    }
+
+    printf ("Unknown test case \"%s\".\n", argv[1]);
+    return 1;
+}
@@ -0,0 +1,57 @@
+//==================================================================================================
+// tests.h
+//
+//     Declarations shared by the jumpdir test cases. Each test case is a function that runs to
+//     completion, reports each failure it finds (see Fail), and returns true if it found none. The
+//     test driver (testMain.cpp) runs one test case per invocation, so that CTest can run and
+//     report each case on its own.
+//==================================================================================================
+
+#ifndef _tests_h
+#define _tests_h
+
+#include <string>
+#include <vector>
+
+
+typedef std::vector<std::string> TestArgs;   // Arguments following the test case name
+
+typedef bool TestFunction (const TestArgs& args);
+
+
+// Prints a printf-style failure message, and returns false.
+
+bool Fail (const char* format, ...);
+
+
+    // Reference Matchers (see referenceMatcher.cpp)
+
+namespace Reference {
+
+bool wildComp (const wchar_t *pattern, const wchar_t *string);
+bool wildCompCaseSensitive (const wchar_t *pattern, const wchar_t *string);
+bool pathMatch (const wchar_t *pattern, const wchar_t *path);
+
+};  // namespace Reference
+
+
+    // Test Cases
+
+TestFunction PatternCorpusTest;    // Pathological patterns, each within a time budget
+TestFunction DifferentialTest;     // Compiled patterns against the reference matchers
+TestFunction SparseDifferentialTest; // Sparse pattern scores against a naive scorer
+TestFunction BenchmarkTest;        // Pattern matching times on real-world paths
+TestFunction KernelBenchmarkTest;  // Literal run kernel times, in each kernel form
+TestFunction AllocationTest;       // Heap allocations made by warm directory traversals
+TestFunction FetchOrderTest;       // Parallel tree fetches against serial walks
+TestFunction CacheTest;            // Directory listing cache invalidation and damage
+
+#ifndef _WIN32
+TestFunction LinuxProxyTest;       // Linux file system proxy listings and lookups
+#endif
+
+#ifdef _WIN32
+TestFunction StressTest;           // Many jumpdir processes jumping against one data file
+#endif
+
+#endif   // ifndef _tests_h